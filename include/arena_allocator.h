@@ -0,0 +1,83 @@
+#ifndef ARENA_ALLOCATOR_H
+#define ARENA_ALLOCATOR_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp32-hal-log.h>
+
+// Bump allocator over a static buffer. A message is parsed without touching
+// the heap, and everything is released at once before the next one.
+template <size_t N>
+class ArenaAllocator : public ArduinoJson::Allocator
+{
+public:
+  void* allocate(size_t size) override
+  {
+    size_t need = HEADER + align(size);
+    if (need > N - _used)
+    {
+      log_w("JSON arena full (%u + %u of %u bytes)", (unsigned)_used, (unsigned)need, (unsigned)N);
+      return nullptr;
+    }
+
+    uint8_t* block = _buffer + _used;
+    *(size_t*)block = size;
+    _last = _used;
+    _used += need;
+    return block + HEADER;
+  }
+
+  void deallocate(void* ptr) override
+  {
+    // Only the newest block can be given back, the rest waits for reset()
+    if (ptr != nullptr && blockOf(ptr) == _buffer + _last)
+    {
+      _used = _last;
+      _last = NONE;
+    }
+  }
+
+  void* reallocate(void* ptr, size_t size) override
+  {
+    if (ptr == nullptr)
+    {
+      return allocate(size);
+    }
+
+    uint8_t* block = blockOf(ptr);
+    size_t old = *(size_t*)block;
+    if (block == _buffer + _last && HEADER + align(size) <= N - _last)
+    {
+      // Newest block: grow or shrink in place
+      *(size_t*)block = size;
+      _used = _last + HEADER + align(size);
+      return ptr;
+    }
+
+    void* moved = allocate(size);
+    if (moved != nullptr)
+    {
+      memcpy(moved, ptr, old < size ? old : size);
+    }
+    return moved;
+  }
+
+  void reset()
+  {
+    _used = 0;
+    _last = NONE;
+  }
+
+private:
+  static const size_t HEADER = 8;
+  static const size_t NONE = (size_t)-1;
+
+  static size_t align(size_t size) { return (size + 7) & ~(size_t)7; }
+  static uint8_t* blockOf(void* ptr) { return (uint8_t*)ptr - HEADER; }
+
+  alignas(8) uint8_t _buffer[N];
+  size_t _used = 0;
+  size_t _last = NONE;
+};
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <Arduino.h>
+#include "TaskManager.h"
+
+// Run state kept in RTC memory that survives a watchdog, panic or OTA
+// restart (not a power loss). Saving is a few RAM writes, so it can run
+// every second without touching flash.
+#define CHECKPOINT_MAGIC 0x52554E31  // "RUN1"
+#define CHECKPOINT_MAX_AGE 3600      // Seconds; an older cycle is not resumed
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t time;  // Local RTC time of the checkpoint
+  uint16_t left;  // Seconds left in the step
+  int8_t step;    // -1 = idle
+  uint32_t crc;   // crc32 of everything above
+} run_checkpoint_t;
+
+void checkpoint_save(TaskManager &taskManager, uint32_t now);
+// At boot: resumes the schedule from the last minute handled and an
+// interrupted cycle; true when a cycle was resumed
+bool checkpoint_restore(TaskManager &taskManager, uint32_t now);
+
+#endif
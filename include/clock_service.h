@@ -0,0 +1,27 @@
+#ifndef CLOCK_SERVICE_H
+#define CLOCK_SERVICE_H
+
+#include <RTClib.h>
+
+#ifndef CLOCK_TEMP_REFRESH_MS
+#define CLOCK_TEMP_REFRESH_MS 300000 // The DS3231 converts only every 64 s anyway
+#endif
+
+// Local time without asking the DS3231 every time: clock_sync() reads it
+// once per minute alarm and clock_now() adds the millis() elapsed since.
+// The temperature is cached and re-read by clock_loop() once it is older
+// than CLOCK_TEMP_REFRESH_MS.
+void clock_init(RTC_DS3231& rtc);
+bool clock_sync(); // Reads the RTC; on a bad read the last good one is kept
+bool clock_valid();
+DateTime clock_now();
+float clock_temperature();
+void clock_loop();
+
+bool clock_adjust(const DateTime& dt); // Sets the RTC, then re-syncs from it
+// Aging offset register (0x10): ~0.1 ppm per LSB, positive slows the
+// oscillator. The chip applies it at its next temperature conversion.
+bool clock_read_aging(int8_t& aging);
+bool clock_write_aging(int8_t aging);
+
+#endif
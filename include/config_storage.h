@@ -1,36 +1,103 @@
-#ifndef CONFIG_STORAGE_H
-#define CONFIG_STORAGE_H
-
-#include <Arduino.h>
-#include <Preferences.h>
-#include "TaskManager.h"
-
-class ConfigStorage
-{
-public:
-  ConfigStorage();
-
-  bool begin();
-  void end();
-
-  // Schedule settings
-  bool saveSchedule(uint8_t hour, uint8_t minute);
-  bool loadSchedule(uint8_t& hour, uint8_t& minute);
-
-  // Task settings
-  bool saveTask(uint8_t idx, uint16_t valves, uint8_t duration);
-  bool loadTask(uint8_t idx, uint16_t& valves, uint8_t& duration);
-  uint8_t getTaskCount();
-
-  // Apply to TaskManager
-  void loadToTaskManager(TaskManager& tm);
-
-  // Reset to defaults
-  void reset();
-
-private:
-  Preferences preferences;
-  static const char* NAMESPACE;
-};
-
-#endif
+#ifndef CONFIG_STORAGE_H
+#define CONFIG_STORAGE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "TaskManager.h"
+#include "ZonePlanner.h"
+
+#define CONFIG_MAGIC 0x43475249 // "IRGC"
+#define CONFIG_VERSION 2 // 2: 64-bit valve masks, MAX_ZONES zones, packed
+#define CONFIG_FLUSH_QUIET_MS 5000  // Written once edits pause this long
+#define CONFIG_FLUSH_MAX_MS 60000   // ...but never later than this after the first one
+
+// Everything that is persisted, kept in RAM and written to NVS as one blob
+typedef struct
+{
+  uint8_t sched_hour;
+  uint8_t sched_minute;
+  uint8_t program_mask; // Bit i: programs[i] is stored
+  uint8_t task_count;
+  program_t programs[MAX_PROGRAMS];
+  valve_setting_t tasks[MAX_TASKS];
+  uint8_t zone_count;
+  uint16_t capacity;
+  zone_demand_t zones[MAX_ZONES];
+} config_t;
+
+typedef struct
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t length; // Bytes that follow, CRC included
+} config_header_t;
+
+// The blob is the header, then config_t without its padding and with only
+// the steps and zones in use, then a crc32 of everything before it:
+//   sched_hour, sched_minute, program_mask, programs[MAX_PROGRAMS],
+//   task_count, task_count x (valves, duration),
+//   zone_count, capacity, zone_count x zone_demand_t
+#define CONFIG_STEP_BYTES (sizeof(valve_mask_t) + sizeof(uint16_t))
+#define CONFIG_BLOB_MAX (sizeof(config_header_t) + 3 + MAX_PROGRAMS * sizeof(program_t) + \
+                         1 + MAX_TASKS * CONFIG_STEP_BYTES + 3 + MAX_ZONES * sizeof(zone_demand_t) + sizeof(uint32_t))
+
+class ConfigStorage
+{
+public:
+  ConfigStorage();
+
+  bool begin();
+  void end();
+
+  // Reads the blob once (or migrates the per-key layout of older firmware);
+  // every getter below is then served from RAM. false when nothing usable
+  // is stored and the getters return defaults.
+  bool load();
+
+  // Schedule settings
+  bool saveSchedule(uint8_t hour, uint8_t minute);
+  bool loadSchedule(uint8_t& hour, uint8_t& minute);
+
+  // Programs (calendar start rules), take precedence over the schedule
+  bool saveProgram(uint8_t idx, const program_t& program);
+  bool loadProgram(uint8_t idx, program_t& program);
+
+  // Task settings, duration in seconds
+  bool saveTask(uint8_t idx, valve_mask_t valves, uint16_t duration);
+  bool loadTask(uint8_t idx, valve_mask_t& valves, uint16_t& duration);
+  uint8_t getTaskCount();
+  bool saveTasks(TaskManager& tm); // Whole step table, drops stale higher indices
+  bool saveTasks(const valve_setting_t* steps, uint8_t count);
+
+  // Zone flow demands and pump capacity for the zone planner
+  bool saveZones(const zone_demand_t* zones, uint8_t count, uint16_t capacity);
+  bool loadZones(zone_demand_t* zones, uint8_t& count, uint16_t& capacity);
+
+  // Apply to TaskManager
+  void loadToTaskManager(TaskManager& tm);
+
+  // Reset to defaults
+  void reset();
+
+  // Saves only update RAM and schedule a flush; call flush() before a
+  // restart or OTA so nothing is lost
+  bool flush();
+  bool isDirty();
+  static void flushPending(); // Flushes whichever instance has unsaved edits
+
+private:
+  bool commit(); // Writes the whole configuration as one blob
+  bool markDirty();
+  bool upgrade();
+  bool migrateLegacy();
+  void removeLegacy();
+
+  Preferences preferences;
+  config_t _config;
+  bool _dirty = false;
+  unsigned long _dirty_since = 0;
+  static const char* NAMESPACE;
+  static const char* BLOB_KEY;
+};
+
+#endif
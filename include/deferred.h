@@ -0,0 +1,27 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include <Arduino.h>
+
+// Work posted from MQTT callbacks and other handlers that must not block.
+// Each id has at most one pending action: posting it again moves it to the
+// new time (coalescing bursts), defer_cancel() drops it. defer_loop() runs
+// whatever is due from loop().
+typedef enum
+{
+  DEFER_RESTART,        // Requested system restart
+  DEFER_STATUS_PUBLISH, // Task status after a command changed it
+  DEFER_CONFIG_FLUSH,   // Write the configuration after a burst of edits
+  DEFER_CLOCK_STEP,     // Set the RTC from NTP half way through a minute
+  DEFER_MAX
+} deferred_id_t;
+
+typedef void (*DeferredAction)();
+
+bool defer_post(deferred_id_t id, uint32_t delay_ms, DeferredAction action);
+bool defer_cancel(deferred_id_t id);
+bool defer_pending(deferred_id_t id);
+void defer_loop();
+bool defer_next(uint32_t& at); // When defer_loop() next has work, for callers that sleep
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <ArduinoJson.h>
+#include "valves.h"
+#include "ntp_sync.h"
+#include "power.h"
+#include "i2c_bus.h"
+
+// Counters published every 10 minutes next to the state message. They are
+// split so each document stays within MQTT_PAYLOAD_MAX with every counter
+// at its widest: valves, clock and power on the diag topic, the per-device
+// I2C counters on the bus topic.
+void diagnostics_device(JsonDocument &doc, const valves_stats_t &valves, const ntp_status_t &clock, const power_stats_t &power);
+void diagnostics_bus(JsonDocument &doc, const bus_stats_t (&bus)[BUS_DEVICES]);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <Arduino.h>
+
+// Work for the devices sharing Wire (valve expanders, DS3231, LCD). Jobs
+// are posted and run by the control task: each device has at most one
+// pending job, posting it again replaces it, so several valve changes in
+// one pass become one write. bus_loop() runs the jobs in device order,
+// which is their priority, until the pass budget is spent; a job with more
+// to do returns false and continues on the next pass.
+// Other tasks (the UI sending the LCD) hold the bus between bus_begin()
+// and bus_end() for one budget at a time, so a valve change never waits
+// behind more than one slice of text.
+typedef enum
+{
+  BUS_VALVES, // Highest priority
+  BUS_RTC,
+  BUS_LCD,
+  BUS_DEVICES
+} bus_device_t;
+
+#define BUS_BUDGET_US 5000 // Per bus_loop() pass or hold, checked between jobs and by sliced jobs
+
+typedef bool (*BusJob)(); // true when done, false to be called again on the next pass
+
+typedef struct
+{
+  uint32_t transactions; // Job runs and timed direct transactions
+  uint32_t errors;
+  uint32_t busy_us;      // Total time spent on the bus
+  uint32_t max_us;       // Longest single run
+  uint32_t wait_max_us;  // Longest time a job waited to start
+} bus_stats_t;
+
+bool bus_post(bus_device_t device, BusJob job);
+bool bus_pending(bus_device_t device);
+void bus_init(); // Before the first transaction
+void bus_loop();
+bool bus_budget_left(); // For jobs that work in slices
+
+// Transactions outside bus_loop() (the minute alarm, the LCD) hold the bus
+// and are timed directly: started = bus_begin(), then bus_end(). Holds
+// nest, the budget runs from the outermost one.
+uint32_t bus_begin();
+void bus_end(bus_device_t device, uint32_t started, bool ok = true);
+void bus_fail(bus_device_t device); // Called by a job whose transaction failed
+
+bus_stats_t bus_stats(bus_device_t device);
+const char* bus_device_name(bus_device_t device);
+
+#endif
@@ -3,14 +3,24 @@
 
 #include <LCDi2c.h>
 #include <RTClib.h>
-#include "TaskManager.h"
+#include "ValveMask.h"
 
 extern LCDi2c lcd;
 
 void lcd_init();
+
+// Rows and columns start at 1, as in LCDi2c::locate(). Writes only change
+// the framebuffer; lcd_render() sends the changed characters while holding
+// the bus (i2c_bus.h): it stops when the budget is spent, false = not done.
+// Used by the UI task only (ui.h).
+void lcd_write(int row, int column, const char* text);
+void lcd_write_row(int row, int column, const char* text); // Blanks the rest of the row
+bool lcd_render();
+void lcd_invalidate(); // Resend everything on the next render
+
 void lcd_print_date_time(int row, int column, DateTime time);
 void lcd_print_temp(int row, int column, float value);
-void lcd_print_task(TaskManager& taskManager);
+void lcd_print_task(const char* status, bool showValves, valve_mask_t valves);
 
 
-#endif
\ No newline at end of file
+#endif
@@ -1,18 +1,35 @@
-#ifndef MQTT_COMMANDS_H
-#define MQTT_COMMANDS_H
-
-#include <Arduino.h>
-#include <ArduinoJson.h>
-#include "TaskManager.h"
-
-// Command handlers
-bool handleValveControl(JsonDocument& doc, TaskManager& taskManager);
-bool handlePumpControl(JsonDocument& doc);
-bool handleTaskStart(TaskManager& taskManager);
-bool handleTaskStop(TaskManager& taskManager);
-bool handleSystemRestart(JsonDocument& doc);
-
-// Response helpers
-void publishCommandResponse(const char* topic, const char* cmd, bool success, const char* message);
-
-#endif
+#ifndef MQTT_COMMANDS_H
+#define MQTT_COMMANDS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "TaskManager.h"
+#include "ManualRuns.h"
+#include "config_storage.h"
+
+typedef struct
+{
+  TaskManager& taskManager;
+  ManualRuns& manualRuns;
+  ConfigStorage& configStorage;
+  const char* responseTopic;
+} command_context_t;
+
+// Parses a command payload in place, runs its handler and publishes the response
+void dispatchCommand(const byte* payload, unsigned int length, command_context_t& context);
+// Applies a batch of schedule edits from the conf topic all-or-nothing, one response
+void dispatchConfig(const byte* payload, unsigned int length, command_context_t& context);
+
+// Command handlers
+bool handleValveControl(JsonDocument& doc, command_context_t& context);
+bool handlePumpControl(JsonDocument& doc, command_context_t& context);
+bool handleTaskStart(JsonDocument& doc, command_context_t& context);
+bool handleTaskStop(JsonDocument& doc, command_context_t& context);
+bool handleSystemRestart(JsonDocument& doc, command_context_t& context);
+bool handleProgramSet(JsonDocument& doc, command_context_t& context);
+bool handleZonePlan(JsonDocument& doc, command_context_t& context);
+
+// Response helpers; on the task that dispatches, it reuses the command document
+void publishCommandResponse(const char* topic, const char* cmd, bool success, const char* message);
+
+#endif
@@ -6,14 +6,28 @@
 
 typedef void (*SimpleAction)();
 
+// Outbound messages are queued, from any task, and drained by mqtt_loop()
+// on the network task while connected
+#define MQTT_QUEUE_SLOTS 12
+#define MQTT_PAYLOAD_MAX 512
+#define MQTT_DRAIN_INTERVAL_MS 250 // At most one queued message per interval
+
+typedef enum
+{
+    MQTT_STATUS, // Retained state; a newer one on the same topic replaces a queued one
+    MQTT_EVENT   // Kept in order until delivered, never coalesced
+} mqtt_kind_t;
+
 void mqtt_init(const char* device_name,const char* server, int port, const char* user, const char* password, const char* mqtt_topic_will);
 void mqtt_connect();
 
 bool mqtt_loop();
 bool mqtt_is_connected();
 
-bool mqtt_publish_json(const char* topic, JsonDocument& doc);
-bool mqtt_publish(const char *topic, const char *payload);
+bool mqtt_publish_json(const char* topic, JsonDocument& doc, mqtt_kind_t kind = MQTT_STATUS);
+bool mqtt_publish(const char *topic, const char *payload, mqtt_kind_t kind = MQTT_STATUS);
+uint8_t mqtt_queue_size();
+void mqtt_flush(); // Send everything queued now, e.g. before a restart
 
 void mqtt_set_callback(MQTT_CALLBACK_SIGNATURE, SimpleAction callbackConnected);
 void mqtt_subscribe(const char* topic, uint8_t qos);
@@ -0,0 +1,34 @@
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include <Arduino.h>
+#include "power.h"
+
+#ifndef NETWORK_POLL_MS
+#define NETWORK_POLL_MS (POWER_SAVE ? POWER_IDLE_MS : POWER_BUSY_MS) // Wi-Fi and MQTT upkeep
+#endif
+
+// The network task owns Wi-Fi, the MQTT client, SNTP start-up and OTA.
+// Other tasks queue MQTT messages in the outbox (mqtt_handler) and ask for
+// the rest with network_post(), which never waits. Received MQTT messages
+// reach the mqtt_set_callback() handler on this task.
+typedef enum : uint8_t
+{
+  NETWORK_PUBLISH_WIFI, // Wi-Fi details to topic
+  NETWORK_OTA_CHECK,    // Install new firmware if there is one
+  NETWORK_RESTART       // Deliver the outbox, then restart
+} network_request_type_t;
+
+typedef struct
+{
+  network_request_type_t type;
+  const char* topic; // A static buffer
+  char time[20];
+} network_request_t;
+
+void network_start(); // After wifi_init() and mqtt_init()
+bool network_post(const network_request_t& request); // false when the queue is full
+bool network_wifi_connected();
+bool network_mqtt_connected();
+
+#endif
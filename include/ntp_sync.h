@@ -0,0 +1,39 @@
+#ifndef NTP_SYNC_H
+#define NTP_SYNC_H
+
+#include <Arduino.h>
+
+#ifndef NTP_SYNC_INTERVAL_MS
+#define NTP_SYNC_INTERVAL_MS 3600000 // How often SNTP re-syncs the system time
+#endif
+
+#ifndef NTP_MAX_AGE_MS
+#define NTP_MAX_AGE_MS (2 * NTP_SYNC_INTERVAL_MS) // Older system time is not trusted over the RTC
+#endif
+
+#ifndef NTP_STEP_SLACK_US
+#define NTP_STEP_SLACK_US 20000 // How far off a whole second the RTC may be set
+#endif
+
+// Keeps the DS3231 on NTP time. SNTP runs in the background and keeps the
+// system time; at every minute alarm the RTC is compared with it and
+// ClockDiscipline tunes the RTC's aging offset against its drift. Only
+// large offsets (first sync, DST change, lost backup battery) set the RTC,
+// and then half way through a minute, so a step of under 30 s neither
+// skips nor repeats a minute alarm.
+typedef struct
+{
+  bool synced;      // System time is fresh from NTP
+  int32_t offset_ms; // RTC minus NTP at the last alarm
+  bool estimated;   // drift_ppm is known
+  float drift_ppm;  // The DS3231's own drift, positive = fast
+  int8_t aging;
+  uint32_t steps;   // Times the RTC was set
+} ntp_status_t;
+
+void ntp_init(); // After clock_init()
+void ntp_loop(bool connected); // Starts SNTP once the network is up
+void ntp_alarm(uint32_t alarmUs); // Each minute alarm after clock_sync(); micros() when it fired
+ntp_status_t ntp_status();
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#ifndef POWER_SAVE
+#define POWER_SAVE 0 // 1: scale the CPU clock and light-sleep while no zone runs; needs a framework with CONFIG_PM_ENABLE and tickless idle
+#endif
+
+#ifndef POWER_MAX_MHZ
+#define POWER_MAX_MHZ 160
+#endif
+
+#ifndef POWER_MIN_MHZ
+#define POWER_MIN_MHZ 40 // XTAL; Wi-Fi keeps the APB at 80 MHz while it needs it
+#endif
+
+#ifndef POWER_IDLE_MS
+#define POWER_IDLE_MS 1000 // Longest sleep between control passes when idle
+#endif
+
+#define POWER_BUSY_MS 100 // Between passes while zones run or work is queued
+
+// Paces the control task. power_idle() ends each pass: it blocks until the
+// next pass is due or a notification (the RTC alarm interrupt, a received
+// command) wakes it early. With POWER_SAVE the CPU clock drops to
+// POWER_MIN_MHZ and the chip light-sleeps while every task waits; Wi-Fi
+// keeps the association in modem sleep and wakes it at DTIM beacons and
+// for incoming packets, the DS3231 INT line (held low until the alarm is
+// cleared) wakes it by level. While busy, a power management lock keeps
+// full speed and no sleep.
+typedef struct
+{
+  bool light_sleep;       // Automatic light sleep is configured and supported by the framework
+  bool busy;
+  uint16_t duty_permille; // Time the control task spent working since the last report
+  uint32_t passes;        // Control passes since the last report
+  uint32_t cpu_mhz;
+} power_stats_t;
+
+void power_init(uint8_t wakePin); // From the control task, after attachInterrupt() on the pin
+void power_wake_from_isr();       // From the RTC alarm interrupt
+void power_rearm();               // After the alarm was cleared
+void power_idle(bool busy, uint32_t maxWaitMs = UINT32_MAX); // maxWaitMs: work due before the next pass
+power_stats_t power_report();     // Since the previous report
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef RTOS_TASKS_H
+#define RTOS_TASKS_H
+
+// The firmware runs in three FreeRTOS tasks started by setup(); loop()
+// only idles.
+//  - control: schedule, valves, pump, RTC, configuration and commands. The
+//    only task that drives the valves and the pump. Highest priority, so
+//    nothing the network or the display does delays a step change.
+//  - network: Wi-Fi, MQTT, SNTP and OTA. Control hands it work through a
+//    bounded request queue and its messages through the MQTT outbox;
+//    received commands come back through the control queue (main.cpp).
+//  - ui: the LCD. Control sends it the newest state to show.
+// Queues are bounded and never waited on by control: a full queue drops
+// and logs instead of blocking the valves. Stack sizes are in bytes.
+#define CONTROL_TASK_PRIORITY 5
+#define CONTROL_TASK_STACK 8192
+#define CONTROL_QUEUE_LENGTH 4 // Received commands waiting for control
+
+#define NETWORK_TASK_PRIORITY 3
+#define NETWORK_TASK_STACK 8192
+#define NETWORK_QUEUE_LENGTH 4
+
+#define UI_TASK_PRIORITY 2
+#define UI_TASK_STACK 4096
+
+#endif
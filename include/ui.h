@@ -0,0 +1,24 @@
+#ifndef UI_H
+#define UI_H
+
+#include <Arduino.h>
+#include "ValveMask.h"
+#include "config.h"
+
+// What the LCD shows, sent by the control task. The UI task keeps only the
+// newest one, so a display still busy with the last frame never holds
+// control up.
+typedef struct
+{
+  bool time_valid;
+  uint32_t time;       // Local RTC time
+  float temperature;
+  char status[LCD_COLUMNS + 1];
+  bool show_valves;
+  valve_mask_t valves; // Open zones of the running step
+} ui_state_t;
+
+void ui_start(); // After lcd_init()
+void ui_post(const ui_state_t& state);
+
+#endif
@@ -2,8 +2,26 @@
 #define UTILS_H
 
 #include <WString.h>
+#include "ValveMask.h"
 
-String toValveString(uint16_t value);
-uint16_t decodeBinaryString(const char *input);
+String toValveString(valve_mask_t value, uint8_t zones); // "oxo xxx ..." for zones 0..zones-1
+valve_mask_t decodeBinaryString(const char *input);
+
+bool parseTimeOfDay(const char *input, uint16_t &minutes); // "HH:MM" -> minutes after midnight
+bool parseMonthDay(const char *input, uint16_t &mmdd);     // "MM-DD" -> month * 100 + day
+
+uint32_t crc32(const void *data, size_t length, uint32_t crc = 0); // IEEE 802.3, chainable
+
+// Exponential reconnect backoff: base, 2*base, 4*base ... up to max, each
+// randomised to 50-100 % so devices that lost the same AP or broker spread out
+typedef struct
+{
+  uint32_t base_ms;
+  uint32_t max_ms;
+  uint8_t attempt;
+} backoff_t;
+
+uint32_t backoff_next(backoff_t &backoff); // Delay before the next attempt
+void backoff_reset(backoff_t &backoff);
 
 #endif
\ No newline at end of file
@@ -3,12 +3,41 @@
 
 #include <PCF8574.h>
 #include "config.h"
+#include "ValveMask.h"
 
-extern PCF8574 pfc_box12; // Ventil krabice 1,2
-extern PCF8574 pfc_box34; // Ventil krabice 3,4
+#ifndef VALVES_VERIFY
+#define VALVES_VERIFY 1 // Read every written byte back to catch bus errors and stuck lines
+#endif
+
+#ifndef VALVES_FAIL_LIMIT
+#define VALVES_FAIL_LIMIT 20 // Unconfirmed writes in a row (about 2 s of retries) before watering is stopped
+#endif
+
+typedef struct
+{
+  uint8_t address; // I2C address of the PCF8574
+  uint8_t valves;  // Valves on P0..P(valves-1), numbered on from the previous expander
+} valve_expander_t;
+
+// Valve expanders in zone order. Larger sites list theirs in config.h, e.g.
+// #define VALVE_EXPANDERS {{0x38, 6}, {0x3C, 6}, {0x39, 8}, {0x3A, 8}}
+#ifndef VALVE_EXPANDERS
+#define VALVE_EXPANDERS {{PCF_38_ADDRESS, 6}, {PCF_3C_ADDRESS, 6}} // Ventil krabice 1,2 a 3,4
+#endif
+
+typedef struct
+{
+  uint32_t writes;     // Bytes written to an expander
+  uint32_t skipped;    // Writes saved because the expander already had the value
+  uint32_t errors;     // I2C errors on write or readback
+  uint32_t mismatches; // Readback differed from what was written
+} valves_stats_t;
 
 void valves_init();
-void valves_write(uint16_t value);
+bool valves_write(valve_mask_t value); // false when an expander failed; call again to retry
 void valves_off();
+uint8_t valves_zone_count(); // Zones wired across all expanders
+valves_stats_t valves_stats();
+uint16_t valves_failing(); // valves_write() calls in a row that failed, 0 after one succeeds
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,82 @@
+#include "ClockDiscipline.h"
+#include <math.h>
+#include <esp32-hal-log.h>
+
+void ClockDiscipline::reset(int8_t aging)
+{
+  _aging = aging;
+  _have_ref = false;
+}
+
+clock_correction_t ClockDiscipline::sample(int32_t offsetMs, uint32_t at)
+{
+  clock_correction_t correction = {};
+  _last_offset_ms = offsetMs;
+
+  if (offsetMs >= STEP_MS || offsetMs <= -STEP_MS)
+  {
+    // The next sample after the step starts a new baseline
+    log_i("RTC off by %d ms, stepping", offsetMs);
+    correction.step = true;
+    _have_ref = false;
+    return correction;
+  }
+
+  if (!_have_ref)
+  {
+    _have_ref = true;
+    _ref_offset_ms = offsetMs;
+    _ref_at = at;
+    return correction;
+  }
+
+  uint32_t elapsed = at - _ref_at;
+  if (elapsed < MIN_BASELINE_S)
+  {
+    return correction;
+  }
+
+  // Rate over the baseline ran with the current aging; add it back to get
+  // the chip's own drift. Later estimates are averaged to ride out noise.
+  float measured = (offsetMs - _ref_offset_ms) * 1000.0f / elapsed;
+  float drift = measured + _aging * AGING_PPM;
+  _drift_ppm = _have_estimate ? (_drift_ppm + drift) / 2 : drift;
+  _have_estimate = true;
+
+  // Ahead (positive offset) needs a slower oscillator: more aging
+  float slew = offsetMs * 1000.0f / SLEW_HORIZON_S;
+  long target = lroundf((_drift_ppm + slew) / AGING_PPM);
+  target = constrain(target, -127, 127);
+
+  log_i("RTC drift %.2f ppm, offset %d ms, aging %d -> %ld", _drift_ppm, offsetMs, _aging, target);
+  if (target != _aging)
+  {
+    _aging = (int8_t)target;
+    correction.set_aging = true;
+    correction.aging = _aging;
+  }
+
+  _ref_offset_ms = offsetMs;
+  _ref_at = at;
+  return correction;
+}
+
+bool ClockDiscipline::hasEstimate()
+{
+  return _have_estimate;
+}
+
+float ClockDiscipline::driftPpm()
+{
+  return _drift_ppm;
+}
+
+int8_t ClockDiscipline::aging()
+{
+  return _aging;
+}
+
+int32_t ClockDiscipline::lastOffsetMs()
+{
+  return _last_offset_ms;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <Arduino.h>
+
+typedef struct
+{
+  bool step;          // Set the RTC to NTP time (offset too large to slew)
+  bool set_aging;     // Program aging (register 0x10 of the DS3231)
+  int8_t aging;
+} clock_correction_t;
+
+// Keeps the DS3231 on NTP time. Each sample is the RTC's offset from NTP
+// time, taken at a minute alarm: the instant the RTC turns to second 0, so
+// it is precise to the millisecond although the RTC counts whole seconds.
+// Between two samples the offset changes by the chip's frequency error;
+// from that slope the aging offset (~0.1 ppm per LSB, higher = slower) is
+// retuned to cancel the drift, plus a small bias that works the remaining
+// offset off over SLEW_HORIZON_S instead of stepping the time. Only
+// offsets of STEP_MS or more (first sync, DST change, lost power) are
+// stepped.
+class ClockDiscipline
+{
+public:
+  static const int32_t STEP_MS = 2000;
+  static const uint32_t MIN_BASELINE_S = 6 * 3600; // Between frequency estimates
+  static const uint32_t SLEW_HORIZON_S = 2 * 86400;
+  static constexpr float AGING_PPM = 0.1f;
+
+  void reset(int8_t aging); // Aging currently in the chip, forgets the baseline
+
+  // offsetMs: RTC minus NTP local time; at: monotonic seconds (uptime)
+  clock_correction_t sample(int32_t offsetMs, uint32_t at);
+
+  bool hasEstimate();
+  float driftPpm();   // The chip's own drift, before aging
+  int8_t aging();
+  int32_t lastOffsetMs();
+
+private:
+  int8_t _aging = 0;
+  bool _have_ref = false;
+  int32_t _ref_offset_ms = 0;
+  uint32_t _ref_at = 0;
+
+  bool _have_estimate = false;
+  float _drift_ppm = 0;
+  int32_t _last_offset_ms = 0;
+};
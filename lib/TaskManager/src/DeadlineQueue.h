@@ -0,0 +1,116 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Fixed-capacity set of named deadlines on the millis() timeline, kept
+// sorted so the next one to expire is always at the front. Comparisons are
+// wrap-safe, so deadlines survive the 49.7 day millis() rollover as long as
+// they are less than ~24 days away. With a handful of timers a sorted array
+// beats a timer wheel on both RAM and code size.
+template <uint8_t CAPACITY>
+class DeadlineQueue
+{
+public:
+  // Schedules (or reschedules) deadline id at time at
+  bool schedule(uint8_t id, uint32_t at)
+  {
+    cancel(id);
+    if (_count >= CAPACITY)
+    {
+      return false;
+    }
+
+    uint8_t pos = _count++;
+    while (pos > 0 && before(at, _entries[pos - 1].at))
+    {
+      _entries[pos] = _entries[pos - 1];
+      pos--;
+    }
+    _entries[pos].at = at;
+    _entries[pos].id = id;
+    return true;
+  }
+
+  bool cancel(uint8_t id)
+  {
+    for (uint8_t i = 0; i < _count; i++)
+    {
+      if (_entries[i].id == id)
+      {
+        remove(i);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void clear() { _count = 0; }
+
+  bool pending(uint8_t id) const
+  {
+    for (uint8_t i = 0; i < _count; i++)
+    {
+      if (_entries[i].id == id) return true;
+    }
+    return false;
+  }
+
+  // Deadline of id, or false when it is not scheduled
+  bool deadline(uint8_t id, uint32_t &at) const
+  {
+    for (uint8_t i = 0; i < _count; i++)
+    {
+      if (_entries[i].id == id)
+      {
+        at = _entries[i].at;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Earliest deadline, or false when the queue is empty
+  bool next(uint32_t &at) const
+  {
+    if (_count == 0) return false;
+    at = _entries[0].at;
+    return true;
+  }
+
+  // Removes and returns the earliest expired deadline, -1 when none is due.
+  // expiredAt receives its scheduled time so chained deadlines don't drift.
+  int popDue(uint32_t now, uint32_t *expiredAt = nullptr)
+  {
+    if (_count == 0 || before(now, _entries[0].at))
+    {
+      return -1;
+    }
+    uint8_t id = _entries[0].id;
+    if (expiredAt != nullptr) *expiredAt = _entries[0].at;
+    remove(0);
+    return id;
+  }
+
+  uint8_t size() const { return _count; }
+
+  static bool before(uint32_t a, uint32_t b) { return (int32_t)(a - b) < 0; }
+
+private:
+  typedef struct
+  {
+    uint32_t at;
+    uint8_t id;
+  } entry_t;
+
+  void remove(uint8_t i)
+  {
+    _count--;
+    for (; i < _count; i++)
+    {
+      _entries[i] = _entries[i + 1];
+    }
+  }
+
+  entry_t _entries[CAPACITY];
+  uint8_t _count = 0;
+};
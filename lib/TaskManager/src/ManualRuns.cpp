@@ -0,0 +1,200 @@
+#include "ManualRuns.h"
+#include <esp32-hal-log.h>
+
+ManualRuns::ManualRuns(TaskManager& taskManager) : _taskManager(taskManager)
+{
+}
+
+void ManualRuns::setCallback(ValveSetCallback setValve)
+{
+  _onValveSet = setValve; // Store callback
+}
+
+void ManualRuns::setMaxOpen(uint8_t zones)
+{
+  _max_open = zones > 0 ? zones : 1;
+}
+
+bool ManualRuns::request(valve_mask_t valves, uint16_t duration, uint8_t priority)
+{
+  if (duration == 0)
+  {
+    cancel(valves);
+    return true;
+  }
+
+  // Already open: restart the zone's timer with the new duration
+  valve_mask_t extend = valves & _open;
+  for (uint8_t zone = 0; zone < MAX_ZONES; zone++)
+  {
+    if (extend & valve_bit(zone))
+    {
+      _expiry.schedule(zone, _now_ms + duration * 1000UL);
+    }
+  }
+
+  valves &= ~_open;
+  if (valves != 0)
+  {
+    if (_queue_count >= MAX_MANUAL_REQUESTS)
+    {
+      log_w("Manual run queue full");
+      return false;
+    }
+    _queue[_queue_count++] = {valves, duration, priority, ++_seq};
+    log_d("Manual run queued: valves=%llx, duration=%ds, priority=%d", (unsigned long long)valves, duration, priority);
+  }
+
+  update();
+  return true;
+}
+
+void ManualRuns::cancel(valve_mask_t valves)
+{
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < _queue_count; i++)
+  {
+    _queue[i].valves &= ~valves;
+    if (_queue[i].valves != 0)
+    {
+      _queue[kept++] = _queue[i];
+    }
+  }
+  _queue_count = kept;
+
+  for (uint8_t zone = 0; zone < MAX_ZONES; zone++)
+  {
+    if (valves & _open & valve_bit(zone))
+    {
+      _expiry.cancel(zone);
+    }
+  }
+  _open &= ~valves;
+
+  update();
+}
+
+void ManualRuns::tick(uint32_t nowMs)
+{
+  _now_ms = nowMs;
+
+  bool expired = false;
+  int zone;
+  while ((zone = _expiry.popDue(nowMs)) >= 0)
+  {
+    log_d("Manual run of zone %d finished", zone);
+    _open &= ~valve_bit(zone);
+    expired = true;
+  }
+
+  if (expired)
+  {
+    update();
+  }
+}
+
+bool ManualRuns::nextDeadline(uint32_t& at)
+{
+  return _expiry.next(at);
+}
+
+bool ManualRuns::isActive()
+{
+  return _open != 0 || _queue_count != 0;
+}
+
+valve_mask_t ManualRuns::openValves()
+{
+  return _open;
+}
+
+uint8_t ManualRuns::queued()
+{
+  return _queue_count;
+}
+
+uint16_t ManualRuns::timeLeft(uint8_t zone)
+{
+  uint32_t at;
+  if (zone >= MAX_ZONES || !_expiry.deadline(zone, at) || DeadlineQueue<MAX_ZONES>::before(at, _now_ms))
+  {
+    return 0;
+  }
+  return (at - _now_ms + 999) / 1000;
+}
+
+int8_t ManualRuns::nextRequest()
+{
+  int8_t best = -1;
+  for (uint8_t i = 0; i < _queue_count; i++)
+  {
+    if (best < 0 || _queue[i].priority > _queue[best].priority ||
+        (_queue[i].priority == _queue[best].priority && _queue[i].seq < _queue[best].seq))
+    {
+      best = i;
+    }
+  }
+  return best;
+}
+
+void ManualRuns::update()
+{
+  // Admit queued requests in priority order while they fit
+  int8_t idx;
+  while ((idx = nextRequest()) >= 0)
+  {
+    manual_request_t& req = _queue[idx];
+    req.valves &= ~_open; // Opened meanwhile by another request
+    if (req.valves != 0)
+    {
+      if (_open != 0 && valve_count(_open) + valve_count(req.valves) > _max_open)
+      {
+        break;
+      }
+
+      for (uint8_t zone = 0; zone < MAX_ZONES; zone++)
+      {
+        if (req.valves & valve_bit(zone))
+        {
+          _expiry.schedule(zone, _now_ms + req.duration * 1000UL);
+        }
+      }
+      _open |= req.valves;
+      log_i("Manual run: valves=%llx for %ds", (unsigned long long)req.valves, req.duration);
+    }
+
+    _queue[idx] = _queue[--_queue_count];
+  }
+
+  if (_open != 0 && !_paused_program)
+  {
+    _taskManager.pause();
+    _paused_program = true;
+  }
+
+  if (_open == 0 && _paused_program)
+  {
+    _paused_program = false;
+    _output = 0;
+    if (!_taskManager.isRunning())
+    {
+      valve_setting_t setting = {0, 0};
+      if (_onValveSet)
+      {
+        _onValveSet(&setting);
+      }
+    }
+    _taskManager.resume(); // Drives the program's valves again, if it runs
+    return;
+  }
+
+  if (_open != _output)
+  {
+    _output = _open;
+    valve_setting_t setting = {_open, 0};
+    if (_onValveSet)
+    {
+      _onValveSet(&setting); // Call the callback to change valve state
+    }
+  }
+}
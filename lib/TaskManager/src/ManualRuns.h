@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Arduino.h>
+#include "TaskManager.h"
+#include "ZonePlanner.h"
+
+constexpr uint8_t MAX_MANUAL_REQUESTS = 8;
+
+typedef struct
+{
+  valve_mask_t valves; // Zones still waiting to open
+  uint16_t duration;   // Seconds each zone stays open
+  uint8_t priority;    // Higher runs first
+  uint32_t seq;        // Arrival order within a priority
+} manual_request_t;
+
+// Manual zone runs next to the scheduled program. Every open zone has its
+// own expiry timer, so a forgotten run always ends. Requests that would
+// open more than maxOpen zones at once wait in a priority queue (strict
+// order, no overtaking, so nothing starves) and are admitted as zones close.
+// While any manual zone is open the program is paused, not stopped: its
+// step timer is frozen and it carries on from the same point afterwards.
+class ManualRuns
+{
+public:
+  ManualRuns(TaskManager& taskManager);
+
+  void setCallback(ValveSetCallback setValve);
+  void setMaxOpen(uint8_t zones); // Zones open at once, a larger single request still runs alone
+
+  // Zones already open get the new duration; 0 seconds closes/dequeues them
+  bool request(valve_mask_t valves, uint16_t duration, uint8_t priority = 0);
+  void cancel(valve_mask_t valves); // Close open and drop queued zones in valves
+
+  void tick(uint32_t nowMs); // millis(), after TaskManager::tick()
+  bool nextDeadline(uint32_t& at);
+
+  bool isActive();
+  valve_mask_t openValves();
+  uint8_t queued();
+  uint16_t timeLeft(uint8_t zone); // Seconds, 0 when the zone is not open
+
+private:
+  void update();
+  int8_t nextRequest();
+
+  TaskManager& _taskManager;
+  DeadlineQueue<MAX_ZONES> _expiry; // id = zone
+  manual_request_t _queue[MAX_MANUAL_REQUESTS] = {};
+  uint8_t _queue_count = 0;
+  uint32_t _seq = 0;
+  uint32_t _now_ms = 0;
+
+  valve_mask_t _open = 0;
+  valve_mask_t _output = 0;
+  uint8_t _max_open = 2;
+  bool _paused_program = false;
+
+  ValveSetCallback _onValveSet = nullptr; // Store callback
+};
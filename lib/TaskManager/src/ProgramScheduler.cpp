@@ -0,0 +1,300 @@
+#include "ProgramScheduler.h"
+#include <esp32-hal-log.h>
+
+static const uint16_t MAX_SEARCH_DAYS = 400; // a year plus slack for seasons
+
+static void civil_from_days(int32_t z, uint16_t &year, uint8_t &month, uint8_t &day)
+{
+  z += 719468;
+  const int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+  const uint32_t doe = (uint32_t)(z - era * 146097);
+  const uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const uint32_t mp = (5 * doy + 2) / 153;
+  day = doy - (153 * mp + 2) / 5 + 1;
+  month = mp < 10 ? mp + 3 : mp - 9;
+  year = yoe + era * 400 + (month <= 2);
+}
+
+static bool day_matches(const program_t &program, uint32_t dayNumber)
+{
+  uint8_t weekday = (dayNumber + 4) % 7; // 1970-01-01 was a Thursday
+  if ((program.weekdays & (1 << weekday)) == 0)
+  {
+    return false;
+  }
+
+  uint16_t year;
+  uint8_t month, day;
+  civil_from_days(dayNumber, year, month, day);
+
+  if (program.day_filter == DAYS_ODD && day % 2 == 0) return false;
+  if (program.day_filter == DAYS_EVEN && day % 2 != 0) return false;
+
+  if (program.season_from != 0 && program.season_to != 0)
+  {
+    uint16_t mmdd = month * 100 + day;
+    if (program.season_from <= program.season_to)
+    {
+      if (mmdd < program.season_from || mmdd > program.season_to) return false;
+    }
+    else if (mmdd < program.season_from && mmdd > program.season_to) // wraps over New Year
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint32_t ProgramScheduler::nextFire(const program_t &program, uint32_t after)
+{
+  if (!program.enabled || program.start_count == 0 || program.weekdays == 0)
+  {
+    return NO_RUN;
+  }
+
+  uint32_t dayNumber = after / 86400;
+  for (uint16_t i = 0; i < MAX_SEARCH_DAYS; i++, dayNumber++)
+  {
+    if (!day_matches(program, dayNumber))
+    {
+      continue;
+    }
+
+    for (uint8_t s = 0; s < program.start_count; s++)
+    {
+      uint32_t at = dayNumber * 86400 + program.starts[s] * 60;
+      if (at > after)
+      {
+        return at;
+      }
+    }
+  }
+  return NO_RUN;
+}
+
+static bool valid_mmdd(uint16_t mmdd)
+{
+  uint8_t month = mmdd / 100;
+  uint8_t day = mmdd % 100;
+  return month >= 1 && month <= 12 && day >= 1 && day <= 31;
+}
+
+bool ProgramScheduler::isValid(const program_t &program)
+{
+  if (program.start_count > MAX_PROGRAM_STARTS || program.weekdays > WEEKDAYS_ALL || program.day_filter > DAYS_EVEN)
+  {
+    return false;
+  }
+
+  if (program.season_from != 0 || program.season_to != 0)
+  {
+    // All year is both bounds 0; a single 0 is not a date
+    if (!valid_mmdd(program.season_from) || !valid_mmdd(program.season_to))
+    {
+      return false;
+    }
+  }
+
+  for (uint8_t s = 0; s < program.start_count; s++)
+  {
+    if (program.starts[s] >= 24 * 60 || (s > 0 && program.starts[s] <= program.starts[s - 1]))
+    {
+      return false; // Start times must be ascending minutes of the day
+    }
+  }
+  return true;
+}
+
+bool ProgramScheduler::setProgram(uint8_t idx, const program_t &program)
+{
+  if (idx >= MAX_PROGRAMS || !isValid(program))
+  {
+    log_e("Invalid program %d", idx);
+    return false;
+  }
+
+  _programs[idx] = program;
+  _index_valid = false;
+  return true;
+}
+
+const program_t *ProgramScheduler::program(uint8_t idx)
+{
+  return idx < MAX_PROGRAMS ? &_programs[idx] : nullptr;
+}
+
+void ProgramScheduler::clearPrograms()
+{
+  memset(_programs, 0, sizeof(_programs));
+  _index_valid = false;
+}
+
+void ProgramScheduler::insert(uint8_t program, uint32_t at)
+{
+  if (at == NO_RUN)
+  {
+    return;
+  }
+
+  uint8_t pos = _index_count++;
+  while (pos > 0 && _index[pos - 1].at > at)
+  {
+    _index[pos] = _index[pos - 1];
+    pos--;
+  }
+  _index[pos].at = at;
+  _index[pos].program = program;
+}
+
+void ProgramScheduler::popHead()
+{
+  _index_count--;
+  memmove(&_index[0], &_index[1], _index_count * sizeof(index_entry_t));
+}
+
+void ProgramScheduler::rebuild()
+{
+  _index_count = 0;
+  for (uint8_t p = 0; p < MAX_PROGRAMS; p++)
+  {
+    insert(p, nextFire(_programs[p], _handled));
+  }
+  _index_valid = true;
+  log_d("Program index rebuilt, %d entries, next at %u", _index_count, nextRun());
+}
+
+void ProgramScheduler::resumeFrom(uint32_t handled)
+{
+  _handled = handled;
+  _started = true;
+  _have_last = false;
+  _index_valid = false;
+}
+
+void ProgramScheduler::setCatchUp(uint32_t seconds)
+{
+  _catch_up = seconds;
+}
+
+void ProgramScheduler::setMissedCallback(MissedRunCallback onMissed)
+{
+  _onMissed = onMissed; // Store callback
+}
+
+bool ProgramScheduler::due(uint32_t now, uint32_t nowMs)
+{
+  // How far the clock moved beyond the time that passed
+  int32_t jump = 0;
+  if (_have_last)
+  {
+    jump = (int32_t)(now - _last_now) - (int32_t)((nowMs - _last_ms) / 1000);
+  }
+
+  if (!_started || jump < -(int32_t)MAX_STEP_S || jump > (int32_t)MAX_STEP_S)
+  {
+    // Boot, or a clock that was far off was repaired: start over at the
+    // current minute, so a start right now still runs
+    _handled = now - now % 60 - 1;
+    _started = true;
+    _index_valid = false;
+  }
+  if (!_index_valid)
+  {
+    rebuild();
+  }
+  _have_last = true;
+  _last_now = now;
+  _last_ms = nowMs;
+
+  uint32_t credit = jump > 0 ? jump : 0;
+  uint32_t window = max<uint32_t>(_catch_up, 60);
+
+  bool fired = false;
+  while (_index_count > 0 && _index[0].at <= now)
+  {
+    uint8_t p = _index[0].program;
+    uint32_t at = _index[0].at;
+    popHead();
+
+    uint32_t late = now - at > credit ? now - at - credit : 0;
+    uint32_t after = at;
+    if (late < window)
+    {
+      if (late >= 60)
+      {
+        log_w("Program %d start at %u caught up %u s late", p, at, late);
+      }
+      fired = true;
+    }
+    else
+    {
+      log_w("Program %d start at %u missed by %u s", p, at, late);
+      if (_onMissed)
+      {
+        _onMissed(p, at);
+      }
+      // Only one report per outage: go straight to what can still run
+      after = max(at, now - credit - window);
+    }
+    insert(p, nextFire(_programs[p], after));
+  }
+
+  if ((int32_t)(now - _handled) > 0)
+  {
+    _handled = now;
+  }
+  return fired;
+}
+
+uint32_t ProgramScheduler::nextRun()
+{
+  if (!_index_valid)
+  {
+    rebuild();
+  }
+  return _index_count > 0 ? _index[0].at : NO_RUN;
+}
+
+uint8_t ProgramScheduler::nextRuns(uint32_t *out, uint8_t count)
+{
+  if (!_index_valid)
+  {
+    rebuild();
+  }
+
+  // Merge the programs' upcoming starts; only the head of each is indexed
+  uint32_t cursor[MAX_PROGRAMS];
+  for (uint8_t p = 0; p < MAX_PROGRAMS; p++)
+  {
+    cursor[p] = NO_RUN;
+  }
+  for (uint8_t i = 0; i < _index_count; i++)
+  {
+    cursor[_index[i].program] = _index[i].at;
+  }
+
+  uint8_t n = 0;
+  while (n < count)
+  {
+    uint8_t best = MAX_PROGRAMS;
+    for (uint8_t p = 0; p < MAX_PROGRAMS; p++)
+    {
+      if (cursor[p] != NO_RUN && (best == MAX_PROGRAMS || cursor[p] < cursor[best]))
+      {
+        best = p;
+      }
+    }
+    if (best == MAX_PROGRAMS)
+    {
+      break;
+    }
+
+    if (n == 0 || out[n - 1] != cursor[best])
+    {
+      out[n++] = cursor[best];
+    }
+    cursor[best] = nextFire(_programs[best], cursor[best]);
+  }
+  return n;
+}
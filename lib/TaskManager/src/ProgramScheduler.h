@@ -0,0 +1,97 @@
+#pragma once
+
+#include <Arduino.h>
+
+constexpr uint8_t MAX_PROGRAMS = 4;
+constexpr uint8_t MAX_PROGRAM_STARTS = 4;
+
+constexpr uint32_t NO_RUN = 0xFFFFFFFF;
+constexpr uint32_t DEFAULT_CATCH_UP_S = 3600; // How late a start may still run
+
+#define WEEKDAYS_ALL 0x7F // bit 0 = Sunday ... bit 6 = Saturday
+
+typedef enum : uint8_t
+{
+  DAYS_ALL = 0,
+  DAYS_ODD = 1, // 1st, 3rd, ... day of the month
+  DAYS_EVEN = 2
+} day_filter_t;
+
+// When a program runs. Times are local wall-clock seconds as kept by the
+// RTC (DateTime::unixtime()), so no time zone handling is needed here.
+typedef struct
+{
+  uint16_t starts[MAX_PROGRAM_STARTS]; // Minutes after midnight, ascending
+  uint8_t start_count;
+  uint8_t weekdays;     // WEEKDAYS_ALL or a mask of days
+  uint8_t day_filter;   // day_filter_t
+  uint8_t enabled;
+  uint16_t season_from; // month * 100 + day, 0 = all year
+  uint16_t season_to;   // inclusive, may wrap over New Year
+} program_t;
+
+typedef void (*MissedRunCallback)(uint8_t program, uint32_t at);
+
+// Keeps every enabled program's next fire time in a small sorted index, so
+// the per-minute check is a single comparison against the head. The index
+// is rebuilt on first use after programs change.
+//
+// A start is a deadline that is due once the clock has crossed it, not a
+// minute that has to be hit. Every start up to a high-water mark has been
+// run or reported, so a clock stepped back (end of DST, NTP correction)
+// never repeats one. Lateness is measured against the monotonic clock: a
+// step forward of up to MAX_STEP_S (start of DST, NTP correction) jumps
+// over starts without making them late, so they still run.
+class ProgramScheduler
+{
+public:
+  static const uint32_t MAX_STEP_S = 3 * 3600; // Larger steps are clock repairs
+
+  bool setProgram(uint8_t idx, const program_t &program);
+  const program_t *program(uint8_t idx);
+  void clearPrograms();
+
+  // True when a program start was crossed since the last call and is less
+  // than the catch-up window late; several of them run as one. Starts that
+  // are later than that are reported to the missed callback instead.
+  // now: local RTC time, nowMs: millis()
+  bool due(uint32_t now, uint32_t nowMs);
+
+  // At boot, before the first due(): starts up to handled were dealt with
+  // before the restart, later ones are caught up within the window
+  void resumeFrom(uint32_t handled);
+  void setCatchUp(uint32_t seconds); // 0 = only within the start's minute
+  void setMissedCallback(MissedRunCallback onMissed);
+
+  uint32_t nextRun();
+  uint8_t nextRuns(uint32_t *out, uint8_t count);
+
+  static uint32_t nextFire(const program_t &program, uint32_t after);
+  static bool isValid(const program_t &program); // What setProgram() accepts
+
+private:
+  typedef struct
+  {
+    uint32_t at;
+    uint8_t program;
+  } index_entry_t;
+
+  void rebuild();
+  void insert(uint8_t program, uint32_t at);
+  void popHead();
+
+  program_t _programs[MAX_PROGRAMS] = {};
+
+  index_entry_t _index[MAX_PROGRAMS];
+  uint8_t _index_count = 0;
+  bool _index_valid = false;
+
+  uint32_t _catch_up = DEFAULT_CATCH_UP_S;
+  uint32_t _handled = 0; // Every start at or before this was run or reported
+  bool _started = false; // _handled is set
+  bool _have_last = false;
+  uint32_t _last_now = 0;
+  uint32_t _last_ms = 0;
+
+  MissedRunCallback _onMissed = nullptr; // Store callback
+};
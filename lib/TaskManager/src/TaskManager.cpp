@@ -1,42 +1,27 @@
 #include "TaskManager.h"
 #include <esp32-hal-log.h>
 
-TaskManager::TaskManager(uint8_t hour, uint8_t minute, bool usePsram)
+TaskManager::TaskManager(uint8_t hour, uint8_t minute)
 {
-  if (usePsram && !psramFound())
-  {
-    log_e("PSRAM requested but not available!");
-    usePsram = false;
-  }
-  else
-  {
-    log_i("PSRAM is available and will be used.");
-    usePsram = usePsram;
-  }
-
-  _hour = hour;
-  _minute = minute;
+  setStartTime(hour, minute);
 
   stop();
 }
 
-TaskManager::~TaskManager()
+void TaskManager::setStartTime(uint8_t hour, uint8_t minute)
 {
-  for (uint8_t i = 0; i < MAX_TASKS; i++)
-  {
-    if (_valve_settings[i] != nullptr)
-    {
-      free(_valve_settings[i]);  // Works for both malloc and ps_malloc
-      _valve_settings[i] = nullptr;
-    }
-  }
-  log_d("TaskManager destroyed, memory freed");
+  program_t program = {};
+  program.starts[0] = hour * 60 + minute;
+  program.start_count = 1;
+  program.weekdays = WEEKDAYS_ALL;
+  program.day_filter = DAYS_ALL;
+  program.enabled = 1;
+  _scheduler.setProgram(0, program);
 }
 
-void TaskManager::setStartTime(uint8_t hour, uint8_t minute)
+ProgramScheduler& TaskManager::scheduler()
 {
-  _hour = hour;
-  _minute = minute;
+  return _scheduler;
 }
 
 valve_setting_t* TaskManager::actualValveSetting()
@@ -44,39 +29,73 @@ valve_setting_t* TaskManager::actualValveSetting()
   return _actual_valve_settings;
 }
 
-uint8_t TaskManager::timeLeft()
+uint16_t TaskManager::timeLeft()
 {
-  return _actual_delay;
+  if (_paused)
+  {
+    return _current_valve_setting >= 0 ? (_paused_left_ms + 999) / 1000 : 0;
+  }
+
+  uint32_t at;
+  if (!_deadlines.deadline(DEADLINE_STEP_END, at) || DeadlineQueue<4>::before(at, _now_ms))
+  {
+    return 0;
+  }
+  return (at - _now_ms + 999) / 1000;
 }
 
 const char* TaskManager::executeAt() { 
   static char info[6];
-  snprintf(info, sizeof(info), "%02d:%02d", _hour, _minute);
+  uint32_t next = _scheduler.nextRun();
+  if (next == NO_RUN) {
+    return "--:--";
+  }
+  snprintf(info, sizeof(info), "%02d:%02d", (int)(next / 3600 % 24), (int)(next / 60 % 60));
   return info;
 }
 
 const char* TaskManager::statusMessage() { 
   static char info[21];
 
-  if (_current_valve_setting < 0 || _actual_valve_settings == nullptr) {
-    snprintf(info, sizeof(info), "Cekam do: %02d:%02d", _hour, _minute);
+  if (_current_valve_setting < 0) {
+    snprintf(info, sizeof(info), "Cekam do: %s", executeAt());
     return info;
   }
 
-  if (_pump_is_ready == 0) {
+  if (_paused) {
+    snprintf(info, sizeof(info), "Pauza: rucni zavlaha");
+    return info;
+  }
+
+  if (_pump_starting) {
+    snprintf(info, sizeof(info), "Cekam na ventily");
+    return info;
+  }
+
+  if (_pump_is_ready == 0 || _actual_valve_settings == nullptr) {
     snprintf(info, sizeof(info), "Cekam na cerpadlo");
     return info;
   }
   
-  //Ukol:00 - 00 [00]
-  snprintf(info, sizeof(info), "Ukol:%2d - %02d [%02d]",_current_valve_setting,  _actual_delay, _actual_valve_settings->duration);
+  //Ukol:00 - 00 [00], minutes rounded up
+  snprintf(info, sizeof(info), "Ukol:%2d - %02d [%02d]", _current_valve_setting, (timeLeft() + 59) / 60, (_actual_valve_settings->duration + 59) / 60);
   return info;
 }
 
 
+int TaskManager::currentStep()
+{
+  return _current_valve_setting;
+}
+
 bool TaskManager::isRunning()
 {
-  return _actual_valve_settings != nullptr;
+  return _current_valve_setting >= 0;
+}
+
+bool TaskManager::isPaused()
+{
+  return _paused;
 }
 
 bool TaskManager::isPumpOn()
@@ -84,103 +103,341 @@ bool TaskManager::isPumpOn()
   return _pump_is_ready != 0;
 }
 
-bool TaskManager::setValveSetting(uint8_t idx, uint16_t valves, uint8_t duration)
+bool TaskManager::setValveSetting(uint8_t idx, valve_mask_t valves, uint16_t duration)
 {
-  valve_setting_t *setting;
-  if (usePsram)
+  // Steps are contiguous: overwrite an existing one or append the next
+  if (idx >= MAX_TASKS || idx > _valve_setting_count)
   {
-    setting = (valve_setting_t *)ps_malloc(sizeof(valve_setting_t));
+    log_e("Invalid valve setting index %d (count %d, max %d)", idx, _valve_setting_count, MAX_TASKS);
+    return false;
   }
-  else
+
+  _valve_settings[idx].valves = valves;
+  _valve_settings[idx].duration = duration;
+  if (idx == _valve_setting_count)
   {
-    setting = (valve_setting_t *)malloc(sizeof(valve_setting_t));
+    _valve_setting_count++;
   }
+  return true;
+}
 
-  if (setting != nullptr)
+void TaskManager::clearValveSettings()
+{
+  if (isRunning())
   {
-    setting->valves = valves;
-    setting->duration = duration;
-    _valve_settings[idx] = setting;
-    return true;
+    stop();
   }
-  else
+  _valve_setting_count = 0;
+  _staged = false;
+}
+
+bool TaskManager::stageValveSettings(const valve_setting_t* steps, uint8_t count)
+{
+  if (count > MAX_TASKS)
   {
-    log_e("Failed to allocate memory for valve setting at index %d", idx);
+    log_e("Too many valve settings: %d (max %d)", count, MAX_TASKS);
     return false;
   }
+
+  valve_setting_t* spare = _valve_settings == _tables[0] ? _tables[1] : _tables[0];
+  memcpy(spare, steps, count * sizeof(valve_setting_t));
+  _staged_count = count;
+  _staged = true;
+
+  if (!isRunning())
+  {
+    swapValveSettings();
+  }
+  return true;
 }
 
-void TaskManager::start()
+bool TaskManager::hasStagedValveSettings()
 {
-  log_d("Starting ...");
-    _current_valve_setting = 0; // Start from the first task
-    if (_onPumpSet)
+  return _staged;
+}
+
+void TaskManager::swapValveSettings()
+{
+  _valve_settings = _valve_settings == _tables[0] ? _tables[1] : _tables[0];
+  _valve_setting_count = _staged_count;
+  _staged = false;
+  log_d("Switched to new step table: %d steps", _valve_setting_count);
+}
+
+uint8_t TaskManager::valveSettingCount()
+{
+  return _valve_setting_count;
+}
+
+valve_setting_t* TaskManager::valveSetting(uint8_t idx)
+{
+  return idx < _valve_setting_count ? &_valve_settings[idx] : nullptr;
+}
+
+void TaskManager::start(uint8_t step, uint16_t left)
+{
+  log_d("Starting at step %d ...", step);
+    _pump_is_ready = 0;
+    _deadlines.clear();
+    if (_staged)
     {
-      _onPumpSet(true); // Turn on the pump
+      swapValveSettings();
+    }
+
+    // Open the first zone before the pump starts: priming water goes to a
+    // zone instead of against closed valves, and counts toward its time.
+    // The pump waits in tick() until the zone is confirmed open.
+    activate(step, _now_ms);
+    if (_current_valve_setting < 0)
+    {
+      return; // Nothing to run
     }
+
+    // Resuming an interrupted step: only what was left of it
+    if (_current_valve_setting == step && left > 0 && left < _actual_valve_settings->duration)
+    {
+      if (_paused)
+      {
+        _paused_left_ms = left * 1000UL;
+      }
+      else
+      {
+        _deadlines.schedule(DEADLINE_STEP_END, _now_ms + left * 1000UL);
+      }
+    }
+
+    _pump_starting = true;
+    startPump();
 }
 
-void TaskManager::stop(){
+void TaskManager::stop(bool rundown){
     log_d("Stopping ...");
     _actual_valve_settings = nullptr;
     _pump_is_ready = 0;
+    _pump_starting = false;
+    _deadlines.clear();
     if (_onPumpSet)
     {
       _onPumpSet(false); // Turn off the pump
     }
     _current_valve_setting = -1;
+    if (_staged)
+    {
+      swapValveSettings(); // The cycle that used the old table is over
+    }
+
+    // Keep the valves open while the pump spins down
+    if (rundown && _output.valves != 0)
+    {
+      _deadlines.schedule(DEADLINE_VALVES_CLOSE, _now_ms + PUMP_RUNDOWN_MS);
+    }
+    else
+    {
+      output(0);
+    }
+}
+
+void TaskManager::pause()
+{
+  if (_paused)
+  {
+    return;
+  }
+
+  log_d("Pausing ...");
+  uint32_t at;
+  _paused_left_ms = 0;
+  if (_deadlines.deadline(DEADLINE_STEP_END, at) && DeadlineQueue<4>::before(_now_ms, at))
+  {
+    _paused_left_ms = at - _now_ms;
+  }
+  _deadlines.cancel(DEADLINE_STEP_END);
+  _deadlines.cancel(DEADLINE_VALVE_BREAK);
+  _deadlines.cancel(DEADLINE_VALVES_CLOSE);
+
+  _output.valves = 0; // Whoever paused us drives the valves now
+  _paused = true;
 }
 
-void TaskManager::loop(uint8_t hour, uint8_t minute)
+void TaskManager::resume()
 {
-  log_d("TaskManager loop: %02d:%02d, executed:%d, pump state:%d", hour, minute, _current_valve_setting, _pump_is_ready);
+  if (!_paused)
+  {
+    return;
+  }
 
-  if (_current_valve_setting == -1)
+  log_d("Resuming ...");
+  _paused = false;
+  if (_current_valve_setting >= 0)
   {
-    if (hour != _hour || minute != _minute)
-    {
-      return; // Not the time to start tasks yet
-    }
+    _deadlines.schedule(DEADLINE_STEP_END, _now_ms + _paused_left_ms);
+    output(_actual_valve_settings->valves);
+  }
+}
+
+void TaskManager::loop(uint32_t now, uint32_t nowMs)
+{
+  _now_ms = nowMs; // A start below times its first step from here
+  log_d("TaskManager loop: %u, executed:%d, pump state:%d", now, _current_valve_setting, _pump_is_ready);
+
+  // Always consult the scheduler so starts during a running cycle are
+  // consumed rather than replayed once it ends
+  bool due = _scheduler.due(now, nowMs);
 
-    log_d("Initial time match at %02d:%02d", hour, minute);
+  if (_current_valve_setting == -1 && due)
+  {
+    log_d("Program start at %02d:%02d", (int)(now / 3600 % 24), (int)(now / 60 % 60));
     start();
   }
+}
 
-  if (_pump_is_ready == 0 && _onIsReady)
+void TaskManager::tick(uint32_t nowMs)
+{
+  _now_ms = nowMs;
+
+  startPump();
+
+  if (_current_valve_setting >= 0 && _pump_is_ready == 0 && !_pump_starting && (!_onIsReady || _onIsReady()))
   {
-    _pump_is_ready = _onIsReady() ? 1 : 0;
-    log_d("Pump readiness check: %d", _pump_is_ready);
-    return; // Wait until the pump is ready
+    _pump_is_ready = 1;
+    log_d("Pump ready");
   }
 
-  if (_actual_delay > 0)
+  int id;
+  uint32_t expiredAt;
+  while ((id = _deadlines.popDue(nowMs, &expiredAt)) >= 0)
   {
-    _actual_delay--;
-    log_d("Decrementing actual delay: %d", _actual_delay);
-    return; // Still waiting
+    switch (id)
+    {
+    case DEADLINE_STEP_END:
+      if (_pump_is_ready == 0 && _actual_valve_settings->valves != 0)
+      {
+        // A first step shorter than priming waits for the pump
+        _deadlines.schedule(DEADLINE_STEP_END, nowMs + PUMP_POLL_MS);
+        break;
+      }
+      // Chain from the scheduled time, not from when tick() noticed it
+      activate(_current_valve_setting + 1, expiredAt);
+      break;
+
+    case DEADLINE_VALVE_BREAK:
+      if (_actual_valve_settings != nullptr)
+      {
+        output(_actual_valve_settings->valves);
+      }
+      break;
+
+    case DEADLINE_VALVES_CLOSE:
+      output(0);
+      break;
+    }
   }
-  
-  _current_valve_setting++;
-  if (_current_valve_setting >= MAX_TASKS || _valve_settings[_current_valve_setting] == nullptr)
+}
+
+bool TaskManager::nextDeadline(uint32_t& at)
+{
+  bool pending = _deadlines.next(at);
+  if (_current_valve_setting >= 0 && _pump_is_ready == 0)
+  {
+    uint32_t poll = _now_ms + PUMP_POLL_MS;
+    if (!pending || DeadlineQueue<4>::before(poll, at))
+    {
+      at = poll;
+    }
+    return true;
+  }
+  return pending;
+}
+
+void TaskManager::activate(int idx, uint32_t from)
+{
+  while (idx < _valve_setting_count && _valve_settings[idx].duration == 0)
+  {
+    idx++; // Skip empty steps
+  }
+
+  if (idx >= _valve_setting_count)
   {
     stop();
     return;
   }
 
-  _actual_valve_settings = _valve_settings[_current_valve_setting];
-  _actual_delay = _actual_valve_settings->duration;
- 
-  log_d("Switching to valve setting %d: valves=%d, duration=%d", _current_valve_setting, _actual_valve_settings->valves, _actual_delay);
- 
+  _current_valve_setting = idx;
+  _actual_valve_settings = &_valve_settings[idx];
+  _deadlines.cancel(DEADLINE_VALVES_CLOSE);
+  if (_paused)
+  {
+    _paused_left_ms = _actual_valve_settings->duration * 1000UL; // Starts when resumed
+    return;
+  }
+  _deadlines.schedule(DEADLINE_STEP_END, from + _actual_valve_settings->duration * 1000UL);
+
+  log_d("Switching to valve setting %d: valves=%llx, duration=%ds", _current_valve_setting, (unsigned long long)_actual_valve_settings->valves, _actual_valve_settings->duration);
+
+  // Make before break: open the next zones while the previous ones are
+  // still open, close the previous ones after the overlap
+  valve_mask_t previous = _output.valves;
+  if (previous != 0 && (previous & ~_actual_valve_settings->valves) != 0)
+  {
+    output(previous | _actual_valve_settings->valves);
+    _deadlines.schedule(DEADLINE_VALVE_BREAK, _now_ms + VALVE_OVERLAP_MS);
+  }
+  else
+  {
+    _deadlines.cancel(DEADLINE_VALVE_BREAK);
+    output(_actual_valve_settings->valves);
+  }
+}
+
+void TaskManager::startPump()
+{
+  if (_pump_starting && valvesOpen())
+  {
+    _pump_starting = false;
+    if (_onPumpSet)
+    {
+      _onPumpSet(true); // Turn on the pump
+    }
+  }
+}
+
+// While paused the open zones are a manual run's, any of them will do
+bool TaskManager::valvesOpen()
+{
+  if (!_onValvesOpen)
+  {
+    return true;
+  }
+
+  valve_mask_t open = _onValvesOpen();
+  return open != 0 && (_paused || open == _output.valves);
+}
+
+void TaskManager::output(valve_mask_t valves)
+{
+  if (_paused)
+  {
+    return; // Valves belong to whoever paused us
+  }
+
+  if (_output.valves == valves && valves != 0)
+  {
+    return;
+  }
+
+  _output.valves = valves;
+  _output.duration = _actual_valve_settings != nullptr ? _actual_valve_settings->duration : 0;
   if (_onValveSet)
   {
-    _onValveSet(_actual_valve_settings); // Call the callback to change valve state
+    _onValveSet(&_output); // Call the callback to change valve state
   }
 }
 
-void TaskManager::setCallbacks(ValveSetCallback setValve, PumpCallback setPump, std::function<bool ()> isReady)
+void TaskManager::setCallbacks(ValveSetCallback setValve, PumpCallback setPump, std::function<bool ()> isReady,
+                               ValvesOpenCallback valvesOpen)
 {
   _onValveSet = setValve; // Store callback
   _onPumpSet = setPump;   // Store callback
   _onIsReady = isReady;   // Store callback
+  _onValvesOpen = valvesOpen; // Store callback
 }
\ No newline at end of file
@@ -1,37 +1,65 @@
 #pragma once
 
 #include <Arduino.h>
+#include "ProgramScheduler.h"
+#include "DeadlineQueue.h"
+#include "ValveMask.h"
 
-
-#define MAX_TASKS 5
+// Capacity of the step table. Steps live inline in TaskManager, so this is
+// the whole memory cost: 2 * MAX_TASKS * sizeof(valve_setting_t). One step
+// per zone, as a cycle over every zone one after the other needs; a zone
+// plan that changes the open set more often is rejected.
+constexpr uint8_t MAX_TASKS = MAX_ZONES;
 
 typedef struct
 {
-  uint16_t valves;
-  uint8_t duration;
+  valve_mask_t valves;
+  uint16_t duration; // Seconds, up to ~18 hours
 } valve_setting_t;
 
 typedef void (*ValveSetCallback)(valve_setting_t *);
 typedef void (*PumpCallback)(bool);
+typedef valve_mask_t (*ValvesOpenCallback)(); // Valves the outputs were last confirmed to drive
 
 class TaskManager
 {
 public:
-  TaskManager(uint8_t hour, uint8_t minute, bool usePsram = false);
-  ~TaskManager();
-
-  void setStartTime(uint8_t hour, uint8_t minute);  
-  bool setValveSetting(uint8_t idx, uint16_t valves, uint8_t duration);
-  void setCallbacks(ValveSetCallback setValve, PumpCallback setPump, std::function<bool ()> isReady);
+  TaskManager(uint8_t hour, uint8_t minute);
+
+  void setStartTime(uint8_t hour, uint8_t minute); // Single daily start as program 0
+  ProgramScheduler& scheduler();
+
+  bool setValveSetting(uint8_t idx, valve_mask_t valves, uint16_t duration);
+  // Replaces the whole step table. A running cycle finishes on the table it
+  // started with; the new one is swapped in when no cycle runs.
+  bool stageValveSettings(const valve_setting_t* steps, uint8_t count);
+  bool hasStagedValveSettings();
+  void clearValveSettings();
+  uint8_t valveSettingCount();
+  valve_setting_t* valveSetting(uint8_t idx);
+  // With valvesOpen the pump is only switched on once the first step's
+  // zones are confirmed open; without it the valve callback is trusted
+  void setCallbacks(ValveSetCallback setValve, PumpCallback setPump, std::function<bool ()> isReady,
+                    ValvesOpenCallback valvesOpen = nullptr);
 
   valve_setting_t* actualValveSetting();
 
-  void loop(uint8_t hour, uint8_t minute); // Should be called from loop()
+  void loop(uint32_t now, uint32_t nowMs); // Local RTC time (DateTime::unixtime()) and millis(), once per minute alarm
+  void tick(uint32_t nowMs); // millis(), as often as possible - drives step transitions
+  bool nextDeadline(uint32_t& at); // When tick() next has work, for callers that sleep
 
-  void start();
-  void stop();
+  void start(uint8_t step = 0, uint16_t left = 0); // left: seconds of step still to run, 0 = all
+  void stop(bool rundown = true); // rundown: close the valves only after the pump spun down
 
-  uint8_t timeLeft();
+  // While paused the step timer is frozen and the valves are left to
+  // someone else (manual runs); the pump keeps its state. A start while
+  // paused begins frozen. resume() continues where the step left off.
+  void pause();
+  void resume();
+  bool isPaused();
+
+  uint16_t timeLeft(); // Seconds left in the current step
+  int currentStep(); // -1 when idle
   bool isRunning();
   bool isPumpOn();
 
@@ -39,19 +67,45 @@ public:
   const char* statusMessage();
   
 private:
-  uint8_t _hour;
-  uint8_t _minute;
+  enum : uint8_t
+  {
+    DEADLINE_STEP_END,
+    DEADLINE_VALVE_BREAK,  // Close the previous step's zones after the overlap
+    DEADLINE_VALVES_CLOSE  // Close everything once the pump has run down
+  };
+
+  static const uint32_t PUMP_POLL_MS = 1000;
+  static const uint32_t VALVE_OVERLAP_MS = 2000;
+  static const uint32_t PUMP_RUNDOWN_MS = 3000;
+
+  void activate(int idx, uint32_t from);
+  bool valvesOpen();
+  void startPump(); // Once the first zones are open
+  void output(valve_mask_t valves);
+
+  ProgramScheduler _scheduler;
+  DeadlineQueue<4> _deadlines;
+  uint32_t _now_ms = 0;
 
   uint8_t _pump_is_ready = 0;
+  bool _pump_starting = false; // Waits for the first zones to be confirmed open
+  bool _paused = false;
+  uint32_t _paused_left_ms = 0; // Step time left when paused
+
+  void swapValveSettings();
 
-  valve_setting_t* _valve_settings[MAX_TASKS];
-  bool usePsram;
+  valve_setting_t _tables[2][MAX_TASKS] = {}; // Active and staged step table
+  valve_setting_t* _valve_settings = _tables[0]; // Active table
+  uint8_t _valve_setting_count = 0; // Steps 0.._valve_setting_count-1 are set
+  uint8_t _staged_count = 0;
+  bool _staged = false; // The other table waits for the running cycle to end
 
-  valve_setting_t* _actual_valve_settings = nullptr; // Pointer to the current task
-  int _current_valve_setting;
-  uint8_t _actual_delay;
+  valve_setting_t* _actual_valve_settings = nullptr; // Points into _valve_settings
+  valve_setting_t _output = {}; // What the valve callback was last given
+  int _current_valve_setting = -1; // -1 idle, otherwise the step (pending while priming)
 
   ValveSetCallback _onValveSet = nullptr; // Store callback
   PumpCallback _onPumpSet = nullptr; // Store callback
   std::function<bool ()> _onIsReady = nullptr; // Store callback
+  ValvesOpenCallback _onValvesOpen = nullptr; // Store callback
 };
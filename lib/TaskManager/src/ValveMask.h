@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+
+// Zones a controller can address. Bit i of a valve mask is zone i; how
+// many zones are actually wired depends on the expanders fitted.
+constexpr uint8_t MAX_ZONES = 64;
+
+typedef uint64_t valve_mask_t;
+
+constexpr valve_mask_t VALVES_ALL = ~(valve_mask_t)0;
+
+constexpr valve_mask_t valve_bit(uint8_t zone)
+{
+  return (valve_mask_t)1 << zone;
+}
+
+// Zones 0..count-1
+constexpr valve_mask_t valve_mask_first(uint8_t count)
+{
+  return count >= MAX_ZONES ? VALVES_ALL : valve_bit(count) - 1;
+}
+
+inline uint8_t valve_count(valve_mask_t mask)
+{
+  return __builtin_popcountll(mask);
+}
@@ -0,0 +1,103 @@
+#include "ZonePlanner.h"
+#include <esp32-hal-log.h>
+
+bool planZones(const zone_demand_t *zones, uint8_t zoneCount, uint16_t capacity,
+               valve_setting_t *steps, uint8_t maxSteps, zone_plan_t &plan)
+{
+  plan.steps = 0;
+  plan.window = 0;
+
+  if (zoneCount > MAX_ZONES)
+  {
+    return false;
+  }
+
+  // Pending zones, longest first (ties: thirstiest first)
+  uint8_t pending[MAX_ZONES];
+  uint8_t pendingCount = 0;
+  for (uint8_t z = 0; z < zoneCount; z++)
+  {
+    if (zones[z].duration == 0)
+    {
+      continue;
+    }
+    if (zones[z].flow > capacity)
+    {
+      log_e("Zone %d needs %d, more than capacity %d", z, zones[z].flow, capacity);
+      return false;
+    }
+
+    uint8_t pos = pendingCount++;
+    while (pos > 0 && (zones[pending[pos - 1]].duration < zones[z].duration ||
+                       (zones[pending[pos - 1]].duration == zones[z].duration && zones[pending[pos - 1]].flow < zones[z].flow)))
+    {
+      pending[pos] = pending[pos - 1];
+      pos--;
+    }
+    pending[pos] = z;
+  }
+
+  uint32_t ends[MAX_ZONES] = {}; // Finish time of each running zone
+  valve_mask_t open = 0;
+  uint32_t used = 0;
+  uint32_t now = 0;
+
+  while (pendingCount > 0 || open != 0)
+  {
+    // Start every pending zone that fits, in priority order
+    for (uint8_t i = 0; i < pendingCount;)
+    {
+      uint8_t z = pending[i];
+      if (used + zones[z].flow > capacity)
+      {
+        i++;
+        continue;
+      }
+
+      used += zones[z].flow;
+      open |= valve_bit(z);
+      ends[z] = now + zones[z].duration;
+      pendingCount--;
+      memmove(&pending[i], &pending[i + 1], pendingCount - i);
+    }
+
+    uint32_t next = UINT32_MAX;
+    for (uint8_t z = 0; z < zoneCount; z++)
+    {
+      if ((open & valve_bit(z)) && ends[z] < next)
+      {
+        next = ends[z];
+      }
+    }
+
+    // Extend the previous step when the open set did not change
+    if (plan.steps > 0 && steps[plan.steps - 1].valves == open && steps[plan.steps - 1].duration + (next - now) <= UINT16_MAX)
+    {
+      steps[plan.steps - 1].duration += next - now;
+    }
+    else
+    {
+      if (plan.steps >= maxSteps)
+      {
+        log_e("Zone plan needs more than %d steps", maxSteps);
+        return false;
+      }
+      steps[plan.steps].valves = open;
+      steps[plan.steps].duration = next - now;
+      plan.steps++;
+    }
+
+    for (uint8_t z = 0; z < zoneCount; z++)
+    {
+      if ((open & valve_bit(z)) && ends[z] == next)
+      {
+        open &= ~valve_bit(z);
+        used -= zones[z].flow;
+      }
+    }
+    now = next;
+  }
+
+  plan.window = now;
+  return plan.steps > 0;
+}
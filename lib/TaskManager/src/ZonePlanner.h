@@ -0,0 +1,28 @@
+#pragma once
+
+#include <Arduino.h>
+#include "TaskManager.h"
+
+typedef struct
+{
+  uint16_t flow;     // Demand in any unit, as long as capacity uses the same one
+  uint16_t duration; // Seconds, 0 = zone not watered
+} zone_demand_t;
+
+typedef struct
+{
+  uint8_t steps;   // Number of steps written
+  uint32_t window; // Seconds from the first valve opening to the last closing
+} zone_plan_t;
+
+// Packs zones into concurrently running groups whose total flow stays within
+// capacity, shortest overall window first: zones are started longest-first
+// whenever enough capacity is free, and every time a zone finishes the
+// freed capacity is handed to the next zone that fits. The result is a plain
+// sequence of steps (valve mask + duration), one per change of the open set,
+// so TaskManager runs it unchanged. Each zone is open for exactly its duration.
+//
+// Returns false when no zone is watered, a zone alone exceeds capacity or
+// the plan needs more than maxSteps steps.
+bool planZones(const zone_demand_t *zones, uint8_t zoneCount, uint16_t capacity,
+               valve_setting_t *steps, uint8_t maxSteps, zone_plan_t &plan);
@@ -0,0 +1,82 @@
+#pragma once
+
+// Minimal Arduino-ESP32 core surface for host builds. Only what the
+// firmware sources actually use is provided.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <algorithm>
+#include <functional>
+
+#include "WString.h"
+#include "esp32-hal-log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define LOW 0x0
+#define HIGH 0x1
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+
+#define digitalPinToInterrupt(p) (p)
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+using std::max;
+using std::min;
+
+void setup();
+void loop();
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode);
+void detachInterrupt(uint8_t pin);
+
+void randomSeed(unsigned long seed);
+long random(long howbig);
+long random(long howsmall, long howbig);
+
+char *dtostrf(double val, signed char width, unsigned char prec, char *sout);
+
+void configTzTime(const char *tz, const char *server1, const char *server2 = nullptr, const char *server3 = nullptr);
+bool getLocalTime(struct tm *info, uint32_t ms = 5000);
+
+inline uint32_t getCpuFrequencyMhz() { return 160; }
+
+inline bool psramFound() { return false; }
+inline void *ps_malloc(size_t size) { return malloc(size); }
+
+class EspClass
+{
+public:
+  uint64_t getEfuseMac() { return 0x0000A1B2C3D4E5F6ULL; }
+  uint32_t getFreeHeap() { return 0; }
+  void restart();
+};
+
+extern EspClass ESP;
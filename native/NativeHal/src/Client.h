@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+class Client
+{
+public:
+  virtual ~Client() {}
+  virtual int connect(const char *host, uint16_t port) { return 1; }
+  virtual void stop() {}
+  virtual uint8_t connected() { return 1; }
+};
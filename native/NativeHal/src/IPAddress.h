@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include "WString.h"
+
+class IPAddress
+{
+public:
+  IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : _octets{a, b, c, d} {}
+
+  String toString() const
+  {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _octets[0], _octets[1], _octets[2], _octets[3]);
+    return String(buf);
+  }
+
+  bool fromString(const char *address)
+  {
+    unsigned a, b, c, d;
+    char tail;
+    if (sscanf(address, "%u.%u.%u.%u%c", &a, &b, &c, &d, &tail) != 4 || a > 255 || b > 255 || c > 255 || d > 255)
+    {
+      return false;
+    }
+    _octets[0] = a;
+    _octets[1] = b;
+    _octets[2] = c;
+    _octets[3] = d;
+    return true;
+  }
+
+  uint8_t operator[](int i) const { return _octets[i]; }
+
+private:
+  uint8_t _octets[4];
+};
@@ -0,0 +1,82 @@
+#include "LCDi2c.h"
+#include <stdio.h>
+#include <string.h>
+
+void LCDi2c::begin(uint8_t rows, uint8_t columns)
+{
+  _rows = rows < NATIVE_ROWS ? rows : NATIVE_ROWS;
+  _columns = columns < NATIVE_COLUMNS ? columns : NATIVE_COLUMNS;
+  for (int i = 0; i < 6; i++)
+  {
+    command(); // function set, display control, entry mode...
+  }
+  cls();
+}
+
+void LCDi2c::cls()
+{
+  command();
+  for (uint8_t r = 0; r < NATIVE_ROWS; r++)
+  {
+    memset(native_screen[r], ' ', NATIVE_COLUMNS);
+    native_screen[r][NATIVE_COLUMNS] = '\0';
+  }
+  _row = 0;
+  _column = 0;
+}
+
+void LCDi2c::clr(uint8_t row)
+{
+  // The library blanks the row by writing spaces over it
+  locate(row, 1);
+  for (uint8_t c = 0; c < _columns; c++)
+  {
+    write(' ');
+  }
+  locate(row, 1);
+}
+
+void LCDi2c::locate(uint8_t row, uint8_t column)
+{
+  command();
+  _row = row > 0 ? row - 1 : 0;
+  _column = column > 0 ? column - 1 : 0;
+}
+
+size_t LCDi2c::write(uint8_t c)
+{
+  _wire->native_count(_address, 4);
+  native_characters++;
+  if (_row < _rows && _column < _columns)
+  {
+    native_screen[_row][_column] = (char)c;
+  }
+  _column++;
+  return 1;
+}
+
+size_t LCDi2c::print(const char *s)
+{
+  size_t n = 0;
+  while (s && *s)
+  {
+    n += write((uint8_t)*s++);
+  }
+  return n;
+}
+
+size_t LCDi2c::printf(const char *format, ...)
+{
+  char buf[64];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  return print(buf);
+}
+
+void LCDi2c::command()
+{
+  _wire->native_count(_address, 4);
+  native_commands++;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdarg.h>
+#include "Wire.h"
+#include "WString.h"
+
+// HD44780 behind a PCF8574 backpack. Keeps the visible DDRAM contents and
+// counts bus traffic: in 4-bit mode every command or character costs four
+// expander writes.
+class LCDi2c
+{
+public:
+  LCDi2c(uint8_t address, TwoWire &i2c = Wire) : _address(address), _wire(&i2c) {}
+
+  void begin(uint8_t rows, uint8_t columns);
+  void cls();
+  void clr(uint8_t row);
+  void locate(uint8_t row, uint8_t column);
+  void home() { locate(1, 1); }
+  void display(bool on = true) { command(); }
+  void backlight(bool on = true) { command(); }
+
+  size_t write(uint8_t c);
+  size_t print(const char *s);
+  size_t print(const String &s) { return print(s.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t printf(const char *format, ...);
+
+  // Host side
+  static const uint8_t NATIVE_ROWS = 4;
+  static const uint8_t NATIVE_COLUMNS = 20;
+  char native_screen[NATIVE_ROWS][NATIVE_COLUMNS + 1];
+  uint32_t native_commands = 0;
+  uint32_t native_characters = 0;
+
+private:
+  void command();
+
+  uint8_t _address;
+  TwoWire *_wire;
+  uint8_t _rows = NATIVE_ROWS;
+  uint8_t _columns = NATIVE_COLUMNS;
+  uint8_t _row = 0;
+  uint8_t _column = 0;
+};
@@ -0,0 +1,143 @@
+#include "NativeHal.h"
+#include "Arduino.h"
+
+#include <vector>
+
+static uint64_t _native_micros = 0;
+static bool _restart_requested = false;
+
+struct NativeIsr
+{
+  uint8_t pin;
+  void (*isr)();
+  int mode;
+};
+
+static std::vector<NativeIsr> _isrs;
+
+struct NativeServiceEntry
+{
+  NativeService service;
+  void *ctx;
+};
+
+static std::vector<NativeServiceEntry> _services;
+
+EspClass ESP;
+
+uint32_t native_millis() { return (uint32_t)(_native_micros / 1000); }
+void native_set_millis(uint32_t ms) { _native_micros = (uint64_t)ms * 1000; }
+void native_advance_millis(uint32_t ms) { _native_micros += (uint64_t)ms * 1000; }
+
+unsigned long millis() { return (unsigned long)(_native_micros / 1000); }
+unsigned long micros() { return (unsigned long)_native_micros; }
+void delay(uint32_t ms) { vTaskDelay(ms / portTICK_PERIOD_MS); } // Blocks the task, as on ESP32
+void delayMicroseconds(uint32_t us) { _native_micros += us; }
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+
+static uint8_t _pin_levels[64];
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+  if (pin < sizeof(_pin_levels)) _pin_levels[pin] = val;
+}
+
+int digitalRead(uint8_t pin)
+{
+  return pin < sizeof(_pin_levels) ? _pin_levels[pin] : LOW;
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode)
+{
+  detachInterrupt(pin);
+  _isrs.push_back({pin, isr, mode});
+}
+
+void detachInterrupt(uint8_t pin)
+{
+  for (size_t i = 0; i < _isrs.size(); i++)
+  {
+    if (_isrs[i].pin == pin)
+    {
+      _isrs.erase(_isrs.begin() + i);
+      return;
+    }
+  }
+}
+
+void native_raise_interrupt(uint8_t pin)
+{
+  for (const NativeIsr &entry : _isrs)
+  {
+    if (entry.pin == pin) entry.isr();
+  }
+}
+
+void native_raise_falling_interrupts()
+{
+  for (const NativeIsr &entry : _isrs)
+  {
+    if (entry.mode == FALLING) entry.isr();
+  }
+}
+
+void native_register_service(NativeService service, void *ctx)
+{
+  _services.push_back({service, ctx});
+}
+
+void native_run_services()
+{
+  for (const NativeServiceEntry &entry : _services)
+  {
+    entry.service(entry.ctx);
+  }
+}
+
+bool native_restart_requested() { return _restart_requested; }
+
+void EspClass::restart()
+{
+  log_i("ESP.restart() requested");
+  _restart_requested = true;
+}
+
+static uint32_t _random_state = 0x12345678;
+
+void randomSeed(unsigned long seed) { _random_state = seed ? seed : 1; }
+
+long random(long howbig)
+{
+  if (howbig <= 0) return 0;
+  // xorshift32: deterministic across hosts, good enough for jitter
+  _random_state ^= _random_state << 13;
+  _random_state ^= _random_state >> 17;
+  _random_state ^= _random_state << 5;
+  return (long)(_random_state % (uint32_t)howbig);
+}
+
+long random(long howsmall, long howbig)
+{
+  if (howsmall >= howbig) return howsmall;
+  return howsmall + random(howbig - howsmall);
+}
+
+char *dtostrf(double val, signed char width, unsigned char prec, char *sout)
+{
+  sprintf(sout, "%*.*f", width, prec, val);
+  return sout;
+}
+
+void configTzTime(const char *tz, const char *server1, const char *server2, const char *server3)
+{
+  setenv("TZ", tz, 1);
+  tzset();
+}
+
+bool getLocalTime(struct tm *info, uint32_t ms)
+{
+  // No network time source on the host; NTP never "succeeds" unless a tool
+  // drives the RTC stand-in directly.
+  return false;
+}
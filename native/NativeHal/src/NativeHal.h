@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host-side controls for the stand-ins. Firmware code never includes this;
+// it is for native entry points and tools driving the firmware on Linux.
+
+// Virtual monotonic clock behind millis()/micros()/delay()/vTaskDelay().
+// Time only moves when something advances it, so runs are deterministic.
+uint32_t native_millis();
+void native_set_millis(uint32_t ms);
+void native_advance_millis(uint32_t ms);
+
+// Raise an interrupt on a pin (calls the handler from attachInterrupt()).
+void native_raise_interrupt(uint8_t pin);
+// Raise every attached FALLING interrupt, e.g. the open-drain DS3231 INT line.
+void native_raise_falling_interrupts();
+
+// Services registered by stand-ins that need to run between loop() calls
+// and while every task is blocked (RTC alarm line, MQTT inbox delivery, ...).
+typedef void (*NativeService)(void *ctx);
+void native_register_service(NativeService service, void *ctx);
+void native_run_services();
+
+// Set when firmware called ESP.restart(); the native runner exits on it.
+bool native_restart_requested();
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+#include "Wire.h"
+
+#define PCF8574_INITIAL_VALUE 0xFF
+
+#define PCF8574_OK 0x00
+#define PCF8574_PIN_ERROR 0x81
+#define PCF8574_I2C_ERROR 0x82
+
+// Quasi-bidirectional 8-bit expander: reads return the output latch ANDed
+// with whatever is pulling pins low (native_stuck_low), like the real part.
+class PCF8574
+{
+public:
+  explicit PCF8574(const uint8_t deviceAddress = 0x20, TwoWire *wire = &Wire)
+      : _address(deviceAddress), _wire(wire) {}
+
+  bool begin(uint8_t value = PCF8574_INITIAL_VALUE)
+  {
+    if (!isConnected()) return false;
+    write8(value);
+    return true;
+  }
+
+  bool isConnected()
+  {
+    _wire->native_count(_address, 1, connected());
+    return connected();
+  }
+
+  uint8_t getAddress() const { return _address; }
+
+  void write8(const uint8_t value)
+  {
+    _wire->native_count(_address, 2, connected());
+    if (!connected())
+    {
+      _error = PCF8574_I2C_ERROR;
+      return;
+    }
+    _dataOut = value;
+    native_writes++;
+    _error = PCF8574_OK;
+  }
+
+  uint8_t read8()
+  {
+    _wire->native_count(_address, 2, connected());
+    if (!connected())
+    {
+      _error = PCF8574_I2C_ERROR;
+      return _dataIn;
+    }
+    _dataIn = _dataOut & ~native_stuck_low;
+    _error = PCF8574_OK;
+    return _dataIn;
+  }
+
+  uint8_t valueOut() const { return _dataOut; }
+  uint8_t value() const { return _dataIn; }
+
+  int lastError()
+  {
+    int e = _error;
+    _error = PCF8574_OK;
+    return e;
+  }
+
+  // Host side
+  bool native_connected = true;
+  uint8_t native_stuck_low = 0;
+  uint32_t native_writes = 0;
+
+private:
+  bool connected() const { return native_connected && !_wire->native_unplugged(_address); }
+
+  uint8_t _address;
+  TwoWire *_wire;
+  uint8_t _dataOut = 0xFF;
+  uint8_t _dataIn = 0xFF;
+  int _error = PCF8574_OK;
+};
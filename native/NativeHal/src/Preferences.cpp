@@ -0,0 +1,111 @@
+#include "Preferences.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <string.h>
+
+typedef std::map<std::string, std::vector<uint8_t>> NativeNamespace;
+
+static std::map<std::string, NativeNamespace> &storage()
+{
+  static std::map<std::string, NativeNamespace> instance;
+  return instance;
+}
+
+static NativeNvsStats _stats = {};
+
+bool Preferences::begin(const char *name, bool readOnly, const char *partition_label)
+{
+  if (_started) return false;
+  _namespace = name;
+  _readOnly = readOnly;
+  _started = true;
+  _stats.opens++;
+  return true;
+}
+
+void Preferences::end()
+{
+  _started = false;
+}
+
+bool Preferences::clear()
+{
+  if (!_started || _readOnly) return false;
+  storage()[_namespace].clear();
+  _stats.writes++;
+  return true;
+}
+
+bool Preferences::remove(const char *key)
+{
+  if (!_started || _readOnly) return false;
+  _stats.writes++;
+  return storage()[_namespace].erase(key) > 0;
+}
+
+bool Preferences::isKey(const char *key)
+{
+  if (!_started) return false;
+  NativeNamespace &ns = storage()[_namespace];
+  return ns.find(key) != ns.end();
+}
+
+size_t Preferences::put(const char *key, const void *value, size_t len)
+{
+  if (!_started || _readOnly || key == nullptr) return 0;
+  const uint8_t *bytes = static_cast<const uint8_t *>(value);
+  storage()[_namespace][key].assign(bytes, bytes + len);
+  _stats.writes++;
+  _stats.bytesWritten += len;
+  return len;
+}
+
+bool Preferences::get(const char *key, void *value, size_t len)
+{
+  if (!_started) return false;
+  _stats.reads++;
+  NativeNamespace &ns = storage()[_namespace];
+  NativeNamespace::iterator it = ns.find(key);
+  if (it == ns.end() || it->second.size() != len) return false;
+  memcpy(value, it->second.data(), len);
+  return true;
+}
+
+size_t Preferences::putString(const char *key, const char *value)
+{
+  return put(key, value, strlen(value) + 1);
+}
+
+size_t Preferences::getBytesLength(const char *key)
+{
+  if (!_started) return 0;
+  NativeNamespace &ns = storage()[_namespace];
+  NativeNamespace::iterator it = ns.find(key);
+  return it == ns.end() ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char *key, void *buf, size_t maxLen)
+{
+  if (!_started) return 0;
+  _stats.reads++;
+  NativeNamespace &ns = storage()[_namespace];
+  NativeNamespace::iterator it = ns.find(key);
+  if (it == ns.end() || it->second.size() > maxLen) return 0;
+  memcpy(buf, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+String Preferences::getString(const char *key, const String defaultValue)
+{
+  size_t len = getBytesLength(key);
+  if (len == 0) return defaultValue;
+  std::vector<char> buf(len);
+  getBytes(key, buf.data(), len);
+  return String(buf.data());
+}
+
+const NativeNvsStats &Preferences::native_stats() { return _stats; }
+void Preferences::native_reset_stats() { _stats = {}; }
+void Preferences::native_erase_all() { storage().clear(); }
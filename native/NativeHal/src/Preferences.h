@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "WString.h"
+
+struct NativeNvsStats
+{
+  uint32_t opens;
+  uint32_t reads;
+  uint32_t writes;
+  uint32_t bytesWritten;
+};
+
+// NVS namespace stand-in. Contents live in a process-wide map so they
+// persist across begin()/end() and across Preferences instances, the way
+// flash does across reboots.
+class Preferences
+{
+public:
+  bool begin(const char *name, bool readOnly = false, const char *partition_label = nullptr);
+  void end();
+
+  bool clear();
+  bool remove(const char *key);
+  bool isKey(const char *key);
+
+  size_t putUChar(const char *key, uint8_t value) { return put(key, &value, sizeof(value)); }
+  size_t putUShort(const char *key, uint16_t value) { return put(key, &value, sizeof(value)); }
+  size_t putUInt(const char *key, uint32_t value) { return put(key, &value, sizeof(value)); }
+  size_t putULong(const char *key, uint32_t value) { return put(key, &value, sizeof(value)); }
+  size_t putBool(const char *key, bool value) { return putUChar(key, value ? 1 : 0); }
+  size_t putBytes(const char *key, const void *value, size_t len) { return put(key, value, len); }
+  size_t putString(const char *key, const char *value);
+
+  uint8_t getUChar(const char *key, uint8_t defaultValue = 0) { return getScalar(key, defaultValue); }
+  uint16_t getUShort(const char *key, uint16_t defaultValue = 0) { return getScalar(key, defaultValue); }
+  uint32_t getUInt(const char *key, uint32_t defaultValue = 0) { return getScalar(key, defaultValue); }
+  uint32_t getULong(const char *key, uint32_t defaultValue = 0) { return getScalar(key, defaultValue); }
+  bool getBool(const char *key, bool defaultValue = false) { return getUChar(key, defaultValue ? 1 : 0) != 0; }
+  size_t getBytesLength(const char *key);
+  size_t getBytes(const char *key, void *buf, size_t maxLen);
+  String getString(const char *key, const String defaultValue = String());
+
+  // Host side
+  static const NativeNvsStats &native_stats();
+  static void native_reset_stats();
+  static void native_erase_all();
+
+private:
+  size_t put(const char *key, const void *value, size_t len);
+  bool get(const char *key, void *value, size_t len);
+
+  template <typename T>
+  T getScalar(const char *key, T defaultValue)
+  {
+    T value;
+    return get(key, &value, sizeof(value)) ? value : defaultValue;
+  }
+
+  const char *_namespace = nullptr;
+  bool _readOnly = false;
+  bool _started = false;
+};
@@ -0,0 +1,107 @@
+#include "PubSubClient.h"
+#include <string.h>
+
+bool PubSubClient::native_broker_available = true;
+uint32_t PubSubClient::native_connect_calls = 0;
+
+PubSubClient &PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE)
+{
+  _callback = callback;
+  return *this;
+}
+
+bool PubSubClient::setBufferSize(uint16_t size)
+{
+  if (size == 0) return false;
+  _bufferSize = size;
+  return true;
+}
+
+bool PubSubClient::connect(const char *id, const char *user, const char *pass, const char *willTopic, uint8_t willQos, bool willRetain, const char *willMessage)
+{
+  native_connect_calls++;
+  _connected = native_broker_available;
+  _state = _connected ? MQTT_CONNECTED : MQTT_CONNECT_FAILED;
+  if (!_connected) _subscriptions.clear();
+  return _connected;
+}
+
+void PubSubClient::disconnect()
+{
+  _connected = false;
+  _state = MQTT_DISCONNECTED;
+  _subscriptions.clear();
+}
+
+bool PubSubClient::publish(const char *topic, const char *payload)
+{
+  return publishImpl(topic, (const uint8_t *)payload, payload ? strlen(payload) : 0, false);
+}
+
+bool PubSubClient::publish(const char *topic, const char *payload, bool retained)
+{
+  return publishImpl(topic, (const uint8_t *)payload, payload ? strlen(payload) : 0, retained);
+}
+
+bool PubSubClient::publish(const char *topic, const uint8_t *payload, unsigned int plength)
+{
+  return publishImpl(topic, payload, plength, false);
+}
+
+bool PubSubClient::publish(const char *topic, const uint8_t *payload, unsigned int plength, bool retained)
+{
+  return publishImpl(topic, payload, plength, retained);
+}
+
+bool PubSubClient::publishImpl(const char *topic, const uint8_t *payload, unsigned int plength, bool retained)
+{
+  if (!_connected) return false;
+  // Same limit as the real client: fixed header + topic + payload must fit
+  if (5 + 2 + strlen(topic) + plength > _bufferSize) return false;
+  if (native_on_publish) native_on_publish(topic);
+  native_published.push_back({topic, std::string((const char *)payload, plength), retained});
+  return true;
+}
+
+bool PubSubClient::subscribe(const char *topic, uint8_t qos)
+{
+  if (!_connected) return false;
+  _subscriptions.push_back(topic);
+  return true;
+}
+
+bool PubSubClient::loop()
+{
+  if (!_connected) return false;
+
+  std::vector<NativeMqttMessage> inbox;
+  inbox.swap(_inbox);
+  for (const NativeMqttMessage &msg : inbox)
+  {
+    bool subscribed = false;
+    for (const std::string &s : _subscriptions)
+    {
+      subscribed |= s == msg.topic;
+    }
+    if (!subscribed || !_callback) continue;
+
+    // Topic and payload share the client buffer, payload is not terminated
+    _buffer.assign(msg.topic.begin(), msg.topic.end());
+    _buffer.push_back('\0');
+    _buffer.insert(_buffer.end(), msg.payload.begin(), msg.payload.end());
+    _callback((char *)_buffer.data(), _buffer.data() + msg.topic.size() + 1, (unsigned int)msg.payload.size());
+  }
+  return _connected;
+}
+
+void PubSubClient::native_inject(const char *topic, const char *payload)
+{
+  _inbox.push_back({topic, payload, false});
+}
+
+void PubSubClient::native_drop_connection()
+{
+  _connected = false;
+  _state = MQTT_CONNECTION_LOST;
+  _subscriptions.clear();
+}
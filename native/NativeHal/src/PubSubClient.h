@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+#include "Client.h"
+
+#define MQTT_MAX_PACKET_SIZE 256
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char *, uint8_t *, unsigned int)> callback
+
+struct NativeMqttMessage
+{
+  std::string topic;
+  std::string payload;
+  bool retained;
+};
+
+// Broker stand-in. Outbound publishes are recorded in native_published;
+// native_inject() queues an inbound message that loop() delivers through
+// the callback, from a buffer the client owns (as PubSubClient does).
+class PubSubClient
+{
+public:
+  PubSubClient() {}
+  PubSubClient(Client &client) : _client(&client) {}
+
+  PubSubClient &setServer(const char *domain, uint16_t port) { return *this; }
+  PubSubClient &setCallback(MQTT_CALLBACK_SIGNATURE);
+  PubSubClient &setKeepAlive(uint16_t keepAlive) { return *this; }
+  PubSubClient &setSocketTimeout(uint16_t timeout) { return *this; }
+  bool setBufferSize(uint16_t size);
+  uint16_t getBufferSize() { return _bufferSize; }
+
+  bool connect(const char *id, const char *user, const char *pass, const char *willTopic, uint8_t willQos, bool willRetain, const char *willMessage);
+  void disconnect();
+
+  bool publish(const char *topic, const char *payload);
+  bool publish(const char *topic, const char *payload, bool retained);
+  bool publish(const char *topic, const uint8_t *payload, unsigned int plength);
+  bool publish(const char *topic, const uint8_t *payload, unsigned int plength, bool retained);
+
+  bool subscribe(const char *topic, uint8_t qos = 0);
+  bool loop();
+  bool connected() { return _connected; }
+  int state() { return _state; }
+
+  // Host side
+  static bool native_broker_available;
+  static uint32_t native_connect_calls;
+  std::vector<NativeMqttMessage> native_published;
+  std::function<void(const char *)> native_on_publish; // Runs inside publish(), as another task could
+  void native_inject(const char *topic, const char *payload);
+  void native_drop_connection();
+
+private:
+  bool publishImpl(const char *topic, const uint8_t *payload, unsigned int plength, bool retained);
+
+  Client *_client = nullptr;
+  std::function<void(char *, uint8_t *, unsigned int)> _callback;
+  bool _connected = false;
+  int _state = MQTT_DISCONNECTED;
+  uint16_t _bufferSize = MQTT_MAX_PACKET_SIZE;
+  std::vector<std::string> _subscriptions;
+  std::vector<NativeMqttMessage> _inbox;
+  std::vector<uint8_t> _buffer;
+};
@@ -0,0 +1,217 @@
+#include "RTClib.h"
+#include "NativeHal.h"
+
+// Howard Hinnant's civil calendar conversions
+static int32_t days_from_civil(int32_t y, uint32_t m, uint32_t d)
+{
+  y -= m <= 2;
+  const int32_t era = (y >= 0 ? y : y - 399) / 400;
+  const uint32_t yoe = (uint32_t)(y - era * 400);
+  const uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int32_t)doe - 719468;
+}
+
+DateTime::DateTime(uint32_t t)
+{
+  int32_t z = (int32_t)(t / 86400) + 719468;
+  uint32_t secs = t % 86400;
+  const int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+  const uint32_t doe = (uint32_t)(z - era * 146097);
+  const uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const uint32_t mp = (5 * doy + 2) / 153;
+  const uint32_t day = doy - (153 * mp + 2) / 5 + 1;
+  const uint32_t month = mp < 10 ? mp + 3 : mp - 9;
+  const int32_t year = (int32_t)yoe + era * 400 + (month <= 2);
+
+  yOff = (uint8_t)(year - 2000);
+  m = (uint8_t)month;
+  d = (uint8_t)day;
+  hh = secs / 3600;
+  mm = secs / 60 % 60;
+  ss = secs % 60;
+}
+
+DateTime::DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t min, uint8_t sec)
+{
+  if (year >= 2000U) year -= 2000U;
+  yOff = (uint8_t)year;
+  m = month;
+  d = day;
+  hh = hour;
+  mm = min;
+  ss = sec;
+}
+
+bool DateTime::isValid() const
+{
+  if (m < 1 || m > 12 || d < 1 || hh > 23 || mm > 59 || ss > 59) return false;
+  DateTime other(unixtime());
+  return other.yOff == yOff && other.m == m && other.d == d;
+}
+
+uint32_t DateTime::unixtime() const
+{
+  int32_t days = days_from_civil(2000 + yOff, m, d);
+  return (uint32_t)days * 86400UL + hh * 3600UL + mm * 60UL + ss;
+}
+
+uint8_t DateTime::dayOfTheWeek() const
+{
+  int32_t days = days_from_civil(2000 + yOff, m, d);
+  return (uint8_t)((days + 4) % 7); // 1970-01-01 was a Thursday
+}
+
+bool RTC_DS3231::begin(TwoWire *wireInstance)
+{
+  _wire = wireInstance;
+  _wire->native_count(DS3231_ADDRESS, 1, native_present);
+  if (!native_present) return false;
+
+  if (!_registered)
+  {
+    _registered = true;
+    _wire->native_attach(DS3231_ADDRESS, this);
+    native_register_service(serviceThunk, this);
+    _baseMs = native_millis();
+    _lastChecked = _baseUnix;
+  }
+  return true;
+}
+
+uint32_t RTC_DS3231::currentUnix()
+{
+  uint32_t nowMs = native_millis();
+  double ppm = native_drift_ppm - _aging * 0.1;
+  double elapsed = (nowMs - _baseMs) / 1000.0 * (1.0 + ppm / 1e6) + _fraction;
+
+  // Re-base so that the error does not accumulate in floating point
+  uint32_t whole = (uint32_t)elapsed;
+  _baseUnix += whole;
+  _baseMs = nowMs;
+  _fraction = elapsed - whole;
+  return _baseUnix;
+}
+
+void RTC_DS3231::adjust(const DateTime &dt)
+{
+  _wire->native_count(DS3231_ADDRESS, 8);
+  _baseUnix = dt.unixtime();
+  _baseMs = native_millis();
+  _fraction = 0;
+  _lastChecked = _baseUnix;
+}
+
+DateTime RTC_DS3231::now()
+{
+  _wire->native_count(DS3231_ADDRESS, 1);
+  _wire->native_count(DS3231_ADDRESS, 8);
+  return DateTime(currentUnix());
+}
+
+float RTC_DS3231::getTemperature()
+{
+  _wire->native_count(DS3231_ADDRESS, 1);
+  _wire->native_count(DS3231_ADDRESS, 3);
+  return native_temperature;
+}
+
+bool RTC_DS3231::setAlarm1(const DateTime &dt, Ds3231Alarm1Mode alarm_mode)
+{
+  _wire->native_count(DS3231_ADDRESS, 6);
+  _alarm1Enabled = true;
+  _alarm1Mode = alarm_mode;
+  _alarm1Second = dt.second();
+  _alarm1Minute = dt.minute();
+  _lastChecked = currentUnix();
+  return true;
+}
+
+void RTC_DS3231::disableAlarm(uint8_t alarm_num)
+{
+  _wire->native_count(DS3231_ADDRESS, 3);
+  if (alarm_num == 1) _alarm1Enabled = false;
+}
+
+void RTC_DS3231::clearAlarm(uint8_t alarm_num)
+{
+  _wire->native_count(DS3231_ADDRESS, 3);
+  if (alarm_num == 1) _alarm1Flag = false;
+}
+
+bool RTC_DS3231::alarmFired(uint8_t alarm_num)
+{
+  _wire->native_count(DS3231_ADDRESS, 3);
+  service();
+  return alarm_num == 1 && _alarm1Flag;
+}
+
+void RTC_DS3231::service()
+{
+  uint32_t now = currentUnix();
+  if (!_alarm1Enabled || now == _lastChecked)
+  {
+    _lastChecked = now;
+    return;
+  }
+
+  bool matched = false;
+  if (now < _lastChecked || now - _lastChecked > 3600)
+  {
+    // Time was stepped; the chip only compares the current registers
+    DateTime t(now);
+    matched = t.second() == _alarm1Second;
+  }
+  else
+  {
+    for (uint32_t t = _lastChecked + 1; t <= now && !matched; t++)
+    {
+      DateTime dt(t);
+      switch (_alarm1Mode)
+      {
+      case DS3231_A1_PerSecond:
+        matched = true;
+        break;
+      case DS3231_A1_Second:
+        matched = dt.second() == _alarm1Second;
+        break;
+      case DS3231_A1_Minute:
+        matched = dt.second() == _alarm1Second && dt.minute() == _alarm1Minute;
+        break;
+      default:
+        break;
+      }
+    }
+  }
+  _lastChecked = now;
+
+  if (matched && !_alarm1Flag)
+  {
+    _alarm1Flag = true;
+    native_raise_falling_interrupts();
+  }
+}
+
+void RTC_DS3231::onWrite(const uint8_t *data, size_t len)
+{
+  if (len == 0) return;
+  _register = data[0];
+  for (size_t i = 1; i < len; i++, _register++)
+  {
+    if (_register == 0x10)
+    {
+      currentUnix(); // settle elapsed time at the old rate first
+      _aging = (int8_t)data[i];
+    }
+  }
+}
+
+size_t RTC_DS3231::onRead(uint8_t *data, size_t len)
+{
+  for (size_t i = 0; i < len; i++, _register++)
+  {
+    data[i] = _register == 0x10 ? (uint8_t)_aging : 0;
+  }
+  return len;
+}
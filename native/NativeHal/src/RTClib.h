@@ -0,0 +1,146 @@
+#pragma once
+
+#include <stdint.h>
+#include "Wire.h"
+
+#define SECONDS_FROM_1970_TO_2000 946684800
+
+class TimeSpan
+{
+public:
+  TimeSpan(int32_t seconds = 0) : _seconds(seconds) {}
+  TimeSpan(int16_t days, int8_t hours, int8_t minutes, int8_t seconds)
+      : _seconds((int32_t)days * 86400L + (int32_t)hours * 3600 + (int32_t)minutes * 60 + seconds) {}
+
+  int16_t days() const { return _seconds / 86400L; }
+  int8_t hours() const { return _seconds / 3600 % 24; }
+  int8_t minutes() const { return _seconds / 60 % 60; }
+  int8_t seconds() const { return _seconds % 60; }
+  int32_t totalseconds() const { return _seconds; }
+
+  TimeSpan operator+(const TimeSpan &right) const { return TimeSpan(_seconds + right._seconds); }
+  TimeSpan operator-(const TimeSpan &right) const { return TimeSpan(_seconds - right._seconds); }
+
+private:
+  int32_t _seconds;
+};
+
+class DateTime
+{
+public:
+  DateTime(uint32_t t = SECONDS_FROM_1970_TO_2000);
+  DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour = 0, uint8_t min = 0, uint8_t sec = 0);
+
+  bool isValid() const;
+
+  uint16_t year() const { return 2000U + yOff; }
+  uint8_t month() const { return m; }
+  uint8_t day() const { return d; }
+  uint8_t hour() const { return hh; }
+  uint8_t minute() const { return mm; }
+  uint8_t second() const { return ss; }
+  uint8_t dayOfTheWeek() const; // 0 = Sunday
+
+  uint32_t secondstime() const { return unixtime() - SECONDS_FROM_1970_TO_2000; }
+  uint32_t unixtime() const;
+
+  DateTime operator+(const TimeSpan &span) const { return DateTime(unixtime() + span.totalseconds()); }
+  DateTime operator-(const TimeSpan &span) const { return DateTime(unixtime() - span.totalseconds()); }
+  TimeSpan operator-(const DateTime &right) const { return TimeSpan((int32_t)(unixtime() - right.unixtime())); }
+
+  bool operator<(const DateTime &right) const { return unixtime() < right.unixtime(); }
+  bool operator>(const DateTime &right) const { return right < *this; }
+  bool operator<=(const DateTime &right) const { return !(*this > right); }
+  bool operator>=(const DateTime &right) const { return !(*this < right); }
+  bool operator==(const DateTime &right) const { return unixtime() == right.unixtime(); }
+  bool operator!=(const DateTime &right) const { return !(*this == right); }
+
+protected:
+  uint8_t yOff, m, d, hh, mm, ss;
+};
+
+enum Ds3231SqwPinMode
+{
+  DS3231_OFF = 0x1C,
+  DS3231_SquareWave1Hz = 0x00,
+  DS3231_SquareWave1kHz = 0x08,
+  DS3231_SquareWave4kHz = 0x10,
+  DS3231_SquareWave8kHz = 0x18
+};
+
+enum Ds3231Alarm1Mode
+{
+  DS3231_A1_PerSecond = 0x0F,
+  DS3231_A1_Second = 0x0E,
+  DS3231_A1_Minute = 0x0C,
+  DS3231_A1_Hour = 0x08,
+  DS3231_A1_Date = 0x00,
+  DS3231_A1_Day = 0x10
+};
+
+enum Ds3231Alarm2Mode
+{
+  DS3231_A2_PerMinute = 0x7,
+  DS3231_A2_Minute = 0x6,
+  DS3231_A2_Hour = 0x4,
+  DS3231_A2_Date = 0x0,
+  DS3231_A2_Day = 0x8
+};
+
+#define DS3231_ADDRESS 0x68
+
+// DS3231 backed by the virtual millis() clock. The chip runs fast or slow by
+// native_drift_ppm minus its aging offset (~0.1 ppm per LSB, register 0x10),
+// and alarm 1 pulls the INT line (every attached FALLING handler) when it
+// matches.
+class RTC_DS3231 : public NativeI2cDevice
+{
+public:
+  bool begin(TwoWire *wireInstance = &Wire);
+  void adjust(const DateTime &dt);
+  bool lostPower() { return false; }
+  DateTime now();
+
+  bool setAlarm1(const DateTime &dt, Ds3231Alarm1Mode alarm_mode);
+  bool setAlarm2(const DateTime &dt, Ds3231Alarm2Mode alarm_mode) { return true; }
+  void disableAlarm(uint8_t alarm_num);
+  void clearAlarm(uint8_t alarm_num);
+  bool alarmFired(uint8_t alarm_num);
+
+  void writeSqwPinMode(Ds3231SqwPinMode mode) {}
+  void enable32K() {}
+  void disable32K() {}
+
+  float getTemperature();
+
+  // Host side
+  float native_temperature = 21.25f;
+  float native_drift_ppm = 0.0f;
+  bool native_present = true;
+  int8_t native_aging_offset() const { return _aging; }
+
+  void onWrite(const uint8_t *data, size_t len) override;
+  size_t onRead(uint8_t *data, size_t len) override;
+
+private:
+  uint32_t currentUnix();
+  void service();
+  static void serviceThunk(void *ctx) { static_cast<RTC_DS3231 *>(ctx)->service(); }
+
+  TwoWire *_wire = &Wire;
+  bool _registered = false;
+
+  uint32_t _baseUnix = SECONDS_FROM_1970_TO_2000;
+  uint32_t _baseMs = 0;
+  double _fraction = 0;
+
+  bool _alarm1Enabled = false;
+  Ds3231Alarm1Mode _alarm1Mode = DS3231_A1_Second;
+  uint8_t _alarm1Second = 0;
+  uint8_t _alarm1Minute = 0;
+  bool _alarm1Flag = false;
+  uint32_t _lastChecked = 0;
+
+  int8_t _aging = 0;
+  uint8_t _register = 0;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+// std::string backed replacement for the Arduino String class.
+class String
+{
+public:
+  String() {}
+  String(const char *s) : _s(s ? s : "") {}
+  String(const std::string &s) : _s(s) {}
+  explicit String(char c) : _s(1, c) {}
+  explicit String(int v) : _s(std::to_string(v)) {}
+  explicit String(unsigned int v) : _s(std::to_string(v)) {}
+  explicit String(long v) : _s(std::to_string(v)) {}
+  explicit String(unsigned long v) : _s(std::to_string(v)) {}
+
+  const char *c_str() const { return _s.c_str(); }
+  unsigned int length() const { return (unsigned int)_s.length(); }
+  bool isEmpty() const { return _s.empty(); }
+  char operator[](unsigned int i) const { return _s[i]; }
+
+  bool concat(const char *s) { _s += s; return true; }
+  bool concat(const char *s, unsigned int n) { _s.append(s, n); return true; }
+  bool concat(char c) { _s += c; return true; }
+  bool concat(const String &s) { _s += s._s; return true; }
+
+  String &operator+=(const char *s) { _s += s; return *this; }
+  String &operator+=(char c) { _s += c; return *this; }
+  String &operator+=(const String &s) { _s += s._s; return *this; }
+
+  friend String operator+(const String &a, const String &b) { return String(a._s + b._s); }
+  friend String operator+(const String &a, const char *b) { return String(a._s + b); }
+
+  bool operator==(const String &o) const { return _s == o._s; }
+  bool operator==(const char *o) const { return _s == o; }
+  bool operator!=(const String &o) const { return _s != o._s; }
+
+private:
+  std::string _s;
+};
@@ -0,0 +1,69 @@
+#include "WiFi.h"
+#include "PubSubClient.h"
+
+WiFiClass WiFi;
+
+bool WiFiClass::disconnect(bool wifioff, bool eraseap)
+{
+  if (_status == WL_CONNECTED)
+  {
+    _status = WL_DISCONNECTED;
+    emit(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, 8); // ASSOC_LEAVE
+  }
+  return true;
+}
+
+wl_status_t WiFiClass::begin(const char *ssid, const char *passphrase)
+{
+  native_begin_calls++;
+  _ssid = ssid ? ssid : "";
+  if (!native_ap_available)
+  {
+    _status = WL_NO_SSID_AVAIL;
+    emit(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, 201); // NO_AP_FOUND
+    return WL_DISCONNECTED;
+  }
+
+  _status = WL_CONNECTED;
+  emit(ARDUINO_EVENT_WIFI_STA_CONNECTED);
+  emit(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+  return WL_DISCONNECTED; // begin() returns before association on the real stack
+}
+
+int WiFiClass::hostByName(const char *host, IPAddress &result)
+{
+  if (_status != WL_CONNECTED)
+  {
+    return 0;
+  }
+  result = IPAddress(192, 168, 1, 2);
+  return 1;
+}
+
+void WiFiClass::onEvent(WiFiEventFuncCb cb, arduino_event_id_t event)
+{
+  _handlers.push_back({cb, event});
+}
+
+void WiFiClass::native_drop_connection(uint8_t reason)
+{
+  if (_status != WL_CONNECTED) return;
+  _status = WL_CONNECTION_LOST;
+  emit(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, reason);
+}
+
+void WiFiClass::emit(arduino_event_id_t event, uint8_t reason)
+{
+  WiFiEventInfo_t info = {};
+  info.wifi_sta_disconnected.reason = reason;
+  for (const Handler &h : _handlers)
+  {
+    if (h.event == event) h.cb(event, info);
+  }
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port, int32_t timeoutMs)
+{
+  _connected = WiFi.status() == WL_CONNECTED && PubSubClient::native_broker_available;
+  return _connected;
+}
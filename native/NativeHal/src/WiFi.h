@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "WString.h"
+#include "IPAddress.h"
+#include "Arduino.h"
+#include "Client.h"
+
+typedef enum
+{
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum
+{
+  WIFI_OFF = 0,
+  WIFI_STA = 1,
+  WIFI_AP = 2,
+  WIFI_AP_STA = 3
+} wifi_mode_t;
+
+typedef enum
+{
+  WIFI_PS_NONE,
+  WIFI_PS_MIN_MODEM,
+  WIFI_PS_MAX_MODEM
+} wifi_ps_type_t;
+
+typedef enum
+{
+  ARDUINO_EVENT_WIFI_STA_CONNECTED = 4,
+  ARDUINO_EVENT_WIFI_STA_DISCONNECTED = 5,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP = 7,
+  ARDUINO_EVENT_WIFI_STA_LOST_IP = 8
+} arduino_event_id_t;
+
+typedef arduino_event_id_t WiFiEvent_t;
+
+typedef struct
+{
+  struct
+  {
+    uint8_t reason;
+  } wifi_sta_disconnected;
+} WiFiEventInfo_t;
+
+typedef void (*WiFiEventFuncCb)(WiFiEvent_t event, WiFiEventInfo_t info);
+
+// Socket stand-in: connects whenever the broker stand-in is up
+class WiFiClient : public Client
+{
+public:
+  int connect(IPAddress ip, uint16_t port, int32_t timeoutMs);
+  void stop() override { _connected = false; }
+  uint8_t connected() override { return _connected; }
+
+private:
+  bool _connected = false;
+};
+
+// Station stand-in. native_ap_available decides whether begin() associates;
+// events are delivered synchronously like the ESP-IDF event loop would do
+// shortly after.
+class WiFiClass
+{
+public:
+  bool setHostname(const char *hostname) { return true; }
+  bool mode(wifi_mode_t m) { return true; }
+  bool setSleep(bool enabled) { return true; }
+  bool disconnect(bool wifioff = false, bool eraseap = false);
+  wl_status_t begin(const char *ssid, const char *passphrase = nullptr);
+  wl_status_t status() { return _status; }
+
+  void onEvent(WiFiEventFuncCb cb, arduino_event_id_t event);
+
+  IPAddress localIP() { return _status == WL_CONNECTED ? IPAddress(192, 168, 1, 50) : IPAddress(); }
+  String SSID() { return String(_ssid.c_str()); }
+  String BSSIDstr() { return String("00:11:22:33:44:55"); }
+  int8_t RSSI() { return _status == WL_CONNECTED ? -60 : 0; }
+  int32_t channel() { return 6; }
+  String macAddress() { return String("F6:E5:D4:C3:B2:A1"); }
+  int hostByName(const char *host, IPAddress &result);
+
+  // Host side
+  bool native_ap_available = true;
+  uint32_t native_begin_calls = 0;
+  void native_drop_connection(uint8_t reason = 200);
+
+private:
+  void emit(arduino_event_id_t event, uint8_t reason = 0);
+
+  struct Handler
+  {
+    WiFiEventFuncCb cb;
+    arduino_event_id_t event;
+  };
+  std::vector<Handler> _handlers;
+  wl_status_t _status = WL_DISCONNECTED;
+  std::string _ssid;
+};
+
+extern WiFiClass WiFi;
@@ -0,0 +1,102 @@
+#include "Wire.h"
+#include "Arduino.h"
+
+TwoWire Wire;
+
+bool TwoWire::begin(int sda, int scl, uint32_t frequency)
+{
+  if (frequency != 0)
+  {
+    _frequency = frequency;
+  }
+  return true;
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+  _address = address;
+  _txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+  if (_txLength >= sizeof(_txBuffer)) return 0;
+  _txBuffer[_txLength++] = data;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t len)
+{
+  size_t written = 0;
+  while (written < len && write(data[written]))
+  {
+    written++;
+  }
+  return written;
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop)
+{
+  NativeI2cDevice *device = find(_address);
+  native_count(_address, _txLength + 1, device != nullptr);
+  if (device == nullptr)
+  {
+    return 2; // NACK on address
+  }
+  device->onWrite(_txBuffer, _txLength);
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t len, bool sendStop)
+{
+  NativeI2cDevice *device = find(address);
+  _rxIndex = 0;
+  _rxLength = 0;
+  if (device != nullptr)
+  {
+    if (len > sizeof(_rxBuffer)) len = sizeof(_rxBuffer);
+    _rxLength = device->onRead(_rxBuffer, len);
+  }
+  native_count(address, _rxLength + 1, device != nullptr);
+  return (uint8_t)_rxLength;
+}
+
+int TwoWire::available()
+{
+  return (int)(_rxLength - _rxIndex);
+}
+
+int TwoWire::read()
+{
+  return _rxIndex < _rxLength ? _rxBuffer[_rxIndex++] : -1;
+}
+
+void TwoWire::native_attach(uint8_t address, NativeI2cDevice *device)
+{
+  _devices[address & 0x7F] = device;
+}
+
+void TwoWire::native_unplug(uint8_t address, bool unplugged)
+{
+  _unplugged[address & 0x7F] = unplugged;
+}
+
+void TwoWire::native_count(uint8_t address, size_t bytes, bool ok)
+{
+  uint32_t us = (uint32_t)(bytes * 9 * 1000000ULL / _frequency);
+  _stats.transactions++;
+  _stats.bytes += bytes;
+  _stats.busy_us += us;
+  if (!ok) _stats.errors++;
+  delayMicroseconds(us);
+}
+
+void TwoWire::native_reset_stats()
+{
+  _stats = {};
+}
+
+NativeI2cDevice *TwoWire::find(uint8_t address)
+{
+  return _unplugged[address & 0x7F] ? nullptr : _devices[address & 0x7F];
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Device model behind an address on the stand-in bus. Stand-ins that talk
+// through the library API directly (PCF8574, LCDi2c, RTC_DS3231) only use
+// the traffic counters; raw register access goes through these handlers.
+// Every byte advances the virtual clock by its time on the wire (9 bits at
+// the bus clock), so budgets measured with micros() behave as on hardware.
+class NativeI2cDevice
+{
+public:
+  virtual ~NativeI2cDevice() {}
+  virtual void onWrite(const uint8_t *data, size_t len) = 0;
+  virtual size_t onRead(uint8_t *data, size_t len) = 0;
+};
+
+struct NativeI2cStats
+{
+  uint32_t transactions;
+  uint32_t bytes;
+  uint32_t errors;
+  uint32_t busy_us;
+};
+
+class TwoWire
+{
+public:
+  bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0);
+  void setClock(uint32_t frequency) { _frequency = frequency; }
+
+  void beginTransmission(uint8_t address);
+  size_t write(uint8_t data);
+  size_t write(const uint8_t *data, size_t len);
+  uint8_t endTransmission(bool sendStop = true);
+
+  uint8_t requestFrom(uint8_t address, uint8_t len, bool sendStop = true);
+  int available();
+  int read();
+
+  // Host side
+  void native_attach(uint8_t address, NativeI2cDevice *device);
+  void native_count(uint8_t address, size_t bytes, bool ok = true);
+  void native_unplug(uint8_t address, bool unplugged = true); // Every access to it NACKs
+  bool native_unplugged(uint8_t address) const { return _unplugged[address & 0x7F]; }
+  const NativeI2cStats &native_stats() const { return _stats; }
+  void native_reset_stats();
+
+private:
+  NativeI2cDevice *find(uint8_t address);
+
+  NativeI2cDevice *_devices[128] = {};
+  bool _unplugged[128] = {};
+  NativeI2cStats _stats = {};
+  uint32_t _frequency = 100000;
+
+  uint8_t _address = 0;
+  uint8_t _txBuffer[64];
+  size_t _txLength = 0;
+  uint8_t _rxBuffer[64];
+  size_t _rxLength = 0;
+  size_t _rxIndex = 0;
+};
+
+extern TwoWire Wire;
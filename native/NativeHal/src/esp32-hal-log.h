@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdio.h>
+
+#define ARDUHAL_LOG_LEVEL_NONE 0
+#define ARDUHAL_LOG_LEVEL_ERROR 1
+#define ARDUHAL_LOG_LEVEL_WARN 2
+#define ARDUHAL_LOG_LEVEL_INFO 3
+#define ARDUHAL_LOG_LEVEL_DEBUG 4
+#define ARDUHAL_LOG_LEVEL_VERBOSE 5
+
+#ifndef CORE_DEBUG_LEVEL
+#define CORE_DEBUG_LEVEL ARDUHAL_LOG_LEVEL_INFO
+#endif
+
+#define NATIVE_LOG(letter, format, ...) fprintf(stderr, "[%c] " format "\n", letter, ##__VA_ARGS__)
+
+#if CORE_DEBUG_LEVEL >= ARDUHAL_LOG_LEVEL_ERROR
+#define log_e(format, ...) NATIVE_LOG('E', format, ##__VA_ARGS__)
+#else
+#define log_e(format, ...) do {} while (0)
+#endif
+
+#if CORE_DEBUG_LEVEL >= ARDUHAL_LOG_LEVEL_WARN
+#define log_w(format, ...) NATIVE_LOG('W', format, ##__VA_ARGS__)
+#else
+#define log_w(format, ...) do {} while (0)
+#endif
+
+#if CORE_DEBUG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
+#define log_i(format, ...) NATIVE_LOG('I', format, ##__VA_ARGS__)
+#else
+#define log_i(format, ...) do {} while (0)
+#endif
+
+#if CORE_DEBUG_LEVEL >= ARDUHAL_LOG_LEVEL_DEBUG
+#define log_d(format, ...) NATIVE_LOG('D', format, ##__VA_ARGS__)
+#else
+#define log_d(format, ...) do {} while (0)
+#endif
+
+#if CORE_DEBUG_LEVEL >= ARDUHAL_LOG_LEVEL_VERBOSE
+#define log_v(format, ...) NATIVE_LOG('V', format, ##__VA_ARGS__)
+#else
+#define log_v(format, ...) do {} while (0)
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdio.h>
+#include "WString.h"
+
+// OTA is never offered on the host.
+class esp32FOTA
+{
+public:
+  esp32FOTA(const char *firmwareType, const char *firmwareVersion, bool validate = false, bool allow_insecure_https = false) {}
+
+  void setManifestURL(const char *url) {}
+  void printConfig() {}
+  bool execHTTPcheck() { return false; }
+  void execOTA() {}
+  void handle() {}
+};
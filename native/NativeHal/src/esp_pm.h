@@ -0,0 +1,30 @@
+#pragma once
+
+#include "esp_err.h"
+
+// Power management is accepted and ignored: the host has no clock tree or
+// sleep states. Virtual time passes the same whether the firmware sleeps.
+typedef enum
+{
+  ESP_PM_CPU_FREQ_MAX,
+  ESP_PM_APB_FREQ_MAX,
+  ESP_PM_NO_LIGHT_SLEEP
+} esp_pm_lock_type_t;
+
+typedef void *esp_pm_lock_handle_t;
+
+typedef struct
+{
+  int max_freq_mhz;
+  int min_freq_mhz;
+  bool light_sleep_enable;
+} esp_pm_config_esp32c3_t;
+
+inline esp_err_t esp_pm_configure(const void *config) { return ESP_OK; }
+inline esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg, const char *name, esp_pm_lock_handle_t *handle)
+{
+  *handle = (void *)1;
+  return ESP_OK;
+}
+inline esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle) { return ESP_OK; }
+inline esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle) { return ESP_OK; }
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/time.h>
+
+// No SNTP client on the host: the notification never fires, so firmware
+// waiting for a time sync keeps running on the RTC alone.
+typedef void (*sntp_sync_time_cb_t)(struct timeval *tv);
+
+inline void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback) {}
+inline void sntp_set_sync_interval(uint32_t interval_ms) {}
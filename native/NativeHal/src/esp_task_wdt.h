@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/task.h"
+
+inline esp_err_t esp_task_wdt_init(uint32_t timeout, bool panic) { return ESP_OK; }
+inline esp_err_t esp_task_wdt_add(TaskHandle_t handle) { return ESP_OK; }
+inline esp_err_t esp_task_wdt_delete(TaskHandle_t handle) { return ESP_OK; }
+inline esp_err_t esp_task_wdt_reset() { return ESP_OK; }
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+// Queues copy items in and out, as FreeRTOS does. Blocking calls yield to
+// the scheduler in freertos/task.h.
+struct NativeQueue;
+typedef NativeQueue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item); // Length 1 queues
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+// Tasks are host threads under a cooperative scheduler: only one runs at a
+// time, the highest priority one that is not blocked. The thread calling
+// setup() and loop() is "loopTask" at priority 1. A task gives up the CPU
+// by blocking or by waking one of higher priority, as on a single core.
+// While every task is blocked the virtual clock advances in short slices
+// and the host services run between them, so an RTC alarm raised
+// meanwhile wakes its task as the interrupt would.
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stackDepth, void *params,
+                       UBaseType_t priority, TaskHandle_t *created);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task); // Host threads have no fixed stack: the size given
+
+TaskHandle_t xTaskGetCurrentTaskHandle();
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken);
+#define portYIELD_FROM_ISR(woken) ((void)(woken))
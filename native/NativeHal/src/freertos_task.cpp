@@ -0,0 +1,470 @@
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "NativeHal.h"
+
+#include <string.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Every task is a thread, but only the one in _running executes firmware
+// code; the others wait on their own condition variable. The kernel lock
+// only guards the scheduler state, and is recursive because services run
+// while it is held may raise interrupts that notify tasks.
+
+struct NativeTask
+{
+  NativeTask(const char *name, UBaseType_t priority, uint32_t stack) : name(name), priority(priority), stack(stack) {}
+
+  const char *name;
+  UBaseType_t priority;
+  uint32_t stack;
+  bool blocked = false;
+  bool dead = false;
+  bool forever = false;    // Blocked without a timeout
+  uint32_t deadline = 0;   // native_millis() when a timed wait ends
+  const void *waiting_on = nullptr;
+  uint32_t notifications = 0;
+  std::condition_variable_any cv;
+};
+
+struct NativeQueue
+{
+  UBaseType_t length;
+  UBaseType_t size;
+  std::deque<std::vector<uint8_t>> items;
+};
+
+struct NativeSemaphore
+{
+  bool recursive;
+  NativeTask *holder;
+  UBaseType_t depth;
+};
+
+struct Timeout
+{
+  bool forever;
+  uint32_t deadline;
+};
+
+typedef std::unique_lock<std::recursive_mutex> KernelGuard;
+
+static const TickType_t IDLE_SLICE = 10;
+
+static std::vector<NativeTask *> _tasks;
+static NativeTask *_running = nullptr;
+static bool _idling = false; // Advancing the clock: wakes from services don't switch
+static thread_local NativeTask *_self = nullptr;
+
+static std::recursive_mutex &kernel()
+{
+  // Never destroyed: task threads are still waiting on it when main() returns
+  static std::recursive_mutex *lock = new std::recursive_mutex;
+  return *lock;
+}
+
+static NativeTask *self()
+{
+  if (_self == nullptr)
+  {
+    // The thread running setup() and loop()
+    _self = new NativeTask("loopTask", 1, 8192);
+    _tasks.push_back(_self);
+    if (_running == nullptr)
+    {
+      _running = _self;
+    }
+  }
+  return _self;
+}
+
+static bool before(uint32_t a, uint32_t b)
+{
+  return (int32_t)(a - b) < 0;
+}
+
+static Timeout timeout(TickType_t ticks)
+{
+  return {ticks == portMAX_DELAY, native_millis() + ticks * portTICK_PERIOD_MS};
+}
+
+// Highest priority task that can run; among equals the first after `from`,
+// so tasks of one priority take turns
+static NativeTask *pick(NativeTask *from)
+{
+  size_t count = _tasks.size();
+  size_t start = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    if (_tasks[i] == from)
+    {
+      start = i + 1;
+    }
+  }
+
+  NativeTask *best = nullptr;
+  for (size_t i = 0; i < count; i++)
+  {
+    NativeTask *task = _tasks[(start + i) % count];
+    if (!task->dead && !task->blocked && (best == nullptr || task->priority > best->priority))
+    {
+      best = task;
+    }
+  }
+  return best;
+}
+
+// Makes the tasks whose timed wait is over ready again. Returns whether
+// another one is still waiting, and the earliest end of those waits.
+static bool expire(uint32_t now, uint32_t &earliest)
+{
+  bool timed = false;
+  for (NativeTask *task : _tasks)
+  {
+    if (task->dead || !task->blocked || task->forever)
+    {
+      continue;
+    }
+    if (!before(now, task->deadline))
+    {
+      task->blocked = false;
+    }
+    else if (!timed || before(task->deadline, earliest))
+    {
+      earliest = task->deadline;
+      timed = true;
+    }
+  }
+  return timed;
+}
+
+// The task to run next; while none can run, advances the clock to the next
+// timeout in slices with the services between them
+static NativeTask *next(NativeTask *from)
+{
+  for (;;)
+  {
+    uint32_t now = native_millis();
+    uint32_t earliest = 0;
+    bool timed = expire(now, earliest);
+
+    NativeTask *task = pick(from);
+    if (task != nullptr)
+    {
+      return task;
+    }
+
+    uint32_t slice = IDLE_SLICE * portTICK_PERIOD_MS;
+    _idling = true;
+    native_advance_millis(timed && earliest - now < slice ? earliest - now : slice);
+    native_run_services();
+    _idling = false;
+  }
+}
+
+// Hands the CPU to `task`; returns once `me` has it again
+static void switchTo(KernelGuard &guard, NativeTask *me, NativeTask *task)
+{
+  if (task == me)
+  {
+    return;
+  }
+
+  _running = task;
+  task->cv.notify_one();
+  me->cv.wait(guard, [me] { return _running == me; });
+}
+
+// Blocks `me` on `object` until woken or the timeout; false once it is over.
+// Callers check their condition again after each return.
+static bool block(KernelGuard &guard, NativeTask *me, const void *object, const Timeout &timeout)
+{
+  if (!timeout.forever && !before(native_millis(), timeout.deadline))
+  {
+    return false;
+  }
+
+  me->blocked = true;
+  me->forever = timeout.forever;
+  me->deadline = timeout.deadline;
+  me->waiting_on = object;
+  switchTo(guard, me, next(me));
+  me->waiting_on = nullptr;
+  return true;
+}
+
+static void wake(const void *object)
+{
+  for (NativeTask *task : _tasks)
+  {
+    if (task->blocked && task->waiting_on == object)
+    {
+      task->blocked = false;
+    }
+  }
+}
+
+// A woken task of higher priority takes the CPU right away
+static void preempt(KernelGuard &guard, NativeTask *me)
+{
+  if (_idling)
+  {
+    return;
+  }
+
+  uint32_t earliest;
+  expire(native_millis(), earliest);
+  NativeTask *task = pick(me);
+  if (task != nullptr && task->priority > me->priority)
+  {
+    switchTo(guard, me, task);
+  }
+}
+
+static void taskMain(NativeTask *task, TaskFunction_t code, void *params)
+{
+  _self = task;
+  {
+    KernelGuard guard(kernel());
+    task->cv.wait(guard, [task] { return _running == task; });
+  }
+
+  code(params);
+  vTaskDelete(nullptr); // Returning is not allowed in FreeRTOS; end it as if it had
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stackDepth, void *params,
+                       UBaseType_t priority, TaskHandle_t *created)
+{
+  KernelGuard guard(kernel());
+  NativeTask *me = self();
+  NativeTask *task = new NativeTask(name, priority, stackDepth);
+  _tasks.push_back(task);
+  std::thread(taskMain, task, code, params).detach();
+
+  if (created != nullptr)
+  {
+    *created = task;
+  }
+  preempt(guard, me);
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t handle)
+{
+  KernelGuard guard(kernel());
+  NativeTask *me = self();
+  NativeTask *task = handle != nullptr ? (NativeTask *)handle : me;
+  task->dead = true;
+  if (task != me)
+  {
+    return; // Its thread stays parked
+  }
+
+  NativeTask *other = next(me);
+  _running = other;
+  other->cv.notify_one();
+  for (;;)
+  {
+    me->cv.wait(guard);
+  }
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+  KernelGuard guard(kernel());
+  NativeTask *me = self();
+  if (ticks == 0)
+  {
+    // A yield: tasks of the same priority get their turn
+    NativeTask *task = pick(me);
+    if (task != nullptr && task->priority >= me->priority)
+    {
+      switchTo(guard, me, task);
+    }
+    return;
+  }
+
+  Timeout until = timeout(ticks);
+  while (block(guard, me, nullptr, until))
+  {
+  }
+}
+
+TickType_t xTaskGetTickCount()
+{
+  return native_millis() / portTICK_PERIOD_MS;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t handle)
+{
+  KernelGuard guard(kernel());
+  return handle != nullptr ? ((NativeTask *)handle)->stack : self()->stack;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+  KernelGuard guard(kernel());
+  return self();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks)
+{
+  KernelGuard guard(kernel());
+  NativeTask *me = self();
+  Timeout until = timeout(ticks);
+  while (me->notifications == 0 && block(guard, me, me, until))
+  {
+  }
+
+  uint32_t count = me->notifications;
+  if (count > 0)
+  {
+    me->notifications = clearOnExit ? 0 : count - 1;
+  }
+  return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t handle)
+{
+  KernelGuard guard(kernel());
+  NativeTask *me = self();
+  NativeTask *task = (NativeTask *)handle;
+  task->notifications++;
+  wake(task);
+  preempt(guard, me);
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t handle, BaseType_t *higherPriorityTaskWoken)
+{
+  KernelGuard guard(kernel());
+  NativeTask *task = (NativeTask *)handle;
+  task->notifications++;
+  wake(task);
+  if (higherPriorityTaskWoken) *higherPriorityTaskWoken = pdTRUE;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+  return new NativeQueue{length, itemSize, {}};
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+  KernelGuard guard(kernel());
+  NativeTask *me = self();
+  Timeout until = timeout(ticks);
+  while (queue->items.size() >= queue->length)
+  {
+    if (!block(guard, me, &queue->items, until)) // Senders wait for space
+    {
+      return errQUEUE_FULL;
+    }
+  }
+
+  const uint8_t *bytes = (const uint8_t *)item;
+  queue->items.emplace_back(bytes, bytes + queue->size);
+  wake(queue);
+  preempt(guard, me);
+  return pdPASS;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item)
+{
+  KernelGuard guard(kernel());
+  NativeTask *me = self();
+  const uint8_t *bytes = (const uint8_t *)item;
+  queue->items.clear();
+  queue->items.emplace_back(bytes, bytes + queue->size);
+  wake(queue);
+  preempt(guard, me);
+  return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks)
+{
+  KernelGuard guard(kernel());
+  NativeTask *me = self();
+  Timeout until = timeout(ticks);
+  while (queue->items.empty())
+  {
+    if (!block(guard, me, queue, until))
+    {
+      return pdFALSE;
+    }
+  }
+
+  memcpy(buffer, queue->items.front().data(), queue->size);
+  queue->items.pop_front();
+  wake(&queue->items);
+  preempt(guard, me);
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+  KernelGuard guard(kernel());
+  return (UBaseType_t)queue->items.size();
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+  return new NativeSemaphore{false, nullptr, 0};
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex()
+{
+  return new NativeSemaphore{true, nullptr, 0};
+}
+
+static BaseType_t take(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+  KernelGuard guard(kernel());
+  NativeTask *me = self();
+  if (semaphore->recursive && semaphore->holder == me)
+  {
+    semaphore->depth++;
+    return pdTRUE;
+  }
+
+  Timeout until = timeout(ticks);
+  while (semaphore->holder != nullptr)
+  {
+    if (!block(guard, me, semaphore, until))
+    {
+      return pdFALSE;
+    }
+  }
+
+  semaphore->holder = me;
+  semaphore->depth = 1;
+  return pdTRUE;
+}
+
+static BaseType_t give(SemaphoreHandle_t semaphore)
+{
+  KernelGuard guard(kernel());
+  NativeTask *me = self();
+  if (semaphore->holder != me)
+  {
+    return pdFALSE;
+  }
+
+  if (--semaphore->depth == 0)
+  {
+    semaphore->holder = nullptr;
+    wake(semaphore);
+    preempt(guard, me);
+  }
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) { return take(semaphore, ticks); }
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) { return give(semaphore); }
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t ticks) { return take(semaphore, ticks); }
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore) { return give(semaphore); }
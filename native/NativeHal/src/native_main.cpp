@@ -0,0 +1,28 @@
+#if !defined(NATIVE_HAL_NO_MAIN) && !defined(PIO_UNIT_TESTING) // Unity brings its own main()
+
+#include <stdlib.h>
+#include "Arduino.h"
+#include "NativeHal.h"
+
+// Arduino-style runner: setup() once, then loop() until the firmware asks
+// for a restart or the NATIVE_RUN_MS budget of virtual time is used up.
+int main(int argc, char **argv)
+{
+  const char *runMs = getenv("NATIVE_RUN_MS");
+  uint32_t limit = runMs ? (uint32_t)strtoul(runMs, nullptr, 10) : 0;
+
+  setup();
+  while (!native_restart_requested())
+  {
+    native_run_services();
+    loop();
+
+    if (limit > 0 && native_millis() >= limit)
+    {
+      break;
+    }
+  }
+  return 0;
+}
+
+#endif
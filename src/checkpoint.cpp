@@ -0,0 +1,49 @@
+#include "checkpoint.h"
+#include "utils.h"
+#include <esp32-hal-log.h>
+
+RTC_NOINIT_ATTR static run_checkpoint_t _checkpoint;
+
+void checkpoint_save(TaskManager &taskManager, uint32_t now)
+{
+  run_checkpoint_t cp;
+  memset(&cp, 0, sizeof(cp));
+  cp.magic = CHECKPOINT_MAGIC;
+  cp.time = now;
+  cp.step = taskManager.currentStep();
+  cp.left = cp.step >= 0 ? taskManager.timeLeft() : 0;
+  cp.crc = crc32(&cp, offsetof(run_checkpoint_t, crc));
+  _checkpoint = cp;
+}
+
+bool checkpoint_restore(TaskManager &taskManager, uint32_t now)
+{
+  run_checkpoint_t cp = _checkpoint;
+  _checkpoint.magic = 0; // Consumed; the resumed cycle saves fresh ones
+
+  if (cp.magic != CHECKPOINT_MAGIC || cp.crc != crc32(&cp, offsetof(run_checkpoint_t, crc)))
+  {
+    return false; // Power-on: RTC memory holds garbage
+  }
+
+  if (now < cp.time || now - cp.time > CHECKPOINT_MAX_AGE)
+  {
+    if (cp.step >= 0)
+    {
+      log_w("Interrupted cycle at step %d is too old to resume", cp.step);
+    }
+    return false;
+  }
+
+  // Starts that fell into the restart are caught up, none is repeated
+  taskManager.scheduler().resumeFrom(cp.time);
+
+  if (cp.step < 0 || cp.step >= taskManager.valveSettingCount())
+  {
+    return false;
+  }
+
+  log_i("Resuming interrupted cycle at step %d with %d s left", cp.step, cp.left);
+  taskManager.start(cp.step, cp.left);
+  return true;
+}
@@ -0,0 +1,124 @@
+#include "clock_service.h"
+#include "i2c_bus.h"
+#include <Wire.h>
+#include <esp32-hal-log.h>
+
+static const uint8_t DS3231_AGING = 0x10; // Aging offset register
+
+static RTC_DS3231* _rtc = nullptr;
+static uint32_t _synced = 0;    // unixtime() of the last good read
+static uint32_t _synced_ms = 0; // millis() at that read
+static bool _valid = false;
+
+static float _temperature = 0;
+static uint32_t _temperature_ms = 0;
+static bool _temperature_valid = false;
+
+void clock_init(RTC_DS3231& rtc)
+{
+  _rtc = &rtc;
+}
+
+bool clock_sync()
+{
+  if (_rtc == nullptr)
+  {
+    return false;
+  }
+
+  uint32_t started = bus_begin();
+  DateTime now = _rtc->now();
+  bool ok = now.isValid();
+  bus_end(BUS_RTC, started, ok);
+
+  if (!ok)
+  {
+    log_e("RTC returned an invalid time");
+    return false;
+  }
+
+  // The alarm fires on the second; reading it within the same loop pass
+  // keeps the interpolated seconds within a pass of the RTC
+  _synced = now.unixtime();
+  _synced_ms = millis();
+  _valid = true;
+  return true;
+}
+
+bool clock_valid()
+{
+  return _valid;
+}
+
+DateTime clock_now()
+{
+  return DateTime(_synced + (millis() - _synced_ms) / 1000);
+}
+
+float clock_temperature()
+{
+  return _temperature;
+}
+
+static bool readTemperature()
+{
+  _temperature = _rtc->getTemperature();
+  _temperature_ms = millis();
+  _temperature_valid = true;
+  return true;
+}
+
+void clock_loop()
+{
+  if (_rtc == nullptr || bus_pending(BUS_RTC))
+  {
+    return;
+  }
+
+  if (!_temperature_valid || millis() - _temperature_ms >= CLOCK_TEMP_REFRESH_MS)
+  {
+    bus_post(BUS_RTC, readTemperature);
+  }
+}
+
+bool clock_adjust(const DateTime& dt)
+{
+  if (_rtc == nullptr)
+  {
+    return false;
+  }
+
+  uint32_t started = bus_begin();
+  _rtc->adjust(dt);
+  bus_end(BUS_RTC, started);
+  return clock_sync();
+}
+
+bool clock_read_aging(int8_t& aging)
+{
+  uint32_t started = bus_begin();
+  Wire.beginTransmission(DS3231_ADDRESS);
+  Wire.write(DS3231_AGING);
+  bool ok = Wire.endTransmission() == 0 && Wire.requestFrom((uint8_t)DS3231_ADDRESS, (uint8_t)1) == 1;
+  if (ok)
+  {
+    aging = (int8_t)Wire.read();
+  }
+  bus_end(BUS_RTC, started, ok);
+  return ok;
+}
+
+bool clock_write_aging(int8_t aging)
+{
+  uint32_t started = bus_begin();
+  Wire.beginTransmission(DS3231_ADDRESS);
+  Wire.write(DS3231_AGING);
+  Wire.write((uint8_t)aging);
+  bool ok = Wire.endTransmission() == 0;
+  bus_end(BUS_RTC, started, ok);
+  if (!ok)
+  {
+    log_e("Failed to write RTC aging offset");
+  }
+  return ok;
+}
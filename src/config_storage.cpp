@@ -1,134 +1,519 @@
-#include "config_storage.h"
-#include "utils.h"
-#include <esp32-hal-log.h>
-
-const char* ConfigStorage::NAMESPACE = "irrigation";
-
-ConfigStorage::ConfigStorage() {}
-
-bool ConfigStorage::begin()
-{
-  return preferences.begin(NAMESPACE, false);  // Read-write mode
-}
-
-void ConfigStorage::end()
-{
-  preferences.end();
-}
-
-bool ConfigStorage::saveSchedule(uint8_t hour, uint8_t minute)
-{
-  if (!begin()) return false;
-
-  preferences.putUChar("sched_hour", hour);
-  preferences.putUChar("sched_min", minute);
-
-  end();
-  log_i("Saved schedule: %02d:%02d", hour, minute);
-  return true;
-}
-
-bool ConfigStorage::loadSchedule(uint8_t& hour, uint8_t& minute)
-{
-  if (!begin()) return false;
-
-  hour = preferences.getUChar("sched_hour", 20);    // Default 20:00
-  minute = preferences.getUChar("sched_min", 0);
-
-  end();
-  log_i("Loaded schedule: %02d:%02d", hour, minute);
-  return true;
-}
-
-bool ConfigStorage::saveTask(uint8_t idx, uint16_t valves, uint8_t duration)
-{
-  if (idx >= MAX_TASKS) return false;
-  if (!begin()) return false;
-
-  char keyValves[16], keyDuration[16];
-  snprintf(keyValves, sizeof(keyValves), "task%d_valves", idx);
-  snprintf(keyDuration, sizeof(keyDuration), "task%d_dur", idx);
-
-  preferences.putUShort(keyValves, valves);
-  preferences.putUChar(keyDuration, duration);
-
-  end();
-  log_i("Saved task %d: valves=%d, duration=%d", idx, valves, duration);
-  return true;
-}
-
-bool ConfigStorage::loadTask(uint8_t idx, uint16_t& valves, uint8_t& duration)
-{
-  if (idx >= MAX_TASKS) return false;
-  if (!begin()) return false;
-
-  char keyValves[16], keyDuration[16];
-  snprintf(keyValves, sizeof(keyValves), "task%d_valves", idx);
-  snprintf(keyDuration, sizeof(keyDuration), "task%d_dur", idx);
-
-  valves = preferences.getUShort(keyValves, 0);
-  duration = preferences.getUChar(keyDuration, 0);
-
-  end();
-
-  if (valves == 0 && duration == 0) return false;  // No task stored
-
-  log_i("Loaded task %d: valves=%d, duration=%d", idx, valves, duration);
-  return true;
-}
-
-uint8_t ConfigStorage::getTaskCount()
-{
-  uint8_t count = 0;
-  uint16_t valves;
-  uint8_t duration;
-
-  for (uint8_t i = 0; i < MAX_TASKS; i++)
-  {
-    if (loadTask(i, valves, duration))
-    {
-      count++;
-    }
-    else
-    {
-      break;  // Stop at first empty task
-    }
-  }
-
-  return count;
-}
-
-void ConfigStorage::loadToTaskManager(TaskManager& tm)
-{
-  uint8_t hour, minute;
-  if (loadSchedule(hour, minute))
-  {
-    tm.setStartTime(hour, minute);
-  }
-
-  for (uint8_t i = 0; i < MAX_TASKS; i++)
-  {
-    uint16_t valves;
-    uint8_t duration;
-
-    if (loadTask(i, valves, duration))
-    {
-      tm.setValveSetting(i, valves, duration);
-      log_i("Applied task %d to TaskManager: %s, %d min", i, toValveString(valves).c_str(), duration);
-    }
-    else
-    {
-      break;  // No more tasks
-    }
-  }
-}
-
-void ConfigStorage::reset()
-{
-  if (!begin()) return;
-
-  preferences.clear();
-  end();
-
-  log_i("Configuration reset to defaults");
-}
+#include "config_storage.h"
+#include "utils.h"
+#include "valves.h"
+#include "deferred.h"
+#include <esp32-hal-log.h>
+
+const char* ConfigStorage::NAMESPACE = "irrigation";
+const char* ConfigStorage::BLOB_KEY = "config";
+
+static ConfigStorage* _pending = nullptr; // Instance with unsaved edits
+
+// Version 1 layout, from firmware limited to 12 zones on 16-bit masks
+typedef struct
+{
+  uint16_t valves;
+  uint16_t duration;
+} valve_setting_v1_t;
+
+typedef struct
+{
+  uint8_t sched_hour;
+  uint8_t sched_minute;
+  uint8_t program_mask;
+  uint8_t task_count;
+  program_t programs[MAX_PROGRAMS];
+  valve_setting_v1_t tasks[24];
+  uint8_t zone_count;
+  uint16_t capacity;
+  zone_demand_t zones[12];
+} config_v1_t;
+
+typedef struct
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t length;
+  config_v1_t config;
+  uint32_t crc;
+} config_blob_v1_t;
+
+// Whatever is stored, read once at boot, and the blob being written
+static union
+{
+  uint8_t bytes[CONFIG_BLOB_MAX];
+  config_header_t header;
+  config_blob_v1_t v1;
+} _stored;
+
+static uint8_t* put(uint8_t* at, const void* value, size_t length)
+{
+  memcpy(at, value, length);
+  return at + length;
+}
+
+static const uint8_t* get(const uint8_t* at, void* value, size_t length)
+{
+  memcpy(value, at, length);
+  return at + length;
+}
+
+// Writes the blob for config into _stored, returns its length
+static size_t pack(const config_t& config)
+{
+  uint8_t* at = _stored.bytes + sizeof(config_header_t);
+  at = put(at, &config.sched_hour, 1);
+  at = put(at, &config.sched_minute, 1);
+  at = put(at, &config.program_mask, 1);
+  at = put(at, config.programs, sizeof(config.programs));
+  at = put(at, &config.task_count, 1);
+  for (uint8_t i = 0; i < config.task_count; i++)
+  {
+    at = put(at, &config.tasks[i].valves, sizeof(valve_mask_t));
+    at = put(at, &config.tasks[i].duration, sizeof(uint16_t));
+  }
+  at = put(at, &config.zone_count, 1);
+  at = put(at, &config.capacity, sizeof(uint16_t));
+  at = put(at, config.zones, config.zone_count * sizeof(zone_demand_t));
+
+  size_t length = at - _stored.bytes + sizeof(uint32_t);
+  _stored.header.magic = CONFIG_MAGIC;
+  _stored.header.version = CONFIG_VERSION;
+  _stored.header.length = length - sizeof(config_header_t);
+  uint32_t crc = crc32(_stored.bytes, at - _stored.bytes);
+  put(at, &crc, sizeof(crc));
+  return length;
+}
+
+// Reads a current blob of length bytes from _stored into config
+static bool unpack(size_t length, config_t& config)
+{
+  if (length < sizeof(config_header_t) + 3 + sizeof(config.programs) + 1 + 3 + sizeof(uint32_t))
+  {
+    return false;
+  }
+
+  const uint8_t* end = _stored.bytes + length - sizeof(uint32_t);
+  const uint8_t* at = _stored.bytes + sizeof(config_header_t);
+  uint32_t crc;
+  get(end, &crc, sizeof(crc));
+  if (crc != crc32(_stored.bytes, end - _stored.bytes))
+  {
+    log_e("Config blob CRC mismatch");
+    return false;
+  }
+
+  // Counts are checked against the length before the tables are read
+  at = get(at, &config.sched_hour, 1);
+  at = get(at, &config.sched_minute, 1);
+  at = get(at, &config.program_mask, 1);
+  at = get(at, config.programs, sizeof(config.programs));
+  at = get(at, &config.task_count, 1);
+  if (config.task_count > MAX_TASKS || (size_t)(end - at) < config.task_count * CONFIG_STEP_BYTES + 3)
+  {
+    return false;
+  }
+  for (uint8_t i = 0; i < config.task_count; i++)
+  {
+    at = get(at, &config.tasks[i].valves, sizeof(valve_mask_t));
+    at = get(at, &config.tasks[i].duration, sizeof(uint16_t));
+  }
+  at = get(at, &config.zone_count, 1);
+  at = get(at, &config.capacity, sizeof(uint16_t));
+  if (config.zone_count > MAX_ZONES || (size_t)(end - at) != config.zone_count * sizeof(zone_demand_t))
+  {
+    return false;
+  }
+  get(at, config.zones, config.zone_count * sizeof(zone_demand_t));
+  return true;
+}
+
+static void defaultConfig(config_t& config)
+{
+  memset(&config, 0, sizeof(config));
+  config.sched_hour = 20; // Default 20:00
+  config.sched_minute = 0;
+}
+
+ConfigStorage::ConfigStorage()
+{
+  defaultConfig(_config);
+}
+
+bool ConfigStorage::begin()
+{
+  return preferences.begin(NAMESPACE, false);  // Read-write mode
+}
+
+void ConfigStorage::end()
+{
+  preferences.end();
+}
+
+bool ConfigStorage::load()
+{
+  if (!begin()) return false;
+
+  const config_header_t& header = _stored.header;
+  size_t len = preferences.getBytesLength(BLOB_KEY);
+  bool found = len >= sizeof(config_header_t) + 4 && len <= sizeof(_stored) &&
+               preferences.getBytes(BLOB_KEY, &_stored, len) == len;
+
+  end();
+
+  if (found)
+  {
+    if (header.magic == CONFIG_MAGIC && header.version == 1 && len == sizeof(config_blob_v1_t))
+    {
+      if (upgrade())
+      {
+        return true;
+      }
+    }
+    else if (header.magic != CONFIG_MAGIC || header.version != CONFIG_VERSION || header.length != len - sizeof(config_header_t))
+    {
+      log_e("Config blob version %d (length %d) not supported", header.version, header.length);
+    }
+    else if (!unpack(len, _config))
+    {
+      log_e("Config blob is damaged");
+    }
+    else
+    {
+      log_i("Loaded config: %d tasks, %d zones", _config.task_count, _config.zone_count);
+      return true;
+    }
+  }
+  else if (len != 0)
+  {
+    log_e("Config blob has unexpected size %u", (unsigned)len);
+  }
+
+  defaultConfig(_config);
+  return migrateLegacy();
+}
+
+// Widens a version 1 blob in _stored to the current layout and rewrites it
+bool ConfigStorage::upgrade()
+{
+  const config_blob_v1_t& blob = _stored.v1;
+  if (blob.length != sizeof(config_v1_t) || blob.crc != crc32(&blob, offsetof(config_blob_v1_t, crc)))
+  {
+    log_e("Config blob version 1 is damaged");
+    return false;
+  }
+
+  const config_v1_t& old = blob.config;
+  defaultConfig(_config);
+  _config.sched_hour = old.sched_hour;
+  _config.sched_minute = old.sched_minute;
+  _config.program_mask = old.program_mask;
+  memcpy(_config.programs, old.programs, sizeof(old.programs));
+  _config.task_count = min<uint8_t>(old.task_count, 24);
+  for (uint8_t i = 0; i < _config.task_count; i++)
+  {
+    _config.tasks[i].valves = old.tasks[i].valves;
+    _config.tasks[i].duration = old.tasks[i].duration;
+  }
+  _config.zone_count = min<uint8_t>(old.zone_count, 12);
+  _config.capacity = old.capacity;
+  memcpy(_config.zones, old.zones, sizeof(old.zones));
+
+  log_i("Upgrading config blob from version 1: %d tasks, %d zones", _config.task_count, _config.zone_count);
+  commit(); // If this fails the next save writes the new layout
+  return true;
+}
+
+bool ConfigStorage::markDirty()
+{
+  unsigned long now = millis();
+  if (!_dirty)
+  {
+    _dirty = true;
+    _dirty_since = now;
+  }
+  _pending = this;
+
+  // Each edit pushes the write back, up to the maximum age of the oldest
+  unsigned long age = now - _dirty_since;
+  uint32_t delay_ms = age >= CONFIG_FLUSH_MAX_MS ? 0 : min((unsigned long)CONFIG_FLUSH_QUIET_MS, CONFIG_FLUSH_MAX_MS - age);
+  return defer_post(DEFER_CONFIG_FLUSH, delay_ms, flushPending);
+}
+
+bool ConfigStorage::flush()
+{
+  if (!_dirty)
+  {
+    return true;
+  }
+
+  log_i("Writing configuration");
+  if (!commit())
+  {
+    return false; // Stays dirty, the next edit or flush retries
+  }
+  _dirty = false;
+  defer_cancel(DEFER_CONFIG_FLUSH);
+  return true;
+}
+
+bool ConfigStorage::isDirty()
+{
+  return _dirty;
+}
+
+void ConfigStorage::flushPending()
+{
+  if (_pending != nullptr && _pending->flush())
+  {
+    _pending = nullptr;
+  }
+}
+
+bool ConfigStorage::commit()
+{
+  size_t length = pack(_config);
+
+  if (!begin()) return false;
+  size_t written = preferences.putBytes(BLOB_KEY, _stored.bytes, length);
+  end();
+
+  if (written != length)
+  {
+    log_e("Config blob write failed");
+    return false;
+  }
+  return true;
+}
+
+// Older firmware kept every setting under its own key. Read them all in
+// one session, store them as a blob and drop the old keys.
+bool ConfigStorage::migrateLegacy()
+{
+  if (!begin()) return false;
+
+  bool any = preferences.isKey("sched_hour");
+  _config.sched_hour = preferences.getUChar("sched_hour", 20);
+  _config.sched_minute = preferences.getUChar("sched_min", 0);
+
+  char key[16];
+  for (uint8_t i = 0; i < MAX_PROGRAMS; i++)
+  {
+    snprintf(key, sizeof(key), "prog%d", i);
+    if (preferences.getBytesLength(key) == sizeof(program_t) &&
+        preferences.getBytes(key, &_config.programs[i], sizeof(program_t)) == sizeof(program_t))
+    {
+      _config.program_mask |= 1 << i;
+      any = true;
+    }
+  }
+
+  for (uint8_t i = 0; i < MAX_TASKS; i++)
+  {
+    char keyDuration[16], keyLegacy[16];
+    snprintf(key, sizeof(key), "task%d_valves", i);
+    snprintf(keyDuration, sizeof(keyDuration), "task%d_sec", i);
+    snprintf(keyLegacy, sizeof(keyLegacy), "task%d_dur", i);
+
+    uint16_t valves = preferences.getUShort(key, 0);
+    uint16_t duration = preferences.isKey(keyDuration) ? preferences.getUShort(keyDuration, 0)
+                                                       : preferences.getUChar(keyLegacy, 0) * 60; // Minutes in the oldest layout
+    if (valves == 0 && duration == 0) break;  // Stop at first empty task
+
+    _config.tasks[i].valves = valves;
+    _config.tasks[i].duration = duration;
+    _config.task_count = i + 1;
+    any = true;
+  }
+
+  size_t len = preferences.getBytesLength("zones");
+  if (len > 0 && len <= sizeof(_config.zones) && len % sizeof(zone_demand_t) == 0 &&
+      preferences.getBytes("zones", _config.zones, len) == len)
+  {
+    _config.zone_count = len / sizeof(zone_demand_t);
+    any = true;
+  }
+  _config.capacity = preferences.getUShort("capacity", 0);
+
+  end();
+
+  if (!any)
+  {
+    log_i("No stored configuration");
+    return false;
+  }
+
+  log_i("Migrating %d tasks from per-key storage", _config.task_count);
+  if (commit())
+  {
+    removeLegacy();
+  }
+  return true;
+}
+
+void ConfigStorage::removeLegacy()
+{
+  if (!begin()) return;
+
+  char key[16];
+  preferences.remove("sched_hour");
+  preferences.remove("sched_min");
+  preferences.remove("zones");
+  preferences.remove("capacity");
+  for (uint8_t i = 0; i < MAX_PROGRAMS; i++)
+  {
+    snprintf(key, sizeof(key), "prog%d", i);
+    preferences.remove(key);
+  }
+  for (uint8_t i = 0; i < MAX_TASKS; i++)
+  {
+    snprintf(key, sizeof(key), "task%d_valves", i);
+    preferences.remove(key);
+    snprintf(key, sizeof(key), "task%d_sec", i);
+    preferences.remove(key);
+    snprintf(key, sizeof(key), "task%d_dur", i);
+    preferences.remove(key);
+  }
+
+  end();
+}
+
+bool ConfigStorage::saveSchedule(uint8_t hour, uint8_t minute)
+{
+  _config.sched_hour = hour;
+  _config.sched_minute = minute;
+
+  log_i("Saved schedule: %02d:%02d", hour, minute);
+  return markDirty();
+}
+
+bool ConfigStorage::loadSchedule(uint8_t& hour, uint8_t& minute)
+{
+  hour = _config.sched_hour;
+  minute = _config.sched_minute;
+  return true;
+}
+
+bool ConfigStorage::saveProgram(uint8_t idx, const program_t& program)
+{
+  if (idx >= MAX_PROGRAMS) return false;
+
+  _config.programs[idx] = program;
+  _config.program_mask |= 1 << idx;
+
+  log_i("Saved program %d: %d starts, enabled=%d", idx, program.start_count, program.enabled);
+  return markDirty();
+}
+
+bool ConfigStorage::loadProgram(uint8_t idx, program_t& program)
+{
+  if (idx >= MAX_PROGRAMS || !(_config.program_mask & (1 << idx))) return false;
+
+  program = _config.programs[idx];
+  return true;
+}
+
+bool ConfigStorage::saveTask(uint8_t idx, valve_mask_t valves, uint16_t duration)
+{
+  // Steps are contiguous: overwrite an existing one or append the next
+  if (idx >= MAX_TASKS || idx > _config.task_count) return false;
+
+  _config.tasks[idx].valves = valves;
+  _config.tasks[idx].duration = duration;
+  if (idx == _config.task_count)
+  {
+    _config.task_count++;
+  }
+
+  log_i("Saved task %d: valves=%llx, duration=%d", idx, (unsigned long long)valves, duration);
+  return markDirty();
+}
+
+bool ConfigStorage::loadTask(uint8_t idx, valve_mask_t& valves, uint16_t& duration)
+{
+  if (idx >= _config.task_count) return false;
+
+  valves = _config.tasks[idx].valves;
+  duration = _config.tasks[idx].duration;
+  return true;
+}
+
+uint8_t ConfigStorage::getTaskCount()
+{
+  return _config.task_count;
+}
+
+bool ConfigStorage::saveTasks(TaskManager& tm)
+{
+  return saveTasks(tm.valveSetting(0), tm.valveSettingCount());
+}
+
+bool ConfigStorage::saveTasks(const valve_setting_t* steps, uint8_t count)
+{
+  if (count > MAX_TASKS) return false;
+
+  if (count > 0)
+  {
+    memcpy(_config.tasks, steps, count * sizeof(valve_setting_t));
+  }
+  _config.task_count = count;
+
+  log_i("Saved %d tasks", count);
+  return markDirty();
+}
+
+bool ConfigStorage::saveZones(const zone_demand_t* zones, uint8_t count, uint16_t capacity)
+{
+  if (count > MAX_ZONES) return false;
+
+  memcpy(_config.zones, zones, count * sizeof(zone_demand_t));
+  _config.zone_count = count;
+  _config.capacity = capacity;
+
+  log_i("Saved %d zone demands, capacity %d", count, capacity);
+  return markDirty();
+}
+
+bool ConfigStorage::loadZones(zone_demand_t* zones, uint8_t& count, uint16_t& capacity)
+{
+  memcpy(zones, _config.zones, _config.zone_count * sizeof(zone_demand_t));
+  count = _config.zone_count;
+  capacity = _config.capacity;
+  return count > 0;
+}
+
+void ConfigStorage::loadToTaskManager(TaskManager& tm)
+{
+  tm.setStartTime(_config.sched_hour, _config.sched_minute);
+
+  for (uint8_t i = 0; i < MAX_PROGRAMS; i++)
+  {
+    program_t program;
+    if (loadProgram(i, program))
+    {
+      tm.scheduler().setProgram(i, program);
+    }
+  }
+
+  tm.clearValveSettings();
+  for (uint8_t i = 0; i < _config.task_count; i++)
+  {
+    valve_setting_t& task = _config.tasks[i];
+    tm.setValveSetting(i, task.valves, task.duration);
+    log_i("Applied task %d to TaskManager: %s, %d s", i, toValveString(task.valves, valves_zone_count()).c_str(), task.duration);
+  }
+}
+
+void ConfigStorage::reset()
+{
+  defaultConfig(_config);
+  _dirty = false;
+  defer_cancel(DEFER_CONFIG_FLUSH);
+
+  if (!begin()) return;
+
+  preferences.clear();
+  end();
+
+  log_i("Configuration reset to defaults");
+}
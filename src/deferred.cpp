@@ -0,0 +1,43 @@
+#include "deferred.h"
+#include "DeadlineQueue.h"
+#include <esp32-hal-log.h>
+
+static DeadlineQueue<DEFER_MAX> _queue;
+static DeferredAction _actions[DEFER_MAX] = {};
+
+bool defer_post(deferred_id_t id, uint32_t delay_ms, DeferredAction action)
+{
+  if (id >= DEFER_MAX || action == nullptr)
+  {
+    return false;
+  }
+
+  _actions[id] = action;
+  return _queue.schedule(id, millis() + delay_ms);
+}
+
+bool defer_cancel(deferred_id_t id)
+{
+  return _queue.cancel(id);
+}
+
+bool defer_pending(deferred_id_t id)
+{
+  return _queue.pending(id);
+}
+
+bool defer_next(uint32_t& at)
+{
+  return _queue.next(at);
+}
+
+void defer_loop()
+{
+  // Actions may post or cancel others; popDue() sees those changes
+  int id;
+  while ((id = _queue.popDue(millis())) >= 0)
+  {
+    log_d("Running deferred action %d", id);
+    _actions[id]();
+  }
+}
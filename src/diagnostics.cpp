@@ -0,0 +1,35 @@
+#include "diagnostics.h"
+
+void diagnostics_device(JsonDocument &doc, const valves_stats_t &valves, const ntp_status_t &clock, const power_stats_t &power)
+{
+  doc["valves"]["writes"] = valves.writes;
+  doc["valves"]["skipped"] = valves.skipped;
+  doc["valves"]["errors"] = valves.errors;
+  doc["valves"]["mismatches"] = valves.mismatches;
+
+  doc["clock"]["synced"] = clock.synced;
+  doc["clock"]["offset_ms"] = clock.offset_ms;
+  if (clock.estimated)
+  {
+    doc["clock"]["drift_ppm"] = clock.drift_ppm;
+  }
+  doc["clock"]["aging"] = clock.aging;
+  doc["clock"]["steps"] = clock.steps;
+
+  doc["power"]["light_sleep"] = power.light_sleep;
+  doc["power"]["duty"] = power.duty_permille / 10.0; // Percent of the time the control task was awake
+  doc["power"]["passes"] = power.passes;
+  doc["power"]["cpu_mhz"] = power.cpu_mhz;
+}
+
+void diagnostics_bus(JsonDocument &doc, const bus_stats_t (&bus)[BUS_DEVICES])
+{
+  for (uint8_t i = 0; i < BUS_DEVICES; i++)
+  {
+    JsonObject device = doc[bus_device_name((bus_device_t)i)].to<JsonObject>();
+    device["transactions"] = bus[i].transactions;
+    device["errors"] = bus[i].errors;
+    device["max_us"] = bus[i].max_us;
+    device["wait_max_us"] = bus[i].wait_max_us;
+  }
+}
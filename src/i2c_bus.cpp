@@ -0,0 +1,156 @@
+#include "i2c_bus.h"
+#include <esp32-hal-log.h>
+#include <freertos/semphr.h>
+
+static BusJob _jobs[BUS_DEVICES] = {};
+static uint32_t _posted_at[BUS_DEVICES] = {}; // micros() of the first post still pending
+static bool _waiting[BUS_DEVICES] = {};         // Posted, not started yet (continuations don't count)
+static bus_stats_t _stats[BUS_DEVICES] = {};
+static uint32_t _pass_started = 0;
+static SemaphoreHandle_t _lock = nullptr;
+static uint8_t _depth = 0; // Nested holds by the task that has the bus
+
+static const char* _names[BUS_DEVICES] = {"valves", "rtc", "lcd"};
+
+static void record(bus_device_t device, uint32_t us)
+{
+  bus_stats_t& stats = _stats[device];
+  stats.transactions++;
+  stats.busy_us += us;
+  if (us > stats.max_us)
+  {
+    stats.max_us = us;
+  }
+}
+
+static void bus_lock()
+{
+  xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+  if (_depth++ == 0)
+  {
+    _pass_started = micros();
+  }
+}
+
+static void bus_unlock()
+{
+  _depth--;
+  xSemaphoreGiveRecursive(_lock);
+}
+
+void bus_init()
+{
+  _lock = xSemaphoreCreateRecursiveMutex();
+}
+
+bool bus_post(bus_device_t device, BusJob job)
+{
+  if (device >= BUS_DEVICES || job == nullptr)
+  {
+    return false;
+  }
+
+  if (_jobs[device] == nullptr)
+  {
+    _posted_at[device] = micros();
+    _waiting[device] = true;
+  }
+  _jobs[device] = job;
+  return true;
+}
+
+bool bus_pending(bus_device_t device)
+{
+  return device < BUS_DEVICES && _jobs[device] != nullptr;
+}
+
+bool bus_budget_left()
+{
+  return micros() - _pass_started < BUS_BUDGET_US;
+}
+
+void bus_loop()
+{
+  bus_lock();
+
+  for (uint8_t i = 0; i < BUS_DEVICES; i++)
+  {
+    bus_device_t device = (bus_device_t)i;
+    BusJob job = _jobs[device];
+    if (job == nullptr)
+    {
+      continue;
+    }
+    if (!bus_budget_left())
+    {
+      break; // Lower priorities wait for the next pass
+    }
+
+    uint32_t started = micros();
+    if (_waiting[device])
+    {
+      _waiting[device] = false;
+      uint32_t wait = started - _posted_at[device];
+      if (wait > _stats[device].wait_max_us)
+      {
+        _stats[device].wait_max_us = wait;
+      }
+    }
+
+    // The job may post a follow-up for its own device
+    _jobs[device] = nullptr;
+    bool done = job();
+    record(device, micros() - started);
+
+    if (!done && _jobs[device] == nullptr)
+    {
+      _jobs[device] = job;
+    }
+  }
+  bus_unlock();
+}
+
+uint32_t bus_begin()
+{
+  bus_lock();
+  return micros();
+}
+
+void bus_end(bus_device_t device, uint32_t started, bool ok)
+{
+  if (device < BUS_DEVICES)
+  {
+    record(device, micros() - started);
+    if (!ok)
+    {
+      bus_fail(device);
+    }
+  }
+  bus_unlock();
+}
+
+void bus_fail(bus_device_t device)
+{
+  if (device < BUS_DEVICES)
+  {
+    _stats[device].errors++;
+  }
+}
+
+bus_stats_t bus_stats(bus_device_t device)
+{
+  if (device >= BUS_DEVICES)
+  {
+    return bus_stats_t{};
+  }
+
+  bus_lock(); // Updated by whichever task has the bus
+  bus_stats_t stats = _stats[device];
+  bus_unlock();
+  return stats;
+}
+
+const char* bus_device_name(bus_device_t device)
+{
+  return device < BUS_DEVICES ? _names[device] : "?";
+}
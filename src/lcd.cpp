@@ -1,53 +1,120 @@
-
 #include <lcd.h>
 #include "utils.h"
+#include "valves.h"
 #include "config.h"
+#include "i2c_bus.h"
 
 LCDi2c lcd(0x27, Wire);
 
+// What the screen should show and what the display is known to hold.
+// Callers only write into _frame; lcd_render() sends the cells that differ.
+static char _frame[LCD_ROWS][LCD_COLUMNS];
+static char _shown[LCD_ROWS][LCD_COLUMNS];
+
 void lcd_init() {
     lcd.begin(LCD_ROWS, LCD_COLUMNS);
     lcd.cls();
+    memset(_frame, ' ', sizeof(_frame));
+    memset(_shown, ' ', sizeof(_shown)); // cls() blanked the display
 }
 
-void lcd_print_date_time(int row, int column, DateTime time)
+void lcd_write(int row, int column, const char* text)
+{
+    if (row < 1 || row > LCD_ROWS || column < 1) {
+        return;
+    }
+
+    char* cells = _frame[row - 1];
+    for (int c = column - 1; c < LCD_COLUMNS && *text; c++) {
+        cells[c] = *text++;
+    }
+}
+
+void lcd_write_row(int row, int column, const char* text)
 {
-    lcd.locate(row, column);
+    if (row < 1 || row > LCD_ROWS || column < 1) {
+        return;
+    }
 
+    char* cells = _frame[row - 1];
+    for (int c = column - 1; c < LCD_COLUMNS; c++) {
+        cells[c] = *text ? *text++ : ' ';
+    }
+}
+
+bool lcd_render()
+{
+    for (uint8_t r = 0; r < LCD_ROWS; r++) {
+        int cursor = -1; // The display advances its cursor after each character
+        for (uint8_t c = 0; c < LCD_COLUMNS; c++) {
+            if (_frame[r][c] == _shown[r][c]) {
+                continue;
+            }
+            if (cursor != c) {
+                lcd.locate(r + 1, c + 1);
+            }
+            lcd.write(_frame[r][c]);
+            _shown[r][c] = _frame[r][c];
+            cursor = c + 1;
+
+            if (!bus_budget_left()) {
+                return false; // The rest on the next hold
+            }
+        }
+    }
+    return true;
+}
+
+void lcd_invalidate()
+{
+    memset(_shown, 0, sizeof(_shown)); // Matches no character, so every cell is resent
+}
+
+void lcd_print_date_time(int row, int column, DateTime time)
+{
     char buffer[20];
     snprintf(buffer, 20, "%02d.%02d.%04d %02d:%02d:%02d", time.day(), time.month(), time.year(), time.hour(), time.minute(), time.second());
 
-    lcd.print(buffer);
+    lcd_write(row, column, buffer);
 }
 
 void lcd_print_temp(int row, int column, float value)
 {
-    lcd.locate(row, column);
+    char value_buffer[10];
+    dtostrf(value, 5, 2, value_buffer);
 
-    char buffer[10];
-    dtostrf(value, 5, 2, buffer);
+    char buffer[LCD_COLUMNS + 1];
+    snprintf(buffer, sizeof(buffer), "Teplota: %s C", value_buffer);
 
-    lcd.printf("Teplota: %s C", buffer);
+    lcd_write(row, column, buffer);
 }
 
-
-void lcd_print_task(TaskManager& taskManager)
+// Pattern when it fits the row, otherwise the numbers of the open valves
+static void lcd_print_valves(int row, valve_mask_t valves)
 {
-    lcd.clr(1);
-    lcd.clr(2);
+    String pattern = toValveString(valves, valves_zone_count());
+    if (pattern.length() <= LCD_COLUMNS) {
+        lcd_write_row(row, 1, pattern.c_str());
+        return;
+    }
 
-    lcd.locate(1, 1);
-    lcd.printf(taskManager.statusMessage());
+    char buffer[LCD_COLUMNS + 1];
+    int len = snprintf(buffer, sizeof(buffer), "V:");
+    for (uint8_t zone = 0; zone < MAX_ZONES && len < LCD_COLUMNS; zone++) {
+        if (valves & valve_bit(zone)) {
+            len += snprintf(buffer + len, sizeof(buffer) - len, " %d", zone);
+        }
+    }
+    lcd_write_row(row, 1, buffer);
+}
 
-    if (taskManager.isRunning() && taskManager.isPumpOn()) { 
-        lcd.locate(2, 1);
+void lcd_print_task(const char* status, bool showValves, valve_mask_t valves)
+{
+    lcd_write_row(1, 1, status);
 
-        valve_setting_t* tsk = taskManager.actualValveSetting();
-        if (tsk == nullptr) {
-            lcd.print("No active task");
-            return;
-        } else {
-           lcd.print(toValveString(tsk->valves));
-        }
-   }
-}
\ No newline at end of file
+    if (showValves) {
+        lcd_print_valves(2, valves);
+    } else {
+        lcd_write_row(2, 1, "");
+    }
+}
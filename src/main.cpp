@@ -1,8 +1,8 @@
 
 #include <Arduino.h>
 #include <esp32-hal-log.h>
-#include <esp32fota.h>
 #include <esp_task_wdt.h>
+#include <freertos/queue.h>
 #include <Wire.h>
 #include <RTClib.h>
 
@@ -16,6 +16,16 @@
 #include "utils.h"
 #include "valves.h"
 #include "pump.h"
+#include "deferred.h"
+#include "checkpoint.h"
+#include "i2c_bus.h"
+#include "clock_service.h"
+#include "ntp_sync.h"
+#include "power.h"
+#include "diagnostics.h"
+#include "network.h"
+#include "ui.h"
+#include "rtos_tasks.h"
 
 char DeviceName[20]; //Wifi hostname - max 32 chars
 char mqtt_topic_tasks[36];
@@ -24,43 +34,69 @@ char mqtt_topic_cmnd[36];
 char mqtt_topic_conf[36];
 char mqtt_topic_state[37];
 char mqtt_topic_wifi[36];
+char mqtt_topic_events[38];
+char mqtt_topic_diag[36];
+char mqtt_topic_bus[35];
+
+// A received command, copied for the control task
+typedef struct
+{
+  bool config; // From the conf topic, otherwise cmnd
+  uint16_t length;
+  byte payload[MQTT_PAYLOAD_MAX];
+} control_message_t;
+
+QueueHandle_t controlQueue = nullptr;
+TaskHandle_t controlTaskHandle = nullptr;
 
 volatile bool alarm1Triggered = true;
+volatile uint32_t alarm1Micros = 0; // micros() when the alarm fired
 
 // https://github.com/lrswss/esp32-irrigation-automation
 // https://github.com/espressif/arduino-esp32/blob/2.0.14/libraries/ESP32/examples/Timer/RepeatTimer/RepeatTimer.ino
 // https://circuitdigest.com/microcontroller-projects/esp32-timers-and-timer-interrupts
 
-esp32FOTA esp32_FOTA(FOTA_FIRMWARE_TYPE, FIRMWARE_VERSION, false, true);
-
-TaskManager taskManager(20,0,false); // Enable PSRAM if available
+TaskManager taskManager(20, 0);
+ManualRuns manualRuns(taskManager);
 ConfigStorage configStorage;
 RTC_DS3231 rtc;
 
 DateTime alarm1Time = DateTime(2025, 1, 1, 0, 0, 0);
 
-bool clockSynced = false;
 bool rtcAvailable = false;
+uint32_t lastAlarmTime = 0; // Local RTC time of the last minute alarm
+valve_mask_t pendingValves = 0; // Last valve state asked for, written by writeValves()
+valve_mask_t confirmedValves = 0; // What the outputs last read back as, 0 after a failed write
 
-void synchronize_clock_from_ntp();
 void mqtt_message_handler(char *topic, byte *message, unsigned int length);
+void handleCommand(control_message_t& message);
+void controlTask(void *params);
+void controlLoop();
 void setupVariables();
 void setRTC();
 void setTaskManager();
-void displayReset(uint8_t minute);
+void showState();
 void publishWifiStatus(int minutes, String timestampMsg);
 void publishTaskStatus(TaskManager& taskManager, const String& timestampMsg);
+void publishTaskStatusNow();
 void checkIfExistNewFirmware(int minutes);
 void mqtt_setup_after_connect();
 void clearAlarm();
 
 void onPumpSet(bool onOff);
+void onMissedRun(uint8_t program, uint32_t at);
+bool isBusy();
 bool isPumpReady();
 void setValvesStatus(valve_setting_t *setting);
+bool writeValves();
+valve_mask_t openValves();
+void onValveFault();
 
 void onAlarm()
 {
+  alarm1Micros = micros();
   alarm1Triggered = true;
+  power_wake_from_isr();
 }
 
 void setup()
@@ -71,92 +107,137 @@ void setup()
   mqtt_init(DeviceName, MQTT_SERVER, MQTT_PORT, MQTT_USER, MQTT_PASSWORD, mqtt_topic_will);
   mqtt_set_callback(mqtt_message_handler, mqtt_setup_after_connect);
 
-  esp32_FOTA.setManifestURL(FOTA_MANIFEST_URL);
-  esp32_FOTA.printConfig();  
-
   log_i("Starting ESP32C3_IRRIGATION...");
 
   setTaskManager();
 
   Wire.begin(5, 4); // SDA on GPIO 5, SCL on GPIO 4
+  bus_init();
 
   lcd_init();
   valves_init();
   pump_init();
   setRTC();
 
-  // Configure hardware watchdog timer (30 seconds timeout)
+  if (rtcAvailable)
+  {
+    clock_init(rtc);
+    clock_sync();
+    ntp_init();
+    lastAlarmTime = clock_now().unixtime();
+    taskManager.tick(millis());
+    checkpoint_restore(taskManager, lastAlarmTime); // Cycle cut short by a watchdog or OTA restart
+  }
+
+  // Configure hardware watchdog timer (30 seconds timeout), each task adds itself
   esp_task_wdt_init(30, true);  // 30 seconds, panic on timeout
-  esp_task_wdt_add(NULL);       // Add current task to WDT
   log_i("Hardware watchdog enabled (30s timeout)");
+
+  // Each task preempts setup() as it is created; control comes last, so
+  // the queues it posts to exist by then
+  controlQueue = xQueueCreate(CONTROL_QUEUE_LENGTH, sizeof(control_message_t));
+  ui_start();
+  network_start();
+  xTaskCreate(controlTask, "control", CONTROL_TASK_STACK, nullptr, CONTROL_TASK_PRIORITY, &controlTaskHandle);
 }
 
-void printDateTime()
+void loop()
 {
-  if (!rtcAvailable) {
-    return;  // Skip if RTC not available
-  }
+  vTaskDelay(pdMS_TO_TICKS(1000)); // Everything runs in the tasks started by setup()
+}
 
-  DateTime now = rtc.now();
-  float temp = rtc.getTemperature();
+void controlTask(void *params)
+{
+  esp_task_wdt_add(NULL);
+  power_init(RTC_INT_PIN); // The alarm interrupt and received commands wake this task
 
-  lcd_print_date_time(3, 1, now);
-  lcd_print_temp(4, 1, temp);
+  for (;;)
+  {
+    controlLoop();
+  }
 }
 
-void loop()
+void controlLoop()
 {
-  esp_task_wdt_reset();  // Reset watchdog every loop iteration
+  esp_task_wdt_reset();  // Reset watchdog every pass
 
-  static unsigned long prevLoopTimer = 0;  // Only this should be static
+  static unsigned long prevLoopTimer = 0;
+  static control_message_t message; // Too big for the stack
 
-  // These must update every iteration - NOT static!
-  bool is_wifi_connected = wifi_loop();
-  bool is_mqtt_connected = is_wifi_connected && mqtt_loop();
+  // Before the commands: they time steps and manual runs from the last
+  // tick, which is a whole idle sleep ago when a command wakes this task
+  taskManager.tick(millis()); // Step transitions at second resolution
+  manualRuns.tick(millis());
+
+  while (xQueueReceive(controlQueue, &message, 0) == pdTRUE)
+  {
+    handleCommand(message);
+  }
+
+  defer_loop(); // Work posted by command handlers
 
     // run tasks once every second
   if (millis() - prevLoopTimer >= 1000) {
     prevLoopTimer = millis();
 
-    if (is_wifi_connected) {
-      synchronize_clock_from_ntp();
-    }
-    printDateTime();
+    showState();
+    checkpoint_save(taskManager, lastAlarmTime); // RAM only, cheap enough every second
   }
 
   if (alarm1Triggered)
   {
     log_i("Triggered Alarm ...");
   
+    uint32_t busStarted = bus_begin(); // The schedule needs the time now, not after the queue
     clearAlarm();
+    bus_end(BUS_RTC, busStarted);
+    power_rearm();
   
-    DateTime now = rtc.now();
+    clock_sync(); // The one time read per minute, everything else interpolates
+    ntp_alarm(alarm1Micros); // Compare with NTP time, retune or set the RTC
+    DateTime now = clock_now();
+    lastAlarmTime = now.unixtime();
 
     uint8_t minutes = now.minute();
-    uint8_t hours = now.hour();
 
-    taskManager.loop(hours, minutes); // Call task manager to check for tasks
-    displayReset(minutes); // Reset display at the start of each hour    
+    taskManager.loop(now.unixtime(), millis()); // Call task manager to check for tasks
 
-    if (is_wifi_connected && !taskManager.isRunning()) {
+    if (network_wifi_connected() && !taskManager.isRunning()) {
       checkIfExistNewFirmware(minutes); // Check for new firmware if no task is running
     }
         
     char timestampMsg[20];
     snprintf(timestampMsg, 20, "%02d.%02d.%04d %02d:%02d:%02d", now.day(), now.month(), now.year(), now.hour(), now.minute(), now.second());
 
-    lcd_print_task(taskManager);
+    showState();
 
-    if (is_mqtt_connected)
-    {
-      publishWifiStatus(now.minute(), timestampMsg);
-      publishTaskStatus(taskManager, timestampMsg);
-    }
+    // Queued while offline, superseded ones are coalesced
+    publishWifiStatus(now.minute(), timestampMsg);
+    publishTaskStatus(taskManager, timestampMsg);
 
-    log_i("Wifi: %d, MQTT: %d", is_wifi_connected, is_mqtt_connected);
+    log_i("Wifi: %d, MQTT: %d", network_wifi_connected(), network_mqtt_connected());
   }
   
-  vTaskDelay(100 / portTICK_PERIOD_MS); // Delay to avoid blocking the loop
+  clock_loop(); // Temperature refresh when due
+  bus_loop(); // Valve writes first, then the clock
+
+  // Sleeps until the next pass, the RTC alarm, a command or deferred work
+  uint32_t deferredAt;
+  uint32_t untilDeferred = UINT32_MAX;
+  if (defer_next(deferredAt))
+  {
+    int32_t due = (int32_t)(deferredAt - millis());
+    untilDeferred = due > 0 ? due : 0;
+  }
+  power_idle(isBusy(), untilDeferred);
+}
+
+// Work that needs control passes more often than once a second
+bool isBusy()
+{
+  uint32_t at;
+  return taskManager.isRunning() || manualRuns.isActive() || taskManager.nextDeadline(at) ||
+         bus_pending(BUS_VALVES) || bus_pending(BUS_RTC);
 }
 
 void clearAlarm() {      
@@ -168,99 +249,59 @@ void clearAlarm() {
     }
 }
 
-void synchronize_clock_from_ntp()
+// On the network task: commands touch the schedule and the valves, so
+// they are copied over to the control task
+void mqtt_message_handler(char *topic, byte *message, unsigned int length)
 {
-  if (clockSynced)
+  log_i("Message arrived on topic: %s", topic);
+
+  control_message_t received;
+  if (strcmp(topic, mqtt_topic_cmnd) == 0)
   {
-    return;
+    received.config = false;
   }
-
-  configTzTime("CET-1CEST,M3.5.0/2,M10.5.0/3", NTP_SERVER);
-
-  struct tm timeinfo;
-  if (getLocalTime(&timeinfo))
+  else if (strcmp(topic, mqtt_topic_conf) == 0)
   {
-    DateTime now = DateTime(timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday,
-                            timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
-
-    now = now + TimeSpan(0, 0, 0, 2); // Adjust to the next second to avoid issues with RTC initialization
-    rtc.adjust(now);                  // Nastavení času do RTC
-
-    log_i("RTC synchronized with NTP server.");
-    clockSynced = true;
+    received.config = true;
   }
-}
-
-void mqtt_message_handler(char *topic, byte *message, unsigned int length)
-{
-  log_i("Message arrived on topic: %s", topic);
-
-  String messageStr;
-  for (int i = 0; i < length; i++)
+  else
   {
-    messageStr += (char)message[i];
+    return;
   }
-  log_i("Message: %s", messageStr.c_str());
-
-  JsonDocument doc;
-  DeserializationError error = deserializeJson(doc, messageStr);
 
-  if (error)
+  if (length > sizeof(received.payload))
   {
-    log_e("JSON parse error: %s", error.c_str());
-    publishCommandResponse(mqtt_topic_state, "unknown", false, "Invalid JSON");
+    log_e("Command too long: %u bytes (max %u)", length, (unsigned)sizeof(received.payload));
     return;
   }
+  received.length = length;
+  memcpy(received.payload, message, length);
 
-  if (!doc.containsKey("cmd"))
+  if (xQueueSend(controlQueue, &received, 0) != pdTRUE)
   {
-    log_e("No 'cmd' field in message");
-    publishCommandResponse(mqtt_topic_state, "unknown", false, "Missing cmd field");
+    log_w("Control queue full, dropping command");
     return;
   }
+  if (controlTaskHandle != nullptr)
+  {
+    xTaskNotifyGive(controlTaskHandle); // Ends its idle wait
+  }
+}
 
-  const char* cmd = doc["cmd"];
-  bool success = false;
-  String responseMsg = "Unknown command";
-
-  if (strcmp(topic, mqtt_topic_cmnd) == 0)
+void handleCommand(control_message_t& message)
+{
+  command_context_t context = {taskManager, manualRuns, configStorage, mqtt_topic_state};
+  if (message.config)
   {
-    // Command topic handling
-    if (strcmp(cmd, "valve_control") == 0)
-    {
-      success = handleValveControl(doc, taskManager);
-      responseMsg = success ? "Valve control applied" : "Valve control failed";
-    }
-    else if (strcmp(cmd, "pump_control") == 0)
-    {
-      success = handlePumpControl(doc);
-      responseMsg = success ? "Pump control applied" : "Pump control failed";
-    }
-    else if (strcmp(cmd, "task_start") == 0)
-    {
-      success = handleTaskStart(taskManager);
-      responseMsg = success ? "Tasks started" : "Tasks already running";
-    }
-    else if (strcmp(cmd, "task_stop") == 0)
-    {
-      success = handleTaskStop(taskManager);
-      responseMsg = success ? "Tasks stopped" : "No tasks running";
-    }
-    else if (strcmp(cmd, "system_restart") == 0)
-    {
-      publishCommandResponse(mqtt_topic_state, cmd, true, "Restarting...");
-      handleSystemRestart(doc);  // This will restart the system
-      return;
-    }
+    dispatchConfig(message.payload, message.length, context);
   }
-  else if (strcmp(topic, mqtt_topic_conf) == 0)
+  else
   {
-    // Configuration topic handling (will be implemented with NVS storage)
-    log_i("Config update received - not yet implemented");
-    responseMsg = "Config updates not implemented yet";
+    dispatchCommand(message.payload, message.length, context);
   }
 
-  publishCommandResponse(mqtt_topic_state, cmd, success, responseMsg.c_str());
+  // One status update after a burst of commands, not one per command
+  defer_post(DEFER_STATUS_PUBLISH, 500, publishTaskStatusNow);
 }
 
 void setupVariables()
@@ -279,6 +320,9 @@ void setupVariables()
   snprintf(mqtt_topic_conf, sizeof(mqtt_topic_conf), "irrigation/%s/conf", DeviceName);
   snprintf(mqtt_topic_state, sizeof(mqtt_topic_state), "irrigation/%s/state", DeviceName); // 11 + 20 + 6 = 37
   snprintf(mqtt_topic_wifi, sizeof(mqtt_topic_wifi), "irrigation/%s/wifi", DeviceName);    // 11 + 20 + 5 = 36
+  snprintf(mqtt_topic_events, sizeof(mqtt_topic_events), "irrigation/%s/events", DeviceName); // 11 + 20 + 7 = 38
+  snprintf(mqtt_topic_diag, sizeof(mqtt_topic_diag), "irrigation/%s/diag", DeviceName);    // 11 + 20 + 5 = 36
+  snprintf(mqtt_topic_bus, sizeof(mqtt_topic_bus), "irrigation/%s/bus", DeviceName);       // 11 + 20 + 4 = 35
   snprintf(DeviceName, sizeof(DeviceName), "irrigation-%08X", deviceId);
 }
 
@@ -332,10 +376,15 @@ void setRTC()
 
 void setTaskManager()
 {
-  taskManager.setCallbacks(setValvesStatus, onPumpSet, isPumpReady);
-
-  // Try to load from NVS
-  if (configStorage.getTaskCount() > 0)
+  taskManager.setCallbacks(setValvesStatus, onPumpSet, isPumpReady, openValves);
+  taskManager.scheduler().setMissedCallback(onMissedRun);
+#ifdef SCHEDULE_CATCH_UP_MINUTES
+  taskManager.scheduler().setCatchUp(SCHEDULE_CATCH_UP_MINUTES * 60);
+#endif
+  manualRuns.setCallback(setValvesStatus);
+
+  // Try to load from NVS; a saved config with no steps is still the user's
+  if (configStorage.load())
   {
     log_i("Loading tasks from NVS");
     configStorage.loadToTaskManager(taskManager);
@@ -343,30 +392,37 @@ void setTaskManager()
   else
   {
     // Use defaults and save to NVS
-    log_i("No saved tasks, using defaults");
+    log_i("No saved configuration, using defaults");
 
     uint8_t hour = 20, minute = 0;
-    configStorage.saveSchedule(hour, minute);
     taskManager.setStartTime(hour, minute);
 
-    taskManager.setValveSetting(0, decodeBinaryString("oxo xxx xxx xxx"), 20);
-    configStorage.saveTask(0, decodeBinaryString("oxo xxx xxx xxx"), 20);
+    taskManager.setValveSetting(0, decodeBinaryString("oxo xxx xxx xxx"), 20 * 60);
+    taskManager.setValveSetting(1, decodeBinaryString("xox xxx xxx xox"), 17 * 60);
+    taskManager.setValveSetting(2, decodeBinaryString("xxx xxx oox xxx"), 15 * 60);
+    taskManager.setValveSetting(3, decodeBinaryString("xxx xxx xxx oxo"), 15 * 60);
 
-    taskManager.setValveSetting(1, decodeBinaryString("xox xxx xxx xox"), 17);
-    configStorage.saveTask(1, decodeBinaryString("xox xxx xxx xox"), 17);
-
-    taskManager.setValveSetting(2, decodeBinaryString("xxx xxx oox xxx"), 15);
-    configStorage.saveTask(2, decodeBinaryString("xxx xxx oox xxx"), 15);
-
-    taskManager.setValveSetting(3, decodeBinaryString("xxx xxx xxx oxo"), 15);
-    configStorage.saveTask(3, decodeBinaryString("xxx xxx xxx oxo"), 15);
+    configStorage.saveSchedule(hour, minute);
+    configStorage.saveTasks(taskManager);
   }
 }
 
-void displayReset(uint8_t minute)
+// What the LCD shows, from the cache: no RTC traffic, the UI task sends it
+void showState()
 {
-  // Removed hourly LCD reinit - only init in setup()
-  // If LCD issues occur, implement proper error detection and recovery in lcd.cpp
+  ui_state_t state = {};
+  state.time_valid = clock_valid();
+  if (state.time_valid)
+  {
+    state.time = clock_now().unixtime();
+    state.temperature = clock_temperature();
+  }
+  snprintf(state.status, sizeof(state.status), "%s", taskManager.statusMessage());
+
+  valve_setting_t* tsk = taskManager.actualValveSetting();
+  state.show_valves = taskManager.isRunning() && taskManager.isPumpOn() && tsk != nullptr;
+  state.valves = state.show_valves ? tsk->valves : 0;
+  ui_post(state);
 }
 
 void publishTaskStatus(TaskManager& taskManager, const String& timestampMsg)
@@ -376,6 +432,21 @@ void publishTaskStatus(TaskManager& taskManager, const String& timestampMsg)
   doc["at"] = taskManager.executeAt();
   doc["run"] = taskManager.isRunning();
   doc["pump"] = taskManager.isPumpOn();
+  doc["paused"] = taskManager.isPaused();
+
+  if (manualRuns.isActive()) {
+    doc["manual"]["valves"] = manualRuns.openValves();
+    doc["manual"]["queued"] = manualRuns.queued();
+  }
+
+  uint32_t next[3];
+  uint8_t count = taskManager.scheduler().nextRuns(next, 3);
+  for (uint8_t i = 0; i < count; i++) {
+    DateTime at(next[i]);
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%02d.%02d.%04d %02d:%02d", at.day(), at.month(), at.year(), at.hour(), at.minute());
+    doc["next"].add(buffer);
+  }
 
   valve_setting_t* tsk = taskManager.actualValveSetting();
   if (tsk != nullptr) {
@@ -387,21 +458,28 @@ void publishTaskStatus(TaskManager& taskManager, const String& timestampMsg)
   mqtt_publish_json(mqtt_topic_tasks, doc);
 }
 
-// Publish WiFi status and device information every 10 minutes
+void publishTaskStatusNow()
+{
+  char timestampMsg[20] = "";
+  if (clock_valid())
+  {
+    DateTime now = clock_now();
+    snprintf(timestampMsg, 20, "%02d.%02d.%04d %02d:%02d:%02d", now.day(), now.month(), now.year(), now.hour(), now.minute(), now.second());
+  }
+  publishTaskStatus(taskManager, timestampMsg);
+}
+
+// Publish WiFi status, device information and diagnostics every 10 minutes
 void publishWifiStatus(int minutes, String timestampMsg)
 {
   if ((minutes % 10 == 0))
   {
-    JsonDocument doc;
-    doc["uptime"] = millis() / 1000;
-    doc["time"] = timestampMsg;
-
-    wifi_add_info(doc); // Add WiFi info to the JSON document
-    mqtt_publish_json(mqtt_topic_wifi, doc);
-
-    doc.clear(); // Clear the document for the next use
+    network_request_t request = {NETWORK_PUBLISH_WIFI, mqtt_topic_wifi};
+    snprintf(request.time, sizeof(request.time), "%s", timestampMsg.c_str());
+    network_post(request); // Wi-Fi details come from the network task
 
-    float temp = rtc.getTemperature();
+    JsonDocument doc;
+    float temp = clock_temperature();
     char vBuffer[10];
     dtostrf(temp, 5, 2, vBuffer);
 
@@ -425,6 +503,21 @@ void publishWifiStatus(int minutes, String timestampMsg)
     // doc["psram"]["maxAlloc"] = ESP.getMaxAllocPsram();
 
     mqtt_publish_json(mqtt_topic_state, doc);
+
+    JsonDocument diag;
+    diag["time"] = timestampMsg;
+    diagnostics_device(diag, valves_stats(), ntp_status(), power_report());
+    mqtt_publish_json(mqtt_topic_diag, diag);
+
+    bus_stats_t bus[BUS_DEVICES];
+    for (uint8_t i = 0; i < BUS_DEVICES; i++)
+    {
+      bus[i] = bus_stats((bus_device_t)i);
+    }
+    JsonDocument busDoc;
+    busDoc["time"] = timestampMsg;
+    diagnostics_bus(busDoc, bus);
+    mqtt_publish_json(mqtt_topic_bus, busDoc);
   }
 }
 
@@ -435,7 +528,9 @@ void checkIfExistNewFirmware(int minutes)
     return;
   }
 
-  esp32_FOTA.handle(); // Check for updates
+  configStorage.flush(); // An update restarts the device
+  network_request_t request = {NETWORK_OTA_CHECK};
+  network_post(request); // Check for updates
 }
 
 void mqtt_setup_after_connect()
@@ -446,9 +541,51 @@ void mqtt_setup_after_connect()
 
 void onPumpSet(bool onOff)
 {
+  static unsigned long runStartedAt = 0;
+  static bool running = false;
+
   log_i("pump set to: %d", onOff);
-  valves_off();
-  pump_on(onOff);
+  pump_on(onOff); // Valves are sequenced by TaskManager around pump start/stop
+
+  if (onOff == running)
+  {
+    return;
+  }
+  running = onOff;
+
+  // Run records are events: they are queued until delivered
+  JsonDocument doc;
+  doc["event"] = onOff ? "run_start" : "run_end";
+  if (clock_valid())
+  {
+    DateTime now = clock_now();
+    char timestampMsg[20];
+    snprintf(timestampMsg, 20, "%02d.%02d.%04d %02d:%02d:%02d", now.day(), now.month(), now.year(), now.hour(), now.minute(), now.second());
+    doc["time"] = timestampMsg;
+  }
+  if (onOff)
+  {
+    runStartedAt = millis();
+  }
+  else
+  {
+    doc["seconds"] = (millis() - runStartedAt) / 1000;
+  }
+  mqtt_publish_json(mqtt_topic_events, doc, MQTT_EVENT);
+}
+
+void onMissedRun(uint8_t program, uint32_t at)
+{
+  // A start later than the catch-up window (device off, loop blocked)
+  DateTime due(at);
+  char dueMsg[17];
+  snprintf(dueMsg, sizeof(dueMsg), "%02d.%02d.%04d %02d:%02d", due.day(), due.month(), due.year(), due.hour(), due.minute());
+
+  JsonDocument doc;
+  doc["event"] = "run_missed";
+  doc["program"] = program;
+  doc["due"] = dueMsg;
+  mqtt_publish_json(mqtt_topic_events, doc, MQTT_EVENT);
 }
 
 bool isPumpReady()
@@ -464,6 +601,59 @@ void setValvesStatus(valve_setting_t *setting)
     return;
   }
 
-  log_i("Setting valves to: %s for %d minutes", toValveString(setting->valves).c_str(), setting->duration);
-  valves_write(setting->valves);
+  log_i("Setting valves to: %s for %d seconds", toValveString(setting->valves, valves_zone_count()).c_str(), setting->duration);
+  pendingValves = setting->valves;
+  bus_post(BUS_VALVES, writeValves); // Later changes in the same pass replace this one
+}
+
+// Bus job for setValvesStatus(), runs at the end of the same loop pass.
+// A write that is not confirmed stays posted and is retried every pass,
+// until it succeeds or a newer valve state replaces it. Watering is
+// stopped once VALVES_FAIL_LIMIT writes in a row were not confirmed.
+bool writeValves()
+{
+  static bool failing = false; // Logged once per run of failures
+
+  if (!valves_write(pendingValves))
+  {
+    confirmedValves = 0; // The pump is not started against them
+    bus_fail(BUS_VALVES);
+    if (!failing)
+    {
+      log_e("Valve outputs not confirmed, retrying");
+    }
+    failing = true;
+    if (valves_failing() >= VALVES_FAIL_LIMIT && (taskManager.isRunning() || manualRuns.isActive()))
+    {
+      onValveFault();
+    }
+    return false;
+  }
+
+  if (failing)
+  {
+    log_i("Valve outputs confirmed after retrying");
+  }
+  failing = false;
+  confirmedValves = pendingValves;
+  return true;
+}
+
+valve_mask_t openValves()
+{
+  return confirmedValves;
+}
+
+void onValveFault()
+{
+  // The zones asked for may not be open: stop the pump rather than run it dry
+  log_e("Valve outputs not confirmed %u times, stopping", (unsigned)valves_failing());
+  JsonDocument doc;
+  doc["event"] = "valve_fault";
+  doc["valves"] = toValveString(pendingValves, valves_zone_count());
+  doc["failures"] = valves_failing();
+
+  taskManager.stop(false); // Pump off now, the close write replaces this one
+  manualRuns.cancel(VALVES_ALL);
+  mqtt_publish_json(mqtt_topic_events, doc, MQTT_EVENT);
 }
\ No newline at end of file
@@ -1,102 +1,554 @@
-#include "mqtt_commands.h"
-#include "mqtt_handler.h"
-#include "pump.h"
-#include "valves.h"
-#include "utils.h"
-#include <esp32-hal-log.h>
-
-bool handleValveControl(JsonDocument& doc, TaskManager& taskManager)
-{
-  if (!doc["params"].containsKey("valves") || !doc["params"].containsKey("duration"))
-  {
-    log_e("Invalid valve_control params");
-    return false;
-  }
-
-  uint16_t valves = doc["params"]["valves"];
-  uint8_t duration = doc["params"]["duration"];
-
-  if (duration == 0)
-  {
-    valves_off();
-    log_i("Valves turned off via MQTT");
-    return true;
-  }
-
-  // Manual valve control - bypass task manager
-  if (taskManager.isRunning())
-  {
-    log_w("Task running, stopping before manual control");
-    taskManager.stop();
-  }
-
-  valves_write(valves);
-  log_i("Manual valve control: %s for %d minutes", toValveString(valves).c_str(), duration);
-
-  return true;
-}
-
-bool handlePumpControl(JsonDocument& doc)
-{
-  if (!doc["params"].containsKey("state"))
-  {
-    log_e("Invalid pump_control params");
-    return false;
-  }
-
-  bool state = doc["params"]["state"];
-  pump_on(state);
-  log_i("Pump set to %s via MQTT", state ? "ON" : "OFF");
-
-  return true;
-}
-
-bool handleTaskStart(TaskManager& taskManager)
-{
-  if (taskManager.isRunning())
-  {
-    log_w("Tasks already running");
-    return false;
-  }
-
-  taskManager.start();
-  log_i("Tasks started via MQTT");
-  return true;
-}
-
-bool handleTaskStop(TaskManager& taskManager)
-{
-  if (!taskManager.isRunning())
-  {
-    log_w("No tasks running");
-    return false;
-  }
-
-  taskManager.stop();
-  log_i("Tasks stopped via MQTT");
-  return true;
-}
-
-bool handleSystemRestart(JsonDocument& doc)
-{
-  int delay_sec = doc["params"].containsKey("delay") ? (int)doc["params"]["delay"] : 5;
-
-  log_i("System restart requested, restarting in %d seconds", delay_sec);
-
-  delay_sec = constrain(delay_sec, 1, 60);  // Limit to 1-60 seconds
-  delay(delay_sec * 1000);
-
-  ESP.restart();
-  return true;  // Never reached
-}
-
-void publishCommandResponse(const char* topic, const char* cmd, bool success, const char* message)
-{
-  JsonDocument doc;
-  doc["cmd"] = cmd;
-  doc["success"] = success;
-  doc["message"] = message;
-  doc["timestamp"] = millis();
-
-  mqtt_publish_json(topic, doc);
-}
+#include "mqtt_commands.h"
+#include "mqtt_handler.h"
+#include "pump.h"
+#include "valves.h"
+#include "utils.h"
+#include "deferred.h"
+#include "network.h"
+#include "arena_allocator.h"
+#include <esp32-hal-log.h>
+
+static void systemRestart()
+{
+  ConfigStorage::flushPending(); // Edits still waiting for their quiet period
+
+  // The network task delivers the outbox first; it owns the connection
+  network_request_t request = {NETWORK_RESTART};
+  if (!network_post(request))
+  {
+    ESP.restart();
+  }
+}
+
+// Valves as a bitmask or an "oxo xxx xxx xxx" pattern, only zones that are wired
+static bool parseValves(JsonVariant value, valve_mask_t& valves)
+{
+  if (value.is<const char*>())
+  {
+    valves = decodeBinaryString(value);
+  }
+  else if (value.is<valve_mask_t>())
+  {
+    valves = value;
+  }
+  else
+  {
+    return false;
+  }
+  return (valves & ~valve_mask_first(valves_zone_count())) == 0;
+}
+
+bool handleValveControl(JsonDocument& doc, command_context_t& context)
+{
+  ManualRuns& manualRuns = context.manualRuns;
+
+  // Checked before converting, so a negative or huge duration is not read
+  // as 0, which would close the zones
+  valve_mask_t valves;
+  JsonVariant priorityValue = doc["params"]["priority"];
+  if (!parseValves(doc["params"]["valves"], valves) || !doc["params"]["duration"].is<unsigned int>() ||
+      (!priorityValue.isNull() && !priorityValue.is<uint8_t>()))
+  {
+    log_e("Invalid valve_control params");
+    return false;
+  }
+
+  uint32_t duration = doc["params"]["duration"];
+  uint8_t priority = priorityValue | 0;
+
+  if (duration > 1000)
+  {
+    log_e("Manual run too long: %u minutes", (unsigned)duration);
+    return false;
+  }
+
+  if (duration == 0)
+  {
+    manualRuns.cancel(valves != 0 ? valves : VALVES_ALL);
+    log_i("Valves turned off via MQTT");
+    return true;
+  }
+
+  // A running program is paused while the manual zones are open
+  if (!manualRuns.request(valves, duration * 60, priority))
+  {
+    return false;
+  }
+  log_i("Manual valve control: %s for %u minutes", toValveString(valves, valves_zone_count()).c_str(), (unsigned)duration);
+
+  return true;
+}
+
+bool handlePumpControl(JsonDocument& doc, command_context_t& context)
+{
+  if (!doc["params"].containsKey("state"))
+  {
+    log_e("Invalid pump_control params");
+    return false;
+  }
+
+  bool state = doc["params"]["state"];
+  pump_on(state);
+  log_i("Pump set to %s via MQTT", state ? "ON" : "OFF");
+
+  return true;
+}
+
+bool handleTaskStart(JsonDocument& doc, command_context_t& context)
+{
+  TaskManager& taskManager = context.taskManager;
+
+  if (taskManager.isRunning())
+  {
+    log_w("Tasks already running");
+    return false;
+  }
+
+  taskManager.start();
+  log_i("Tasks started via MQTT");
+  return true;
+}
+
+bool handleTaskStop(JsonDocument& doc, command_context_t& context)
+{
+  TaskManager& taskManager = context.taskManager;
+
+  if (!taskManager.isRunning())
+  {
+    log_w("No tasks running");
+    return false;
+  }
+
+  taskManager.stop();
+  log_i("Tasks stopped via MQTT");
+  return true;
+}
+
+bool handleSystemRestart(JsonDocument& doc, command_context_t& context)
+{
+  int delay_sec = doc["params"].containsKey("delay") ? (int)doc["params"]["delay"] : 5;
+
+  log_i("System restart requested, restarting in %d seconds", delay_sec);
+
+  delay_sec = constrain(delay_sec, 1, 60);  // Limit to 1-60 seconds
+  return defer_post(DEFER_RESTART, delay_sec * 1000UL, systemRestart);
+}
+
+// Step table being built by zone_plan or the conf topic, one at a time on
+// the control task (too big for its stack)
+static valve_setting_t stagedSteps[MAX_TASKS];
+
+// Program fields shared by program_set and the conf topic
+static bool parseProgram(JsonVariant params, program_t& program)
+{
+  if (!params["starts"].is<JsonArray>())
+  {
+    return false;
+  }
+
+  program = {};
+  program.enabled = params["enabled"] | true;
+  program.weekdays = params["weekdays"] | WEEKDAYS_ALL;
+
+  const char* days = params["days"] | "all";
+  if (strcmp(days, "odd") == 0)
+  {
+    program.day_filter = DAYS_ODD;
+  }
+  else if (strcmp(days, "even") == 0)
+  {
+    program.day_filter = DAYS_EVEN;
+  }
+  else
+  {
+    program.day_filter = DAYS_ALL;
+  }
+
+  for (JsonVariant start : params["starts"].as<JsonArray>())
+  {
+    if (program.start_count >= MAX_PROGRAM_STARTS || !parseTimeOfDay(start.as<const char*>(), program.starts[program.start_count]))
+    {
+      log_e("Invalid program start time");
+      return false;
+    }
+    program.start_count++;
+  }
+
+  if (params.containsKey("from") || params.containsKey("to"))
+  {
+    if (!parseMonthDay(params["from"].as<const char*>(), program.season_from) || !parseMonthDay(params["to"].as<const char*>(), program.season_to))
+    {
+      log_e("Invalid program season");
+      return false;
+    }
+  }
+
+  return ProgramScheduler::isValid(program);
+}
+
+static bool parseStep(JsonVariant params, valve_setting_t& step)
+{
+  if (!parseValves(params["valves"], step.valves) || !params["duration"].is<unsigned int>())
+  {
+    return false;
+  }
+
+  uint32_t duration = params["duration"];
+  if (duration > UINT16_MAX)
+  {
+    log_e("Step duration %u s is above %u s", (unsigned)duration, (unsigned)UINT16_MAX);
+    return false;
+  }
+  step.duration = duration;
+  return true;
+}
+
+bool handleProgramSet(JsonDocument& doc, command_context_t& context)
+{
+  TaskManager& taskManager = context.taskManager;
+  ConfigStorage& configStorage = context.configStorage;
+  JsonVariant params = doc["params"];
+  program_t program;
+  if (!params.containsKey("idx") || !parseProgram(params, program))
+  {
+    log_e("Invalid program_set params");
+    return false;
+  }
+
+  uint8_t idx = params["idx"];
+  if (!taskManager.scheduler().setProgram(idx, program))
+  {
+    return false;
+  }
+
+  configStorage.saveProgram(idx, program);
+  log_i("Program %d set via MQTT: %d starts", idx, program.start_count);
+  return true;
+}
+
+bool handleZonePlan(JsonDocument& doc, command_context_t& context)
+{
+  TaskManager& taskManager = context.taskManager;
+  ConfigStorage& configStorage = context.configStorage;
+  JsonVariant params = doc["params"];
+  zone_demand_t zones[MAX_ZONES] = {};
+  uint8_t count = 0;
+  uint16_t capacity = 0;
+
+  // Without a zone list, re-plan the stored demands (e.g. new capacity only)
+  configStorage.loadZones(zones, count, capacity);
+  capacity = params["capacity"] | capacity;
+
+  if (params["zones"].is<JsonArray>())
+  {
+    memset(zones, 0, sizeof(zones));
+    count = 0;
+    for (JsonVariant zone : params["zones"].as<JsonArray>())
+    {
+      uint8_t valve = zone["valve"] | MAX_ZONES;
+      if (valve >= valves_zone_count())
+      {
+        log_e("Invalid zone valve");
+        return false;
+      }
+      zones[valve].flow = zone["flow"] | 0;
+      zones[valve].duration = zone["duration"] | 0;
+      count = max<uint8_t>(count, valve + 1);
+    }
+  }
+
+  if (count == 0 || capacity == 0)
+  {
+    log_e("zone_plan needs zones and a capacity");
+    return false;
+  }
+
+  valve_setting_t* steps = stagedSteps;
+  zone_plan_t plan;
+  if (!planZones(zones, count, capacity, steps, MAX_TASKS, plan))
+  {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < plan.steps; i++)
+  {
+    log_i("Plan step %d: %s for %d s", i, toValveString(steps[i].valves, valves_zone_count()).c_str(), steps[i].duration);
+  }
+  taskManager.stageValveSettings(steps, plan.steps); // A running cycle finishes on the old plan
+
+  configStorage.saveZones(zones, count, capacity);
+  configStorage.saveTasks(steps, plan.steps);
+  log_i("Zone plan applied: %d steps, %u s window", plan.steps, plan.window);
+  return true;
+}
+
+static ArenaAllocator<4096> commandArena; // One variant pool (1 KB on ESP32, 3 KB on 64-bit hosts) plus strings
+static JsonDocument commandDoc(&commandArena);
+
+typedef bool (*CommandHandler)(JsonDocument& doc, command_context_t& context);
+
+typedef struct
+{
+  const char* name;
+  CommandHandler handler;
+  const char* okMessage;
+  const char* failMessage;
+} command_t;
+
+// Sorted by name, looked up with bsearch
+static constexpr command_t commands[] = {
+  {"program_set", handleProgramSet, "Program saved", "Invalid program"},
+  {"pump_control", handlePumpControl, "Pump control applied", "Pump control failed"},
+  {"system_restart", handleSystemRestart, "Restarting...", "Restart failed"},
+  {"task_start", handleTaskStart, "Tasks started", "Tasks already running"},
+  {"task_stop", handleTaskStop, "Tasks stopped", "No tasks running"},
+  {"valve_control", handleValveControl, "Valve control applied", "Valve control failed"},
+  {"zone_plan", handleZonePlan, "Zone plan applied", "Zone plan failed"},
+};
+static constexpr size_t commandCount = sizeof(commands) / sizeof(commands[0]);
+
+static constexpr int compareNames(const char* a, const char* b)
+{
+  return (*a != *b || *a == 0) ? (int)(unsigned char)*a - (int)(unsigned char)*b : compareNames(a + 1, b + 1);
+}
+
+static constexpr bool commandsSorted(size_t i = 1)
+{
+  return i >= commandCount || (compareNames(commands[i - 1].name, commands[i].name) < 0 && commandsSorted(i + 1));
+}
+
+static_assert(commandsSorted(), "commands[] must be sorted by name");
+
+static int compareCommand(const void* key, const void* entry)
+{
+  return strcmp((const char*)key, ((const command_t*)entry)->name);
+}
+
+// Parses straight from the client's buffer into the arena
+static bool parsePayload(const byte* payload, unsigned int length, command_context_t& context, const char* cmd)
+{
+  log_i("Message: %.*s", (int)length, (const char*)payload);
+
+  commandDoc.clear();
+  commandArena.reset();
+  DeserializationError error = deserializeJson(commandDoc, (const char*)payload, length);
+
+  if (error)
+  {
+    log_e("JSON parse error: %s", error.c_str());
+    publishCommandResponse(context.responseTopic, cmd, false, error == DeserializationError::NoMemory ? "Message too large" : "Invalid JSON");
+    return false;
+  }
+  return true;
+}
+
+void dispatchCommand(const byte* payload, unsigned int length, command_context_t& context)
+{
+  if (!parsePayload(payload, length, context, "unknown"))
+  {
+    return;
+  }
+
+  const char* cmd = commandDoc["cmd"];
+  if (cmd == nullptr)
+  {
+    log_e("No 'cmd' field in message");
+    publishCommandResponse(context.responseTopic, "unknown", false, "Missing cmd field");
+    return;
+  }
+
+  const command_t* command = (const command_t*)bsearch(cmd, commands, commandCount, sizeof(command_t), compareCommand);
+  if (command == nullptr)
+  {
+    log_w("Unknown command: %s", cmd);
+    publishCommandResponse(context.responseTopic, cmd, false, "Unknown command");
+    return;
+  }
+
+  bool success = command->handler(commandDoc, context);
+  publishCommandResponse(context.responseTopic, cmd, success, success ? command->okMessage : command->failMessage);
+}
+
+// Validates the whole update against copies; nothing is applied unless all
+// of it is valid. Returns the error, or nullptr once applied.
+static const char* applyConfig(JsonDocument& doc, command_context_t& context)
+{
+  TaskManager& taskManager = context.taskManager;
+  ConfigStorage& configStorage = context.configStorage;
+
+  // The start shorthand moves only the first start of program 0; its other
+  // starts, days and season stay
+  bool hasStart = doc.containsKey("start");
+  uint16_t start = 0;
+  program_t startProgram = *taskManager.scheduler().program(0);
+  if (hasStart)
+  {
+    if (!parseTimeOfDay(doc["start"].as<const char*>(), start))
+    {
+      return "Invalid start";
+    }
+    if (startProgram.start_count == 0)
+    {
+      // Empty program 0: a daily start, as setStartTime() makes it
+      startProgram = {};
+      startProgram.start_count = 1;
+      startProgram.weekdays = WEEKDAYS_ALL;
+      startProgram.enabled = 1;
+    }
+    startProgram.starts[0] = start;
+    if (!ProgramScheduler::isValid(startProgram))
+    {
+      return "Start is not before the other starts";
+    }
+  }
+
+  program_t programs[MAX_PROGRAMS];
+  uint8_t programMask = 0;
+  if (doc.containsKey("programs"))
+  {
+    if (!doc["programs"].is<JsonArray>())
+    {
+      return "Invalid programs";
+    }
+    for (JsonVariant params : doc["programs"].as<JsonArray>())
+    {
+      uint8_t idx = params["idx"] | MAX_PROGRAMS;
+      if (idx >= MAX_PROGRAMS || !parseProgram(params, programs[idx]))
+      {
+        return "Invalid program";
+      }
+      programMask |= 1 << idx;
+    }
+  }
+
+  // Partial step edits apply on top of the newest stored table
+  valve_setting_t* steps = stagedSteps;
+  uint8_t stepCount = 0;
+  bool hasSteps = doc.containsKey("steps") || doc.containsKey("step");
+  while (stepCount < configStorage.getTaskCount() && configStorage.loadTask(stepCount, steps[stepCount].valves, steps[stepCount].duration))
+  {
+    stepCount++;
+  }
+
+  if (doc.containsKey("steps"))
+  {
+    if (!doc["steps"].is<JsonArray>())
+    {
+      return "Invalid steps";
+    }
+    stepCount = 0;
+    for (JsonVariant params : doc["steps"].as<JsonArray>())
+    {
+      if (stepCount >= MAX_TASKS)
+      {
+        return "Too many steps";
+      }
+      if (!parseStep(params, steps[stepCount]))
+      {
+        return "Invalid step";
+      }
+      stepCount++;
+    }
+    if (stepCount == 0)
+    {
+      return "No steps"; // An empty table reads as nothing saved at boot
+    }
+  }
+
+  if (doc.containsKey("step"))
+  {
+    if (!doc["step"].is<JsonArray>())
+    {
+      return "Invalid step";
+    }
+    for (JsonVariant params : doc["step"].as<JsonArray>())
+    {
+      uint8_t idx = params["idx"] | MAX_TASKS;
+      if (idx >= MAX_TASKS || idx > stepCount)
+      {
+        return "Invalid step index"; // Steps are contiguous
+      }
+      if (!parseStep(params, steps[idx]))
+      {
+        return "Invalid step";
+      }
+      if (idx == stepCount)
+      {
+        stepCount++;
+      }
+    }
+  }
+
+  if (!hasStart && programMask == 0 && !hasSteps)
+  {
+    return "Nothing to update";
+  }
+
+  // Everything is valid: apply, then persist in one write
+  if (hasStart)
+  {
+    configStorage.saveSchedule(start / 60, start % 60);
+    if (!(programMask & 1))
+    {
+      taskManager.scheduler().setProgram(0, startProgram);
+      configStorage.saveProgram(0, startProgram); // Would override the start at boot
+    }
+  }
+
+  for (uint8_t i = 0; i < MAX_PROGRAMS; i++)
+  {
+    if (programMask & (1 << i))
+    {
+      taskManager.scheduler().setProgram(i, programs[i]);
+      configStorage.saveProgram(i, programs[i]);
+    }
+  }
+
+  if (hasSteps)
+  {
+    taskManager.stageValveSettings(steps, stepCount);
+    configStorage.saveTasks(steps, stepCount);
+  }
+
+  configStorage.flush();
+  log_i("Configuration applied: start=%d, programs=0x%x, %d steps", hasStart, programMask, stepCount);
+  return nullptr;
+}
+
+void dispatchConfig(const byte* payload, unsigned int length, command_context_t& context)
+{
+  if (!parsePayload(payload, length, context, "conf"))
+  {
+    return;
+  }
+
+  const char* error = applyConfig(commandDoc, context);
+  if (error != nullptr)
+  {
+    log_e("Config update rejected: %s", error);
+    publishCommandResponse(context.responseTopic, "conf", false, error);
+    return;
+  }
+
+  publishCommandResponse(context.responseTopic, "conf", true,
+                         context.taskManager.hasStagedValveSettings() ? "Applied, steps switch after the running cycle" : "Configuration applied");
+}
+
+void publishCommandResponse(const char* topic, const char* cmd, bool success, const char* message)
+{
+  // The command is done with: its document and arena hold the response.
+  // cmd may point into them, so it is copied out first.
+  char name[32];
+  snprintf(name, sizeof(name), "%s", cmd);
+  commandDoc.clear();
+  commandArena.reset();
+
+  commandDoc["cmd"] = name;
+  commandDoc["success"] = success;
+  commandDoc["message"] = message;
+  commandDoc["timestamp"] = millis();
+
+  mqtt_publish_json(topic, commandDoc, MQTT_EVENT);
+  commandDoc.clear();
+  commandArena.reset();
+}
@@ -1,6 +1,8 @@
 #include "mqtt_handler.h"
 #include <WiFi.h>
 #include <esp32-hal-log.h>
+#include <freertos/semphr.h>
+#include "utils.h"
 
 WiFiClient _wifiClient;
 PubSubClient _mqttClient(_wifiClient);
@@ -9,11 +11,42 @@ const char* willMessageOffline = "offline";
 const char* willMessageOnline = "online";
 
 static const char* _device_name;
+static const char* _server;
+static uint16_t _port;
 static const char* _user;
 static const char* _password;
 static const char* _mqtt_topic_will;
 
+#define MQTT_SOCKET_TIMEOUT_S 3 // Upper bound for the CONNACK and every later read
+#define MQTT_CONNECT_TIMEOUT_MS 1500 // TCP handshake
+#define MQTT_BACKOFF_BASE_MS 1000
+#define MQTT_BACKOFF_MAX_MS 300000
+
 static unsigned long lastMqttAttemptTime = 0;
+static uint32_t _mqttRetryDelay = 0;
+static backoff_t _mqttBackoff = {MQTT_BACKOFF_BASE_MS, MQTT_BACKOFF_MAX_MS, 0};
+static bool _wasConnected = false;
+static IPAddress _serverIp;
+static bool _resolved = false; // _serverIp holds the broker's address
+
+typedef struct
+{
+    const char* topic; // Topics are static buffers owned by the caller
+    uint32_t seq;      // Queue order, 0 = free slot
+    uint16_t length;
+    mqtt_kind_t kind;
+    char payload[MQTT_PAYLOAD_MAX + 1];
+} mqtt_message_t;
+
+static mqtt_message_t _queue[MQTT_QUEUE_SLOTS];
+static uint8_t _queue_count = 0;
+static uint32_t _queue_seq = 0;
+static unsigned long _lastDrainTime = 0;
+
+// Any task queues, the network task sends. The lock is never held while
+// publishing, so a slow socket does not hold up the control task.
+static SemaphoreHandle_t _queue_lock = nullptr;
+static mqtt_message_t* _sending = nullptr; // Being published from a copy
 
 SimpleAction _callbackConnected = nullptr;
 
@@ -28,34 +61,165 @@ void mqtt_init_after_connect()
 void mqtt_init(const char* device_name,const char* server, int port, const char* user, const char* password, const char* mqtt_topic_will)
 {
     _device_name = device_name;
+    _server = server;
+    _port = port;
     _user = user;
     _password = password;
     _mqtt_topic_will = mqtt_topic_will;
+    _queue_lock = xSemaphoreCreateMutex();
 
     _mqttClient.setServer(server, port);
+    _mqttClient.setSocketTimeout(MQTT_SOCKET_TIMEOUT_S);
+    _mqttClient.setBufferSize(MQTT_PAYLOAD_MAX + 128); // Room for the topic and header
     //_mqttClient.setCallback([](char* topic, byte* payload, unsigned int length) {
 }
 
+// Oldest queued message, optionally only of one kind
+static mqtt_message_t* queue_oldest(bool anyKind, mqtt_kind_t kind)
+{
+    mqtt_message_t* oldest = nullptr;
+    for (uint8_t i = 0; i < MQTT_QUEUE_SLOTS; i++) {
+        mqtt_message_t* m = &_queue[i];
+        if (m->seq != 0 && (anyKind || m->kind == kind) && (oldest == nullptr || m->seq < oldest->seq)) {
+            oldest = m;
+        }
+    }
+    return oldest;
+}
+
+static void queue_release(mqtt_message_t* m)
+{
+    m->seq = 0;
+    _queue_count--;
+}
+
+// Slot for a new message: a status replaces the queued one for its topic in
+// place; when full, the oldest status and then the oldest event is dropped
+static mqtt_message_t* queue_slot(const char* topic, mqtt_kind_t kind)
+{
+    mqtt_message_t* slot = nullptr;
+    for (uint8_t i = 0; i < MQTT_QUEUE_SLOTS && slot == nullptr; i++) {
+        mqtt_message_t* m = &_queue[i];
+        if (kind == MQTT_STATUS && m->seq != 0 && m->kind == MQTT_STATUS && m != _sending && strcmp(m->topic, topic) == 0) {
+            return m; // Superseded, keeps its place in the queue
+        }
+    }
+
+    if (_queue_count == MQTT_QUEUE_SLOTS) {
+        mqtt_message_t* victim = queue_oldest(false, MQTT_STATUS);
+        if (victim == nullptr) {
+            victim = queue_oldest(true, MQTT_EVENT);
+        }
+        log_w("MQTT queue full, dropping message for %s", victim->topic);
+        queue_release(victim);
+    }
+
+    for (uint8_t i = 0; i < MQTT_QUEUE_SLOTS; i++) {
+        if (_queue[i].seq == 0) {
+            slot = &_queue[i];
+            break;
+        }
+    }
+
+    slot->topic = topic;
+    slot->kind = kind;
+    slot->seq = ++_queue_seq;
+    _queue_count++;
+    return slot;
+}
+
+// Publish the oldest queued message, false if the client refused it
+static bool queue_send()
+{
+    static mqtt_message_t copy; // Only the network task sends
+
+    xSemaphoreTake(_queue_lock, portMAX_DELAY);
+    mqtt_message_t* m = queue_oldest(true, MQTT_STATUS);
+    if (m != nullptr) {
+        copy = *m;
+        _sending = m;
+    }
+    xSemaphoreGive(_queue_lock);
+    if (m == nullptr) {
+        return false;
+    }
+
+    bool sent = _mqttClient.publish(copy.topic, (const uint8_t*)copy.payload, copy.length, copy.kind == MQTT_STATUS);
+
+    xSemaphoreTake(_queue_lock, portMAX_DELAY);
+    _sending = nullptr;
+    if (sent && m->seq == copy.seq) {
+        queue_release(m); // Unless dropped from a full queue meanwhile
+    }
+    xSemaphoreGive(_queue_lock);
+
+    if (!sent) {
+        log_w("MQTT publish to %s failed, keeping it queued", copy.topic);
+    }
+    return sent;
+}
+
+static void queue_drain()
+{
+    unsigned long currentTime = millis();
+    if (_queue_count == 0 || currentTime - _lastDrainTime < MQTT_DRAIN_INTERVAL_MS) {
+        return;
+    }
+
+    _lastDrainTime = currentTime;
+    queue_send();
+}
+
+// Opens the socket for PubSubClient, which skips its own unbounded
+// connect() when it finds one open. The broker's name is resolved once and
+// again only after a failed attempt, as the lookup blocks until lwIP gives up.
+static bool mqtt_open_socket()
+{
+    if (!_resolved)
+    {
+        if (!_serverIp.fromString(_server) && !WiFi.hostByName(_server, _serverIp))
+        {
+            log_e("Cannot resolve MQTT server %s", _server);
+            return false;
+        }
+        _resolved = true;
+    }
+
+    if (!_wifiClient.connect(_serverIp, _port, MQTT_CONNECT_TIMEOUT_MS))
+    {
+        _resolved = false; // The broker may have moved
+        log_e("MQTT server %s not reachable", _serverIp.toString().c_str());
+        return false;
+    }
+    return true;
+}
+
 void mqtt_connect()
 {
     if (_mqttClient.connected())
     {
         return;
     }
-    
+
     unsigned long currentTime = millis();
-    if (currentTime - lastMqttAttemptTime >= 30000) { // Attempt to reconnect every 30 seconds
-        lastMqttAttemptTime = currentTime;
+    if (currentTime - lastMqttAttemptTime < _mqttRetryDelay)
+    {
+        return;
+    }
+    lastMqttAttemptTime = currentTime;
 
-        if (_mqttClient.connect(_device_name, _user, _password, _mqtt_topic_will, 1, true, willMessageOffline)) {
-            log_i("MQTT connected");
-            _mqttClient.publish(_mqtt_topic_will, willMessageOnline, true);
-            mqtt_init_after_connect();
-        }
-        else
-        {
-            log_e("failed, rc=%d try again in 5 seconds", _mqttClient.state());
-        }
+    // Only the CONNACK is waited for in connect(), bounded by the socket
+    // timeout; every other wait happens here between loop() calls
+    if (mqtt_open_socket() && _mqttClient.connect(_device_name, _user, _password, _mqtt_topic_will, 1, true, willMessageOffline)) {
+        log_i("MQTT connected");
+        backoff_reset(_mqttBackoff);
+        _mqttClient.publish(_mqtt_topic_will, willMessageOnline, true);
+        mqtt_init_after_connect();
+    }
+    else
+    {
+        _mqttRetryDelay = backoff_next(_mqttBackoff);
+        log_e("failed, rc=%d try again in %u ms", _mqttClient.state(), _mqttRetryDelay);
     }
 }
 
@@ -64,8 +228,21 @@ bool mqtt_loop()
     bool isConnected = _mqttClient.loop();
     if (!isConnected)
     {
+        if (_wasConnected)
+        {
+            // Connection lost: first retry after a short randomised pause
+            _mqttRetryDelay = backoff_next(_mqttBackoff);
+            lastMqttAttemptTime = millis();
+            log_w("MQTT connection lost, retry in %u ms", _mqttRetryDelay);
+        }
         mqtt_connect();
+        isConnected = _mqttClient.connected();
+    }
+    else
+    {
+        queue_drain();
     }
+    _wasConnected = isConnected;
     return isConnected;
 }
 
@@ -75,21 +252,46 @@ bool mqtt_is_connected()
 }
 
 
-bool mqtt_publish_json(const char* topic, JsonDocument& doc) {
-    char buffer[512];
-    size_t len = serializeJson(doc, buffer);
+bool mqtt_publish_json(const char* topic, JsonDocument& doc, mqtt_kind_t kind) {
+    size_t len = measureJson(doc);
+    if (len > MQTT_PAYLOAD_MAX) {
+        log_e("JSON too large for MQTT queue: %u bytes (max %d)", (unsigned)len, MQTT_PAYLOAD_MAX);
+        return false;
+    }
 
-    if (len >= sizeof(buffer)) {
-        log_e("JSON too large for MQTT buffer: %d bytes (max %d)", len, sizeof(buffer) - 1);
+    xSemaphoreTake(_queue_lock, portMAX_DELAY);
+    mqtt_message_t* slot = queue_slot(topic, kind);
+    slot->length = serializeJson(doc, slot->payload, sizeof(slot->payload));
+    xSemaphoreGive(_queue_lock);
+    return true;
+}
+
+bool mqtt_publish(const char *topic, const char *payload, mqtt_kind_t kind)
+{
+    size_t len = strlen(payload);
+    if (len > MQTT_PAYLOAD_MAX) {
+        log_e("Payload too large for MQTT queue: %u bytes (max %d)", (unsigned)len, MQTT_PAYLOAD_MAX);
         return false;
     }
 
-    return _mqttClient.publish(topic, buffer, len);
+    xSemaphoreTake(_queue_lock, portMAX_DELAY);
+    mqtt_message_t* slot = queue_slot(topic, kind);
+    memcpy(slot->payload, payload, len);
+    slot->length = len;
+    xSemaphoreGive(_queue_lock);
+    return true;
 }
 
-bool mqtt_publish(const char *topic, const char *payload)
+uint8_t mqtt_queue_size()
 {
-    return _mqttClient.publish(topic, payload);
+    return _queue_count;
+}
+
+void mqtt_flush()
+{
+    while (_queue_count > 0 && _mqttClient.connected() && queue_send()) {
+        _mqttClient.loop();
+    }
 }
 
 void mqtt_subscribe(const char* topic, uint8_t qos) {
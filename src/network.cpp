@@ -0,0 +1,105 @@
+#include "network.h"
+#include "rtos_tasks.h"
+#include "config.h"
+#include "wifi_handler.h"
+#include "mqtt_handler.h"
+#include "ntp_sync.h"
+#include <esp32fota.h>
+#include <esp_task_wdt.h>
+#include <freertos/queue.h>
+#include <esp32-hal-log.h>
+
+static esp32FOTA _fota(FOTA_FIRMWARE_TYPE, FIRMWARE_VERSION, false, true);
+
+static TaskHandle_t _task = nullptr;
+static QueueHandle_t _requests = nullptr;
+static volatile bool _wifi_connected = false;
+static volatile bool _mqtt_connected = false;
+
+static void handle(const network_request_t& request, bool connected)
+{
+  switch (request.type)
+  {
+  case NETWORK_PUBLISH_WIFI:
+  {
+    JsonDocument doc;
+    doc["uptime"] = millis() / 1000;
+    doc["time"] = request.time;
+    wifi_add_info(doc); // Add WiFi info to the JSON document
+    mqtt_publish_json(request.topic, doc);
+    break;
+  }
+
+  case NETWORK_OTA_CHECK:
+    if (!connected)
+    {
+      break;
+    }
+    mqtt_flush(); // An update restarts the device
+    esp_task_wdt_delete(nullptr); // A download outlasts the watchdog; control keeps running meanwhile
+    _fota.handle();
+    esp_task_wdt_add(nullptr);
+    break;
+
+  case NETWORK_RESTART:
+    mqtt_flush(); // Deliver the response and queued run records first
+    ESP.restart();
+    break;
+  }
+}
+
+static void networkTask(void* params)
+{
+  esp_task_wdt_add(nullptr);
+
+  for (;;)
+  {
+    esp_task_wdt_reset();
+
+    bool is_wifi_connected = wifi_loop();
+    bool is_mqtt_connected = is_wifi_connected && mqtt_loop();
+    _wifi_connected = is_wifi_connected;
+    _mqtt_connected = is_mqtt_connected;
+    ntp_loop(is_wifi_connected);
+
+    network_request_t request;
+    while (xQueueReceive(_requests, &request, 0) == pdTRUE)
+    {
+      handle(request, is_wifi_connected);
+    }
+
+    // network_post() wakes it early; the outbox drains one message per interval
+    uint32_t wait = is_mqtt_connected && mqtt_queue_size() > 0 ? MQTT_DRAIN_INTERVAL_MS : NETWORK_POLL_MS;
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
+  }
+}
+
+void network_start()
+{
+  _fota.setManifestURL(FOTA_MANIFEST_URL);
+  _fota.printConfig();
+
+  _requests = xQueueCreate(NETWORK_QUEUE_LENGTH, sizeof(network_request_t));
+  xTaskCreate(networkTask, "network", NETWORK_TASK_STACK, nullptr, NETWORK_TASK_PRIORITY, &_task);
+}
+
+bool network_post(const network_request_t& request)
+{
+  if (_requests == nullptr || xQueueSend(_requests, &request, 0) != pdTRUE)
+  {
+    log_w("Network queue full, dropping request %d", request.type);
+    return false;
+  }
+  xTaskNotifyGive(_task);
+  return true;
+}
+
+bool network_wifi_connected()
+{
+  return _wifi_connected;
+}
+
+bool network_mqtt_connected()
+{
+  return _mqtt_connected;
+}
@@ -0,0 +1,146 @@
+#include "ntp_sync.h"
+#include "clock_service.h"
+#include "deferred.h"
+#include "config.h"
+#include "ClockDiscipline.h"
+#include <esp_sntp.h>
+#include <esp32-hal-log.h>
+#include <sys/time.h>
+
+static const char* TIMEZONE = "CET-1CEST,M3.5.0/2,M10.5.0/3";
+
+static ClockDiscipline _discipline;
+static bool _started = false;
+static volatile bool _synced = false; // Set from the SNTP task
+static volatile uint32_t _synced_ms = 0;
+static uint32_t _steps = 0;
+
+static uint64_t _uptime_ms = 0; // Monotonic across millis() wraps
+static uint32_t _uptime_last = 0;
+
+static void onTimeSync(struct timeval* tv)
+{
+  _synced_ms = millis();
+  _synced = true;
+}
+
+// Local wall time in ms from a system time in us
+static int64_t localMs(int64_t us)
+{
+  time_t seconds = us / 1000000;
+  struct tm local;
+  localtime_r(&seconds, &local);
+  DateTime dt(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday, local.tm_hour, local.tm_min, local.tm_sec);
+  return dt.unixtime() * 1000LL + us % 1000000 / 1000;
+}
+
+static int64_t systemUs()
+{
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static void stepClock()
+{
+  // The RTC restarts its second when it is set, so it is set on a whole
+  // second of system time. Posted to land on :30; a pass that comes too far
+  // off the second (a long one before it) is posted again for the next one,
+  // and once more it takes the nearer second.
+  static bool retried = false;
+  int64_t now = systemUs();
+  uint32_t fraction = now % 1000000;
+  if (!retried && fraction > NTP_STEP_SLACK_US && fraction < 1000000 - NTP_STEP_SLACK_US)
+  {
+    retried = true;
+    defer_post(DEFER_CLOCK_STEP, (1000000 - fraction) / 1000 + 1, stepClock);
+    return;
+  }
+  retried = false;
+  if (fraction >= 500000)
+  {
+    now += 1000000 - fraction; // Round to the nearer second
+  }
+
+  DateTime dt((uint32_t)(localMs(now) / 1000));
+  if (clock_adjust(dt))
+  {
+    _steps++;
+    log_i("RTC set from NTP to %02d:%02d:%02d", dt.hour(), dt.minute(), dt.second());
+  }
+}
+
+void ntp_init()
+{
+  int8_t aging = 0;
+  if (!clock_read_aging(aging))
+  {
+    log_w("Cannot read RTC aging offset, assuming 0");
+  }
+  _discipline.reset(aging);
+  _uptime_last = millis();
+}
+
+void ntp_loop(bool connected)
+{
+  if (_started || !connected)
+  {
+    return;
+  }
+
+  // SNTP keeps re-syncing on its own from here on
+  sntp_set_time_sync_notification_cb(onTimeSync);
+  sntp_set_sync_interval(NTP_SYNC_INTERVAL_MS);
+  configTzTime(TIMEZONE, NTP_SERVER);
+  _started = true;
+}
+
+void ntp_alarm(uint32_t alarmUs)
+{
+  uint32_t now = millis();
+  _uptime_ms += now - _uptime_last;
+  _uptime_last = now;
+
+  if (!_synced || now - _synced_ms > NTP_MAX_AGE_MS || defer_pending(DEFER_CLOCK_STEP) || !clock_valid())
+  {
+    return;
+  }
+
+  uint32_t late = micros() - alarmUs;
+  if (late >= 1000000)
+  {
+    return; // Too long ago to tell which second the alarm was
+  }
+
+  // The alarm fired as the RTC turned to second 0 of its minute
+  DateTime rtc = clock_now();
+  int64_t rtcMs = (rtc.unixtime() - rtc.second()) * 1000LL;
+  int64_t systemMs = localMs(systemUs() - late);
+  int64_t offset = constrain(rtcMs - systemMs, (int64_t)INT32_MIN, (int64_t)INT32_MAX);
+
+  clock_correction_t correction = _discipline.sample((int32_t)offset, (uint32_t)(_uptime_ms / 1000));
+  if (correction.set_aging && !clock_write_aging(correction.aging))
+  {
+    int8_t aging = 0;
+    clock_read_aging(aging);
+    _discipline.reset(aging);
+  }
+
+  if (correction.step)
+  {
+    int64_t until = 30000 - (systemMs + late / 1000) % 60000;
+    defer_post(DEFER_CLOCK_STEP, until > 0 ? until : until + 60000, stepClock);
+  }
+}
+
+ntp_status_t ntp_status()
+{
+  ntp_status_t status;
+  status.synced = _synced && millis() - _synced_ms <= NTP_MAX_AGE_MS;
+  status.offset_ms = _discipline.lastOffsetMs();
+  status.estimated = _discipline.hasEstimate();
+  status.drift_ppm = _discipline.driftPpm();
+  status.aging = _discipline.aging();
+  status.steps = _steps;
+  return status;
+}
@@ -0,0 +1,123 @@
+#include "power.h"
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <WiFi.h>
+#include <esp32-hal-log.h>
+
+static TaskHandle_t _control_task = nullptr;
+static gpio_num_t _wake_pin;
+static bool _light_sleep = false;
+static bool _busy = true; // Until the first power_idle() says otherwise
+static esp_pm_lock_handle_t _cpu_lock = nullptr;
+static esp_pm_lock_handle_t _sleep_lock = nullptr;
+
+static uint32_t _awake_since = 0;  // micros() when the pass started
+static uint64_t _active_us = 0;
+static uint32_t _passes = 0;
+static uint32_t _report_ms = 0;
+
+void power_init(uint8_t wakePin)
+{
+  _control_task = xTaskGetCurrentTaskHandle();
+  _wake_pin = (gpio_num_t)wakePin;
+  _awake_since = micros();
+  _report_ms = millis();
+
+#if POWER_SAVE && !(defined(CONFIG_PM_ENABLE) && defined(CONFIG_FREERTOS_USE_TICKLESS_IDLE))
+  // The prebuilt Arduino-ESP32 libraries have neither; light sleep then
+  // never happens, so none is configured or reported
+  log_w("POWER_SAVE needs CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE, ignored");
+#elif POWER_SAVE
+  esp_pm_config_esp32c3_t config = {};
+  config.max_freq_mhz = POWER_MAX_MHZ;
+  config.min_freq_mhz = POWER_MIN_MHZ;
+  config.light_sleep_enable = true;
+  esp_err_t err = esp_pm_configure(&config);
+  if (err != ESP_OK)
+  {
+    log_w("Power management not available: %s", esp_err_to_name(err));
+    return;
+  }
+
+  esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "busy", &_cpu_lock);
+  esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "busy", &_sleep_lock);
+  esp_pm_lock_acquire(_cpu_lock);
+  esp_pm_lock_acquire(_sleep_lock);
+
+  // Edges are not seen while asleep, the level is
+  gpio_wakeup_enable(_wake_pin, GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  WiFi.setSleep(true);
+
+  _light_sleep = true;
+  log_i("Light sleep enabled, %d-%d MHz", POWER_MIN_MHZ, POWER_MAX_MHZ);
+#endif
+}
+
+void power_wake_from_isr()
+{
+  if (_light_sleep)
+  {
+    // The wake level also triggers the interrupt; keep it off until the
+    // alarm is cleared and the line is released
+    gpio_intr_disable(_wake_pin);
+  }
+
+  if (_control_task != nullptr)
+  {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(_control_task, &woken);
+    portYIELD_FROM_ISR(woken);
+  }
+}
+
+void power_rearm()
+{
+  if (_light_sleep)
+  {
+    gpio_intr_enable(_wake_pin);
+  }
+}
+
+void power_idle(bool busy, uint32_t maxWaitMs)
+{
+  if (_light_sleep && busy != _busy)
+  {
+    if (busy)
+    {
+      esp_pm_lock_acquire(_cpu_lock);
+      esp_pm_lock_acquire(_sleep_lock);
+    }
+    else
+    {
+      esp_pm_lock_release(_sleep_lock);
+      esp_pm_lock_release(_cpu_lock);
+    }
+  }
+  _busy = busy;
+
+  _active_us += micros() - _awake_since;
+  _passes++;
+
+  uint32_t wait = busy || !_light_sleep ? POWER_BUSY_MS : POWER_IDLE_MS;
+  wait = min(wait, maxWaitMs);
+  ulTaskNotifyTake(pdTRUE, wait / portTICK_PERIOD_MS);
+  _awake_since = micros();
+}
+
+power_stats_t power_report()
+{
+  power_stats_t stats;
+  uint32_t elapsed = millis() - _report_ms;
+  stats.light_sleep = _light_sleep;
+  stats.busy = _busy;
+  stats.duty_permille = elapsed > 0 ? min<uint64_t>(_active_us / elapsed, 1000) : 0;
+  stats.passes = _passes;
+  stats.cpu_mhz = getCpuFrequencyMhz();
+
+  _active_us = 0;
+  _passes = 0;
+  _report_ms = millis();
+  return stats;
+}
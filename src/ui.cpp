@@ -0,0 +1,67 @@
+#include "ui.h"
+#include "rtos_tasks.h"
+#include "lcd.h"
+#include "i2c_bus.h"
+#include <esp_task_wdt.h>
+#include <freertos/queue.h>
+
+static const uint32_t UI_WAIT_MS = 5000; // Feeds the watchdog while nothing changes
+
+static QueueHandle_t _states = nullptr;
+static int8_t _hour = -1;
+
+static void compose(const ui_state_t& state)
+{
+    if (state.time_valid) {
+        DateTime now(state.time);
+
+        // Only changes are sent, so a display that lost characters (noise,
+        // brown-out) would keep them wrong: rewrite it fully once an hour
+        if (now.hour() != _hour) {
+            _hour = now.hour();
+            lcd_invalidate();
+        }
+
+        lcd_print_date_time(3, 1, now);
+        lcd_print_temp(4, 1, state.temperature);
+    }
+    lcd_print_task(state.status, state.show_valves, state.valves);
+}
+
+// One budget at a time, the control task gets the bus between slices
+static void render()
+{
+    bool done = false;
+    while (!done) {
+        uint32_t started = bus_begin();
+        done = lcd_render();
+        bus_end(BUS_LCD, started);
+    }
+}
+
+static void uiTask(void* params)
+{
+    esp_task_wdt_add(nullptr);
+
+    ui_state_t state;
+    for (;;) {
+        esp_task_wdt_reset();
+        if (xQueueReceive(_states, &state, pdMS_TO_TICKS(UI_WAIT_MS)) == pdTRUE) {
+            compose(state);
+            render();
+        }
+    }
+}
+
+void ui_start()
+{
+    _states = xQueueCreate(1, sizeof(ui_state_t));
+    xTaskCreate(uiTask, "ui", UI_TASK_STACK, nullptr, UI_TASK_PRIORITY, nullptr);
+}
+
+void ui_post(const ui_state_t& state)
+{
+    if (_states != nullptr) {
+        xQueueOverwrite(_states, &state);
+    }
+}
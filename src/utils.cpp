@@ -1,13 +1,14 @@
 #include "utils.h"
+#include <Arduino.h>
 
 
-String toValveString(uint16_t value)
+String toValveString(valve_mask_t value, uint8_t zones)
 {
   String result = "";
-  for (int i = 0; i < 12; i++)
+  for (uint8_t i = 0; i < zones; i++)
   {
-    result += (value & (1 << i)) ? 'o' : 'x';
-    if ((i + 1) % 3 == 0 && i != 15)
+    result += (value & valve_bit(i)) ? 'o' : 'x';
+    if ((i + 1) % 3 == 0 && i + 1 < zones)
     {
       result += ' ';
     }
@@ -15,22 +16,78 @@ String toValveString(uint16_t value)
   return result;
 }
 
-uint16_t decodeBinaryString(const char *input)
+valve_mask_t decodeBinaryString(const char *input)
 {
-  uint16_t result = 0;
+  valve_mask_t result = 0;
 
   int idx = 0;
   int len = strlen(input);
-  for (int i = 0; i < len; i++)
+  for (int i = 0; i < len && idx < MAX_ZONES; i++)
   {
     if (input[i] != ' ')
     {
       if (input[i] == 'o')
       {
-        result |= (1 << idx); // bit i je nastaven na 1
+        result |= valve_bit(idx); // bit i je nastaven na 1
       }
       idx++;
     }
   }
   return result;
-}
\ No newline at end of file
+}
+
+bool parseTimeOfDay(const char *input, uint16_t &minutes)
+{
+  unsigned int hour, minute;
+  if (input == nullptr || sscanf(input, "%u:%u", &hour, &minute) != 2 || hour > 23 || minute > 59)
+  {
+    return false;
+  }
+  minutes = hour * 60 + minute;
+  return true;
+}
+
+bool parseMonthDay(const char *input, uint16_t &mmdd)
+{
+  unsigned int month, day;
+  if (input == nullptr || sscanf(input, "%u-%u", &month, &day) != 2 || month < 1 || month > 12 || day < 1 || day > 31)
+  {
+    return false;
+  }
+  mmdd = month * 100 + day;
+  return true;
+}
+
+uint32_t crc32(const void *data, size_t length, uint32_t crc)
+{
+  const uint8_t *bytes = (const uint8_t *)data;
+  crc = ~crc;
+  while (length--)
+  {
+    crc ^= *bytes++;
+    for (int k = 0; k < 8; k++)
+    {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+uint32_t backoff_next(backoff_t &backoff)
+{
+  uint32_t delay_ms = backoff.max_ms;
+  if (backoff.attempt < 31 && (backoff.base_ms << backoff.attempt) >> backoff.attempt == backoff.base_ms)
+  {
+    delay_ms = min(backoff.base_ms << backoff.attempt, backoff.max_ms);
+  }
+  if (delay_ms < backoff.max_ms)
+  {
+    backoff.attempt++;
+  }
+  return delay_ms / 2 + random(delay_ms / 2 + 1);
+}
+
+void backoff_reset(backoff_t &backoff)
+{
+  backoff.attempt = 0;
+}
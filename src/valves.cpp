@@ -1,40 +1,137 @@
 #include "valves.h"
 #include <esp32-hal-log.h>
 
-PCF8574 pfc_box12(PCF_38_ADDRESS); // Ventil krabice 1,2
-PCF8574 pfc_box34(PCF_3C_ADDRESS); // Ventil krabice 3,4
+static constexpr valve_expander_t _expanders[] = VALVE_EXPANDERS;
+static constexpr uint8_t EXPANDER_COUNT = sizeof(_expanders) / sizeof(_expanders[0]);
 
-void valves_init()
+static constexpr uint16_t zonesFrom(uint8_t idx)
+{
+    return idx < EXPANDER_COUNT ? _expanders[idx].valves + zonesFrom(idx + 1) : 0;
+}
+
+static constexpr bool expandersFit(uint8_t idx)
 {
-    if (!pfc_box12.begin(255))
+    return idx >= EXPANDER_COUNT || (_expanders[idx].valves <= 8 && expandersFit(idx + 1));
+}
+
+static_assert(expandersFit(0), "A PCF8574 drives at most 8 valves");
+static_assert(zonesFrom(0) <= MAX_ZONES, "VALVE_EXPANDERS wires more zones than MAX_ZONES");
+
+// One expander and the last byte known to be in its output latch
+typedef struct
+{
+    PCF8574 pcf;
+    uint8_t first; // Zone on P0
+    uint8_t pins;  // Pins wired to valves
+    uint8_t value;
+    bool valid; // false until a write succeeds, or after a failure
+} valve_box_t;
+
+static valve_box_t _boxes[EXPANDER_COUNT];
+
+static valves_stats_t _stats = {};
+static uint16_t _failing = 0;
+
+static bool box_write(valve_box_t &box, uint8_t value)
+{
+    if (box.valid && box.value == value)
     {
-        log_e("pfc_box12 initialization failed!");
+        _stats.skipped++;
+        return true;
     }
 
-    if (!pfc_box34.begin(255))
+    box.valid = false;
+    box.pcf.write8(value);
+    int error = box.pcf.lastError();
+    if (error != PCF8574_OK)
     {
-        log_e("pfc_box34 initialization failed!");
+        _stats.errors++;
+        log_e("Valve box 0x%02X write failed: %d", box.pcf.getAddress(), error);
+        return false;
     }
-}
+    _stats.writes++;
+
+#if VALVES_VERIFY
+    uint8_t readback = box.pcf.read8();
+    error = box.pcf.lastError();
+    if (error != PCF8574_OK)
+    {
+        _stats.errors++;
+        log_e("Valve box 0x%02X readback failed: %d", box.pcf.getAddress(), error);
+        return false;
+    }
+    if (readback != value)
+    {
+        _stats.mismatches++;
+        log_e("Valve box 0x%02X reads 0x%02X, wrote 0x%02X (stuck line?)", box.pcf.getAddress(), readback, value);
+        return false;
+    }
+#endif
 
+    box.value = value;
+    box.valid = true;
+    return true;
+}
 
-void valves_write(uint16_t value)
+void valves_init()
 {
-    uint8_t box12 = static_cast<uint8_t>(value & 0x003F);
-    uint8_t box34 = static_cast<uint8_t>((value & 0xFC0) >> 6);
-
-    uint8_t negBox12 = ~box12;
-    uint8_t negBox34 = ~box34;
+    uint8_t zone = 0;
+    for (uint8_t i = 0; i < EXPANDER_COUNT; i++)
+    {
+        valve_box_t &box = _boxes[i];
+        box.pcf = PCF8574(_expanders[i].address);
+        box.first = zone;
+        box.pins = (1 << _expanders[i].valves) - 1;
+        box.valid = false;
+        zone += _expanders[i].valves;
 
-    pfc_box12.write8(negBox12);
-    pfc_box34.write8(negBox34);
+        if (!box.pcf.begin(255))
+        {
+            log_e("Valve box 0x%02X initialization failed!", _expanders[i].address);
+        }
+    }
+    log_i("%d valves on %d expanders", zone, EXPANDER_COUNT);
+}
 
 
-    log_d("Box 1,2: %u | %u | Box 3,4: %u | %u", box12, negBox12, box34, negBox34);
+bool valves_write(valve_mask_t value)
+{
+    // Valves are active-low; unused pins stay high
+    bool ok = true;
+    for (uint8_t i = 0; i < EXPANDER_COUNT; i++)
+    {
+        valve_box_t &box = _boxes[i];
+        uint8_t bits = (value >> box.first) & box.pins;
+        ok = box_write(box, ~bits) && ok;
+        log_d("Box 0x%02X: %u | %u", box.pcf.getAddress(), bits, (uint8_t)~bits);
+    }
+    if (ok)
+    {
+        _failing = 0;
+    }
+    else if (_failing < UINT16_MAX)
+    {
+        _failing++;
+    }
+    return ok;
 }
 
 void valves_off()
 {
-    pfc_box12.write8(0xFF); // Vypne všechny ventily v krabici 1,2
-    pfc_box34.write8(0xFF); // Vypne všechny ventily v krabici 3,4
-}
\ No newline at end of file
+    valves_write(0); // Vypne všechny ventily
+}
+
+uint8_t valves_zone_count()
+{
+    return zonesFrom(0);
+}
+
+valves_stats_t valves_stats()
+{
+    return _stats;
+}
+
+uint16_t valves_failing()
+{
+    return _failing;
+}
@@ -1,11 +1,30 @@
 #include "wifi_handler.h"
 #include <WiFi.h>
 #include <esp32-hal-log.h>
+#include "utils.h"
 
 static const char *_wifi_ssid = nullptr;
 static const char *_wifi_password = nullptr;
-static unsigned long lastWifiAttemptTime = 0;
-static bool wifiConnected = false;
+
+#define WIFI_CONNECT_TIMEOUT_MS 20000 // Give up on an attempt after this
+#define WIFI_BACKOFF_BASE_MS 2000
+#define WIFI_BACKOFF_MAX_MS 300000
+
+typedef enum
+{
+    WIFI_STATE_BACKOFF,    // Waiting _stateDelay before the next attempt
+    WIFI_STATE_CONNECTING, // begin() issued, waiting for an IP
+    WIFI_STATE_CONNECTED
+} wifi_state_t;
+
+static wifi_state_t _state = WIFI_STATE_BACKOFF;
+static unsigned long _stateSince = 0;
+static uint32_t _stateDelay = 0;
+static backoff_t _backoff = {WIFI_BACKOFF_BASE_MS, WIFI_BACKOFF_MAX_MS, 0};
+
+// Set by the event handlers, consumed by wifi_loop()
+static volatile bool _gotIp = false;
+static volatile bool _disconnected = false;
 
 /*
  * WiFi Event Reference
@@ -18,13 +37,26 @@ static bool wifiConnected = false;
  */
 
 void WiFiGotIP(WiFiEvent_t event, WiFiEventInfo_t info){
-    log_i("WiFi connected - IP address: %s", WiFi.localIP().toString().c_str());
-    wifiConnected = true;
+    _gotIp = true;
 }
 
 void WiFiDisconnected(WiFiEvent_t event, WiFiEventInfo_t info){
     log_d("WiFi lost connection. Reason: %d",info.wifi_sta_disconnected.reason);
-    wifiConnected = false;
+    _disconnected = true;
+}
+
+static void wifi_enter(wifi_state_t state, uint32_t delay_ms)
+{
+    _state = state;
+    _stateSince = millis();
+    _stateDelay = delay_ms;
+}
+
+static void wifi_backoff()
+{
+    uint32_t delay_ms = backoff_next(_backoff);
+    log_i("WiFi retry in %u ms", delay_ms);
+    wifi_enter(WIFI_STATE_BACKOFF, delay_ms);
 }
 
 void wifi_init(const char *device_name, const char *ssid, const char *password)
@@ -45,28 +77,54 @@ void wifi_init(const char *device_name, const char *ssid, const char *password)
 void wifi_connect(bool rst)
 {
     WiFi.disconnect(true, rst);
-    delay(1000);                   // short delay to avoid overloading
-    WiFi.mode(WIFI_STA); // Set WiFi mode to Station
-    wl_status_t status = WiFi.begin(_wifi_ssid, _wifi_password);
-    log_i("Connecting to WiFi SSID: %s, status: %d", _wifi_ssid, status);
-    delay(50); // short delay to avoid overloading
+    // The driver settles while we back off, begin() follows from wifi_loop()
+    wifi_enter(WIFI_STATE_BACKOFF, 1000);
 }
 
 bool wifi_loop()
 {
-    bool isConnected = WiFi.status() == WL_CONNECTED;
-    if (!isConnected)
+    unsigned long elapsed = millis() - _stateSince;
+
+    switch (_state)
     {
-        log_d("WiFi not connected - status: %d", WiFi.status());
-        unsigned long currentTime = millis();
-        if (currentTime - lastWifiAttemptTime >= 60000)
-        { // Attempt to reconnect every 60 seconds
-            lastWifiAttemptTime = currentTime;
-            log_i("Reconnecting to WiFi...");
-            wifi_connect(false);
+    case WIFI_STATE_BACKOFF:
+        if (elapsed >= _stateDelay)
+        {
+            WiFi.mode(WIFI_STA); // Set WiFi mode to Station
+            _gotIp = false;
+            _disconnected = false;
+            wifi_enter(WIFI_STATE_CONNECTING, WIFI_CONNECT_TIMEOUT_MS);
+            wl_status_t status = WiFi.begin(_wifi_ssid, _wifi_password);
+            log_i("Connecting to WiFi SSID: %s, status: %d", _wifi_ssid, status);
+        }
+        break;
+
+    case WIFI_STATE_CONNECTING:
+        if (_gotIp)
+        {
+            log_i("WiFi connected - IP address: %s", WiFi.localIP().toString().c_str());
+            _disconnected = false;
+            backoff_reset(_backoff);
+            wifi_enter(WIFI_STATE_CONNECTED, 0);
         }
+        else if (_disconnected || elapsed >= _stateDelay)
+        {
+            log_w("WiFi connection attempt failed - status: %d", WiFi.status());
+            WiFi.disconnect(true, false);
+            wifi_backoff();
+        }
+        break;
+
+    case WIFI_STATE_CONNECTED:
+        if (_disconnected || WiFi.status() != WL_CONNECTED)
+        {
+            log_i("WiFi disconnected, reconnecting...");
+            wifi_backoff();
+        }
+        break;
     }
-    return isConnected && wifiConnected;
+
+    return _state == WIFI_STATE_CONNECTED;
 }
 
 bool wifi_is_connected()
@@ -80,6 +138,6 @@ void wifi_add_info(JsonDocument &doc)
     doc["wifi"]["bssid"] = WiFi.BSSIDstr();
     doc["wifi"]["rssi"] = WiFi.RSSI();
     doc["wifi"]["channel"] = WiFi.channel();
-    doc["wifi"]["ip"] = WiFi.localIP();
+    doc["wifi"]["ip"] = WiFi.localIP().toString();
     doc["wifi"]["mac"] = WiFi.macAddress();
 }
\ No newline at end of file
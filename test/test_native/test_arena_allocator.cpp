@@ -0,0 +1,67 @@
+#include <unity.h>
+#include "arena_allocator.h"
+#include "tests.h"
+
+static void allocates_aligned_blocks_until_full()
+{
+  static ArenaAllocator<64> arena;
+  arena.reset();
+
+  uint8_t* a = (uint8_t*)arena.allocate(3);
+  uint8_t* b = (uint8_t*)arena.allocate(16);
+  TEST_ASSERT_NOT_NULL(a);
+  TEST_ASSERT_NOT_NULL(b);
+  TEST_ASSERT_EQUAL_UINT32(0, (uintptr_t)a % 8);
+  TEST_ASSERT_EQUAL_UINT32(16, b - a); // Header plus 3 bytes rounded up
+
+  TEST_ASSERT_NOT_NULL(arena.allocate(8));
+  TEST_ASSERT_NULL(arena.allocate(1)); // 8 bytes left, the smallest block takes 16
+}
+
+static void only_the_newest_block_is_given_back()
+{
+  static ArenaAllocator<64> arena;
+  arena.reset();
+
+  void* a = arena.allocate(8);
+  void* b = arena.allocate(8);
+  arena.deallocate(a); // Waits for reset()
+  arena.deallocate(b);
+  TEST_ASSERT_TRUE(arena.allocate(8) == b);
+}
+
+static void reallocate_grows_the_newest_block_in_place()
+{
+  static ArenaAllocator<128> arena;
+  arena.reset();
+
+  char* a = (char*)arena.allocate(8);
+  strcpy(a, "abcdefg");
+  TEST_ASSERT_TRUE(arena.reallocate(a, 40) == a);
+
+  char* b = (char*)arena.allocate(8);
+  char* moved = (char*)arena.reallocate(a, 48); // No longer the newest: copied
+  TEST_ASSERT_NOT_NULL(moved);
+  TEST_ASSERT_TRUE(moved > b);
+  TEST_ASSERT_EQUAL_STRING("abcdefg", moved);
+  TEST_ASSERT_NULL(arena.reallocate(moved, 1024));
+}
+
+static void reset_releases_everything()
+{
+  static ArenaAllocator<32> arena;
+  arena.reset();
+
+  void* first = arena.allocate(24);
+  TEST_ASSERT_NULL(arena.allocate(1));
+  arena.reset();
+  TEST_ASSERT_TRUE(arena.allocate(24) == first);
+}
+
+void test_arena_allocator()
+{
+  RUN_TEST(allocates_aligned_blocks_until_full);
+  RUN_TEST(only_the_newest_block_is_given_back);
+  RUN_TEST(reallocate_grows_the_newest_block_in_place);
+  RUN_TEST(reset_releases_everything);
+}
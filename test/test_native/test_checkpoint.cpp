@@ -0,0 +1,84 @@
+#include <unity.h>
+#include "checkpoint.h"
+#include "tests.h"
+
+static const uint32_t JAN_1_2026 = 20454UL * 86400;
+
+static void onValves(valve_setting_t *setting)
+{
+}
+
+static void onPump(bool on)
+{
+}
+
+static void setSteps(TaskManager &taskManager)
+{
+  taskManager.setCallbacks(onValves, onPump, [] { return true; });
+  taskManager.setValveSetting(0, valve_bit(0), 600);
+  taskManager.setValveSetting(1, valve_bit(1), 600);
+}
+
+static void interrupted_cycle_resumes_where_it_stopped()
+{
+  uint32_t now = JAN_1_2026 + 20 * 3600 + 700;
+  {
+    TaskManager taskManager(20, 0);
+    setSteps(taskManager);
+    taskManager.tick(0);
+    taskManager.start();
+    taskManager.tick(0);
+    taskManager.tick(700000); // 500 s left of step 1
+    checkpoint_save(taskManager, now);
+  }
+
+  TaskManager taskManager(20, 0); // After the restart
+  setSteps(taskManager);
+  taskManager.tick(5000);
+  TEST_ASSERT_TRUE(checkpoint_restore(taskManager, now + 10));
+  TEST_ASSERT_EQUAL_INT(1, taskManager.currentStep());
+  TEST_ASSERT_EQUAL_UINT16(500, taskManager.timeLeft());
+
+  TEST_ASSERT_FALSE(checkpoint_restore(taskManager, now + 20)); // Consumed
+}
+
+static void old_cycle_is_not_resumed()
+{
+  uint32_t now = JAN_1_2026 + 20 * 3600 + 700;
+  {
+    TaskManager taskManager(20, 0);
+    setSteps(taskManager);
+    taskManager.tick(0);
+    taskManager.start();
+    checkpoint_save(taskManager, now);
+  }
+
+  TaskManager taskManager(20, 0);
+  setSteps(taskManager);
+  TEST_ASSERT_FALSE(checkpoint_restore(taskManager, now + CHECKPOINT_MAX_AGE + 1));
+  TEST_ASSERT_FALSE(taskManager.isRunning());
+}
+
+static void start_during_the_restart_is_caught_up()
+{
+  uint32_t start = JAN_1_2026 + 20 * 3600;
+  {
+    TaskManager taskManager(20, 0);
+    setSteps(taskManager);
+    checkpoint_save(taskManager, start - 30); // Idle
+  }
+
+  TaskManager taskManager(20, 0);
+  setSteps(taskManager);
+  taskManager.tick(0);
+  TEST_ASSERT_FALSE(checkpoint_restore(taskManager, start + 90));
+  taskManager.loop(start + 120, 0);
+  TEST_ASSERT_TRUE(taskManager.isRunning());
+}
+
+void test_checkpoint()
+{
+  RUN_TEST(interrupted_cycle_resumes_where_it_stopped);
+  RUN_TEST(old_cycle_is_not_resumed);
+  RUN_TEST(start_during_the_restart_is_caught_up);
+}
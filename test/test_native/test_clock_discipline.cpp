@@ -0,0 +1,87 @@
+#include <math.h>
+#include <unity.h>
+#include "ClockDiscipline.h"
+#include "tests.h"
+
+static void large_offset_is_stepped()
+{
+  ClockDiscipline discipline;
+  discipline.reset(0);
+
+  clock_correction_t correction = discipline.sample(ClockDiscipline::STEP_MS, 0);
+  TEST_ASSERT_TRUE(correction.step);
+  TEST_ASSERT_FALSE(correction.set_aging);
+
+  correction = discipline.sample(-3600000, 60); // End of DST
+  TEST_ASSERT_TRUE(correction.step);
+  TEST_ASSERT_EQUAL_INT32(-3600000, discipline.lastOffsetMs());
+
+  correction = discipline.sample(ClockDiscipline::STEP_MS - 1, 120);
+  TEST_ASSERT_FALSE(correction.step);
+}
+
+static void drift_is_measured_over_the_baseline()
+{
+  ClockDiscipline discipline;
+  discipline.reset(0);
+  discipline.sample(0, 1000);
+
+  // 5 ppm fast: 108 ms in 6 hours, but not before the baseline is long enough
+  clock_correction_t correction = discipline.sample(100, 1000 + ClockDiscipline::MIN_BASELINE_S - 1);
+  TEST_ASSERT_FALSE(correction.set_aging);
+  TEST_ASSERT_FALSE(discipline.hasEstimate());
+
+  correction = discipline.sample(108, 1000 + ClockDiscipline::MIN_BASELINE_S);
+  TEST_ASSERT_TRUE(discipline.hasEstimate());
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 5.0f, discipline.driftPpm());
+
+  // Cancels the drift plus 0.625 ppm that works the 108 ms off over the horizon
+  TEST_ASSERT_TRUE(correction.set_aging);
+  TEST_ASSERT_EQUAL_INT8(56, correction.aging);
+  TEST_ASSERT_EQUAL_INT8(56, discipline.aging());
+}
+
+static void chip_is_kept_on_time_without_steps()
+{
+  ClockDiscipline discipline;
+  discipline.reset(0);
+
+  // A DS3231 running 5 ppm fast, sampled every minute for ten days
+  const float driftPpm = 5.0f;
+  double offsetMs = 500;
+  for (uint32_t at = 0; at < 10 * 86400; at += 60)
+  {
+    clock_correction_t correction = discipline.sample((int32_t)lround(offsetMs), at);
+    TEST_ASSERT_FALSE(correction.step);
+    offsetMs += (driftPpm - discipline.aging() * ClockDiscipline::AGING_PPM) * 60 / 1000;
+  }
+
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, driftPpm, discipline.driftPpm());
+  TEST_ASSERT_INT_WITHIN(50, 0, (int32_t)lround(offsetMs));
+}
+
+static void aging_is_clamped()
+{
+  ClockDiscipline discipline;
+  discipline.reset(0);
+  discipline.sample(0, 0);
+
+  // 20 ppm fast is beyond what the aging register can take out
+  clock_correction_t correction = discipline.sample(432, ClockDiscipline::MIN_BASELINE_S);
+  TEST_ASSERT_TRUE(correction.set_aging);
+  TEST_ASSERT_EQUAL_INT8(127, correction.aging);
+
+  ClockDiscipline slow;
+  slow.reset(0);
+  slow.sample(0, 0);
+  correction = slow.sample(-432, ClockDiscipline::MIN_BASELINE_S);
+  TEST_ASSERT_EQUAL_INT8(-127, correction.aging);
+}
+
+void test_clock_discipline()
+{
+  RUN_TEST(large_offset_is_stepped);
+  RUN_TEST(drift_is_measured_over_the_baseline);
+  RUN_TEST(chip_is_kept_on_time_without_steps);
+  RUN_TEST(aging_is_clamped);
+}
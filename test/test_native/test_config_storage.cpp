@@ -0,0 +1,233 @@
+#include <unity.h>
+#include "config_storage.h"
+#include "utils.h"
+#include "tests.h"
+
+// Version 1 blob, as firmware for 12 zones on 16-bit masks wrote it
+typedef struct
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t length;
+  struct
+  {
+    uint8_t sched_hour;
+    uint8_t sched_minute;
+    uint8_t program_mask;
+    uint8_t task_count;
+    program_t programs[MAX_PROGRAMS];
+    struct
+    {
+      uint16_t valves;
+      uint16_t duration;
+    } tasks[24];
+    uint8_t zone_count;
+    uint16_t capacity;
+    zone_demand_t zones[12];
+  } config;
+  uint32_t crc;
+} blob_v1_t;
+
+static void saved_config_survives_a_restart()
+{
+  Preferences::native_erase_all();
+  {
+    ConfigStorage storage;
+    storage.load();
+    storage.saveSchedule(6, 30);
+    storage.saveTask(0, valve_bit(0) | valve_bit(40), 600);
+    storage.saveTask(1, valve_bit(2), 90);
+    TEST_ASSERT_TRUE(storage.isDirty());
+    TEST_ASSERT_TRUE(storage.flush());
+  }
+
+  ConfigStorage storage;
+  TEST_ASSERT_TRUE(storage.load());
+  uint8_t hour, minute;
+  storage.loadSchedule(hour, minute);
+  TEST_ASSERT_EQUAL_UINT8(6, hour);
+  TEST_ASSERT_EQUAL_UINT8(30, minute);
+  TEST_ASSERT_EQUAL_UINT8(2, storage.getTaskCount());
+
+  valve_mask_t valves;
+  uint16_t duration;
+  TEST_ASSERT_TRUE(storage.loadTask(0, valves, duration));
+  TEST_ASSERT_TRUE(valves == (valve_bit(0) | valve_bit(40)));
+  TEST_ASSERT_EQUAL_UINT16(600, duration);
+}
+
+static void damaged_blob_is_not_loaded()
+{
+  Preferences::native_erase_all();
+  {
+    ConfigStorage storage;
+    storage.load();
+    storage.saveSchedule(6, 30);
+    storage.flush();
+  }
+
+  Preferences prefs;
+  prefs.begin("irrigation");
+  size_t len = prefs.getBytesLength("config");
+  uint8_t blob[CONFIG_BLOB_MAX];
+  TEST_ASSERT_LESS_OR_EQUAL(sizeof(blob), len);
+  prefs.getBytes("config", blob, len);
+  blob[12] ^= 0x01; // Inside the configuration, not the header
+  prefs.putBytes("config", blob, len);
+  prefs.end();
+
+  ConfigStorage storage;
+  TEST_ASSERT_FALSE(storage.load());
+  uint8_t hour, minute;
+  storage.loadSchedule(hour, minute);
+  TEST_ASSERT_EQUAL_UINT8(20, hour); // Defaults
+}
+
+static void per_key_settings_are_migrated()
+{
+  Preferences::native_erase_all();
+  {
+    Preferences prefs;
+    prefs.begin("irrigation");
+    prefs.putUChar("sched_hour", 5);
+    prefs.putUChar("sched_min", 15);
+    prefs.putUShort("task0_valves", 0x0003);
+    prefs.putUChar("task0_dur", 10); // Minutes in the oldest layout
+    prefs.putUShort("task1_valves", 0x0004);
+    prefs.putUShort("task1_sec", 45);
+    prefs.end();
+  }
+
+  ConfigStorage storage;
+  TEST_ASSERT_TRUE(storage.load());
+  TEST_ASSERT_EQUAL_UINT8(2, storage.getTaskCount());
+  valve_mask_t valves;
+  uint16_t duration;
+  storage.loadTask(0, valves, duration);
+  TEST_ASSERT_EQUAL_UINT16(600, duration);
+  storage.loadTask(1, valves, duration);
+  TEST_ASSERT_TRUE(valves == 0x0004);
+  TEST_ASSERT_EQUAL_UINT16(45, duration);
+
+  Preferences prefs;
+  prefs.begin("irrigation", true);
+  TEST_ASSERT_FALSE(prefs.isKey("sched_hour"));
+  TEST_ASSERT_FALSE(prefs.isKey("task0_valves"));
+  TEST_ASSERT_TRUE(prefs.isKey("config"));
+  prefs.end();
+}
+
+static void blob_holds_only_the_steps_in_use()
+{
+  Preferences::native_erase_all();
+  ConfigStorage storage;
+  storage.load();
+  storage.saveTask(0, valve_bit(0), 600);
+  storage.saveTask(1, valve_bit(1), 600);
+  storage.flush();
+
+  Preferences prefs;
+  prefs.begin("irrigation", true);
+  size_t empty = CONFIG_BLOB_MAX - MAX_TASKS * CONFIG_STEP_BYTES - MAX_ZONES * sizeof(zone_demand_t);
+  TEST_ASSERT_EQUAL_UINT32(empty + 2 * CONFIG_STEP_BYTES, prefs.getBytesLength("config"));
+  prefs.end();
+}
+
+static void full_tables_survive_a_restart()
+{
+  Preferences::native_erase_all();
+  valve_setting_t steps[MAX_TASKS];
+  zone_demand_t zones[MAX_ZONES];
+  for (uint8_t i = 0; i < MAX_TASKS; i++)
+  {
+    steps[i] = {valve_bit(i) | valve_bit(MAX_ZONES - 1), (uint16_t)(60 + i)};
+  }
+  for (uint8_t z = 0; z < MAX_ZONES; z++)
+  {
+    zones[z] = {(uint16_t)(z + 1), (uint16_t)(300 + z)};
+  }
+  {
+    ConfigStorage storage;
+    storage.load();
+    storage.saveTasks(steps, MAX_TASKS);
+    storage.saveZones(zones, MAX_ZONES, 1000);
+    TEST_ASSERT_TRUE(storage.flush());
+  }
+
+  ConfigStorage storage;
+  TEST_ASSERT_TRUE(storage.load());
+  TEST_ASSERT_EQUAL_UINT8(MAX_TASKS, storage.getTaskCount());
+  valve_mask_t valves;
+  uint16_t duration;
+  TEST_ASSERT_TRUE(storage.loadTask(MAX_TASKS - 1, valves, duration));
+  TEST_ASSERT_TRUE(valves == steps[MAX_TASKS - 1].valves);
+  TEST_ASSERT_EQUAL_UINT16(60 + MAX_TASKS - 1, duration);
+
+  zone_demand_t loaded[MAX_ZONES];
+  uint8_t count;
+  uint16_t capacity;
+  TEST_ASSERT_TRUE(storage.loadZones(loaded, count, capacity));
+  TEST_ASSERT_EQUAL_UINT8(MAX_ZONES, count);
+  TEST_ASSERT_EQUAL_UINT16(1000, capacity);
+  TEST_ASSERT_EQUAL_UINT16(300 + MAX_ZONES - 1, loaded[MAX_ZONES - 1].duration);
+}
+
+static void version_1_blob_is_upgraded()
+{
+  Preferences::native_erase_all();
+  blob_v1_t old;
+  memset(&old, 0, sizeof(old));
+  old.magic = CONFIG_MAGIC;
+  old.version = 1;
+  old.length = sizeof(old.config);
+  old.config.sched_hour = 7;
+  old.config.task_count = 2;
+  old.config.tasks[0] = {0x0801, 1200};
+  old.config.tasks[1] = {0x0002, 900};
+  old.config.zone_count = 12;
+  old.config.capacity = 10;
+  old.config.zones[11] = {4, 600};
+  old.crc = crc32(&old, offsetof(blob_v1_t, crc));
+  {
+    Preferences prefs;
+    prefs.begin("irrigation");
+    prefs.putBytes("config", &old, sizeof(old));
+    prefs.end();
+  }
+
+  ConfigStorage storage;
+  TEST_ASSERT_TRUE(storage.load());
+  uint8_t hour, minute;
+  storage.loadSchedule(hour, minute);
+  TEST_ASSERT_EQUAL_UINT8(7, hour);
+  valve_mask_t valves;
+  uint16_t duration;
+  TEST_ASSERT_TRUE(storage.loadTask(0, valves, duration));
+  TEST_ASSERT_TRUE(valves == (valve_bit(0) | valve_bit(11)));
+  TEST_ASSERT_EQUAL_UINT16(1200, duration);
+
+  zone_demand_t zones[MAX_ZONES];
+  uint8_t count;
+  uint16_t capacity;
+  storage.loadZones(zones, count, capacity);
+  TEST_ASSERT_EQUAL_UINT8(12, count);
+  TEST_ASSERT_EQUAL_UINT16(600, zones[11].duration);
+
+  // Rewritten in the current layout
+  Preferences prefs;
+  prefs.begin("irrigation", true);
+  uint8_t blob[CONFIG_BLOB_MAX];
+  TEST_ASSERT_TRUE(prefs.getBytes("config", blob, sizeof(blob)) > 0);
+  prefs.end();
+  TEST_ASSERT_EQUAL_UINT16(CONFIG_VERSION, ((config_header_t*)blob)->version);
+}
+
+void test_config_storage()
+{
+  RUN_TEST(saved_config_survives_a_restart);
+  RUN_TEST(damaged_blob_is_not_loaded);
+  RUN_TEST(per_key_settings_are_migrated);
+  RUN_TEST(blob_holds_only_the_steps_in_use);
+  RUN_TEST(full_tables_survive_a_restart);
+  RUN_TEST(version_1_blob_is_upgraded);
+}
@@ -0,0 +1,58 @@
+#include <unity.h>
+#include "DeadlineQueue.h"
+#include "tests.h"
+
+static void pops_deadlines_in_time_order()
+{
+  DeadlineQueue<4> queue;
+  queue.schedule(1, 3000);
+  queue.schedule(2, 1000);
+  queue.schedule(3, 2000);
+
+  uint32_t at;
+  TEST_ASSERT_TRUE(queue.next(at));
+  TEST_ASSERT_EQUAL_UINT32(1000, at);
+  TEST_ASSERT_EQUAL_INT(-1, queue.popDue(999));
+  TEST_ASSERT_EQUAL_INT(2, queue.popDue(2500, &at));
+  TEST_ASSERT_EQUAL_UINT32(1000, at);
+  TEST_ASSERT_EQUAL_INT(3, queue.popDue(2500));
+  TEST_ASSERT_EQUAL_INT(-1, queue.popDue(2500));
+  TEST_ASSERT_EQUAL_UINT8(1, queue.size());
+}
+
+static void rescheduling_replaces_the_deadline()
+{
+  DeadlineQueue<2> queue;
+  queue.schedule(1, 1000);
+  queue.schedule(1, 500);
+  TEST_ASSERT_EQUAL_UINT8(1, queue.size());
+
+  uint32_t at;
+  TEST_ASSERT_TRUE(queue.deadline(1, at));
+  TEST_ASSERT_EQUAL_UINT32(500, at);
+
+  TEST_ASSERT_TRUE(queue.schedule(2, 700));
+  TEST_ASSERT_FALSE(queue.schedule(3, 800)); // Full
+  TEST_ASSERT_TRUE(queue.cancel(1));
+  TEST_ASSERT_FALSE(queue.pending(1));
+  TEST_ASSERT_FALSE(queue.cancel(1));
+}
+
+static void survives_the_millis_rollover()
+{
+  DeadlineQueue<4> queue;
+  queue.schedule(1, 0xFFFFFF00 + 0x200); // Wraps to 0x100
+  queue.schedule(2, 0xFFFFFF80);
+
+  TEST_ASSERT_EQUAL_INT(-1, queue.popDue(0xFFFFFF00));
+  TEST_ASSERT_EQUAL_INT(2, queue.popDue(0xFFFFFFF0));
+  TEST_ASSERT_EQUAL_INT(-1, queue.popDue(0xFFFFFFF0));
+  TEST_ASSERT_EQUAL_INT(1, queue.popDue(0x100));
+}
+
+void test_deadline_queue()
+{
+  RUN_TEST(pops_deadlines_in_time_order);
+  RUN_TEST(rescheduling_replaces_the_deadline);
+  RUN_TEST(survives_the_millis_rollover);
+}
@@ -0,0 +1,40 @@
+#include <unity.h>
+#include "diagnostics.h"
+#include "mqtt_handler.h"
+#include "tests.h"
+
+static const char *WORST_TIME = "31.12.2099 23:59:59";
+
+// Every counter at its widest; drift_ppm can reach about 106 ppm before
+// the offset is large enough to step instead
+static void device_fits_a_message()
+{
+  valves_stats_t valves = {UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX};
+  ntp_status_t clock = {false, INT32_MIN, true, -106.123456f, INT8_MIN, UINT32_MAX};
+  power_stats_t power = {false, true, 1000, UINT32_MAX, 160};
+
+  JsonDocument doc;
+  doc["time"] = WORST_TIME;
+  diagnostics_device(doc, valves, clock, power);
+  TEST_ASSERT_LESS_OR_EQUAL(MQTT_PAYLOAD_MAX, measureJson(doc));
+}
+
+static void bus_fits_a_message()
+{
+  bus_stats_t bus[BUS_DEVICES];
+  for (uint8_t i = 0; i < BUS_DEVICES; i++)
+  {
+    bus[i] = {UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX};
+  }
+
+  JsonDocument doc;
+  doc["time"] = WORST_TIME;
+  diagnostics_bus(doc, bus);
+  TEST_ASSERT_LESS_OR_EQUAL(MQTT_PAYLOAD_MAX, measureJson(doc));
+}
+
+void test_diagnostics()
+{
+  RUN_TEST(device_fits_a_message);
+  RUN_TEST(bus_fits_a_message);
+}
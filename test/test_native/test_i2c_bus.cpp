@@ -0,0 +1,178 @@
+#include <unity.h>
+#include <Arduino.h>
+#include <Wire.h>
+#include "i2c_bus.h"
+#include "tests.h"
+
+static char order[8];
+static uint8_t ran = 0;
+static uint8_t unfinished = 0; // Passes a job still asks for
+static uint16_t slices = 0;
+
+static bool valvesJob() { order[ran++] = 'v'; return true; }
+static bool otherValvesJob() { order[ran++] = 'o'; return true; }
+static bool rtcJob() { order[ran++] = 'r'; return true; }
+static bool lcdJob() { order[ran++] = 'l'; return true; }
+
+static bool slowJob()
+{
+  order[ran++] = 's';
+  return unfinished == 0 || --unfinished == 0;
+}
+
+static bool failingJob()
+{
+  bus_fail(BUS_VALVES);
+  return true;
+}
+
+// Sends a row of text a character at a time while the pass has budget
+static bool lcdRender()
+{
+  while (slices < 200 && bus_budget_left())
+  {
+    Wire.beginTransmission(0x27);
+    Wire.write((const uint8_t *)"\x0D\x09\x0D\x09", 4); // One character in 4-bit mode
+    Wire.endTransmission();
+    slices++;
+  }
+  return slices >= 200;
+}
+
+static void idle()
+{
+  static bool initialized = false;
+  if (!initialized)
+  {
+    bus_init();
+    initialized = true;
+  }
+  while (bus_pending(BUS_VALVES) || bus_pending(BUS_RTC) || bus_pending(BUS_LCD))
+  {
+    bus_loop();
+  }
+  memset(order, 0, sizeof(order));
+  ran = 0;
+  unfinished = 0;
+  slices = 0;
+}
+
+static void valves_run_before_the_lcd()
+{
+  idle();
+  bus_post(BUS_LCD, lcdJob);
+  bus_post(BUS_RTC, rtcJob);
+  bus_post(BUS_VALVES, valvesJob);
+
+  bus_loop();
+  TEST_ASSERT_EQUAL_STRING("vrl", order);
+  TEST_ASSERT_FALSE(bus_pending(BUS_LCD));
+}
+
+static void posting_again_replaces_the_pending_job()
+{
+  idle();
+  bus_post(BUS_VALVES, valvesJob);
+  bus_post(BUS_VALVES, otherValvesJob);
+
+  bus_loop();
+  TEST_ASSERT_EQUAL_STRING("o", order);
+  TEST_ASSERT_FALSE(bus_post(BUS_DEVICES, valvesJob));
+  TEST_ASSERT_FALSE(bus_post(BUS_VALVES, nullptr));
+}
+
+static void unfinished_job_runs_again_on_the_next_pass()
+{
+  idle();
+  unfinished = 3;
+  bus_post(BUS_VALVES, slowJob);
+
+  bus_loop();
+  TEST_ASSERT_TRUE(bus_pending(BUS_VALVES));
+  bus_loop();
+  bus_loop();
+  TEST_ASSERT_EQUAL_STRING("sss", order);
+  TEST_ASSERT_FALSE(bus_pending(BUS_VALVES));
+
+  // A newer post made meanwhile wins over the retry
+  unfinished = 2;
+  bus_post(BUS_VALVES, slowJob);
+  bus_loop();
+  bus_post(BUS_VALVES, valvesJob);
+  bus_loop();
+  bus_loop();
+  TEST_ASSERT_EQUAL_STRING("ssssv", order);
+  TEST_ASSERT_FALSE(bus_pending(BUS_VALVES));
+}
+
+static void sliced_render_stops_at_the_budget()
+{
+  idle();
+  bus_post(BUS_LCD, lcdRender);
+
+  uint32_t started = micros();
+  bus_loop();
+  uint32_t took = micros() - started;
+  uint16_t first = slices;
+  TEST_ASSERT_TRUE(first > 0 && first < 200);
+  TEST_ASSERT_TRUE(took >= BUS_BUDGET_US);
+  TEST_ASSERT_TRUE(took < BUS_BUDGET_US + 500); // At most one character over
+
+  // A valve change posted now runs first on the next pass
+  bus_post(BUS_VALVES, valvesJob);
+  bus_loop();
+  TEST_ASSERT_EQUAL_STRING("v", order);
+  TEST_ASSERT_TRUE(slices > first);
+
+  while (bus_pending(BUS_LCD))
+  {
+    bus_loop();
+  }
+  TEST_ASSERT_EQUAL_UINT16(200, slices);
+}
+
+static void spent_budget_leaves_lower_priorities_for_the_next_pass()
+{
+  idle();
+  bus_post(BUS_LCD, lcdJob);
+  bus_post(BUS_VALVES, lcdRender); // Any job that uses the whole budget
+
+  bus_loop();
+  TEST_ASSERT_EQUAL_STRING("", order);
+  TEST_ASSERT_TRUE(bus_pending(BUS_LCD));
+  idle();
+}
+
+static void wait_and_errors_are_recorded()
+{
+  idle();
+  bus_stats_t before = bus_stats(BUS_VALVES);
+
+  bus_post(BUS_VALVES, failingJob);
+  delayMicroseconds(50000); // Longer than any wait above
+  bus_post(BUS_VALVES, failingJob); // Replacing it keeps the first post time
+  bus_loop();
+
+  bus_stats_t after = bus_stats(BUS_VALVES);
+  TEST_ASSERT_EQUAL_UINT32(before.errors + 1, after.errors);
+  TEST_ASSERT_EQUAL_UINT32(before.transactions + 1, after.transactions);
+  TEST_ASSERT_EQUAL_UINT32(50000, after.wait_max_us);
+
+  // Continuations are not waits
+  unfinished = 2;
+  bus_post(BUS_VALVES, slowJob);
+  bus_loop();
+  delayMicroseconds(60000);
+  bus_loop();
+  TEST_ASSERT_EQUAL_UINT32(50000, bus_stats(BUS_VALVES).wait_max_us);
+}
+
+void test_i2c_bus()
+{
+  RUN_TEST(valves_run_before_the_lcd);
+  RUN_TEST(posting_again_replaces_the_pending_job);
+  RUN_TEST(unfinished_job_runs_again_on_the_next_pass);
+  RUN_TEST(sliced_render_stops_at_the_budget);
+  RUN_TEST(spent_budget_leaves_lower_priorities_for_the_next_pass);
+  RUN_TEST(wait_and_errors_are_recorded);
+}
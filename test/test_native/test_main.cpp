@@ -0,0 +1,26 @@
+#include <unity.h>
+#include "tests.h"
+
+void setUp() {}
+void tearDown() {}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  test_native_hal();
+  test_program_scheduler();
+  test_deadline_queue();
+  test_task_manager();
+  test_zone_planner();
+  test_arena_allocator();
+  test_manual_runs();
+  test_config_storage();
+  test_checkpoint();
+  test_clock_discipline();
+  test_diagnostics();
+  test_mqtt_queue();
+  test_mqtt_commands();
+  test_valves();
+  test_i2c_bus();
+  return UNITY_END();
+}
@@ -0,0 +1,87 @@
+#include <unity.h>
+#include "ManualRuns.h"
+#include "tests.h"
+
+static valve_mask_t valves;
+static void onValves(valve_setting_t *setting)
+{
+  valves = setting->valves;
+}
+
+static void onPump(bool on)
+{
+}
+
+static void requests_beyond_the_limit_wait_by_priority()
+{
+  TaskManager taskManager(20, 0);
+  ManualRuns manualRuns(taskManager);
+  manualRuns.setCallback(onValves);
+  manualRuns.setMaxOpen(2);
+  manualRuns.tick(0);
+
+  TEST_ASSERT_TRUE(manualRuns.request(valve_bit(0) | valve_bit(1), 60));
+  TEST_ASSERT_TRUE(manualRuns.request(valve_bit(2), 60));
+  TEST_ASSERT_TRUE(manualRuns.request(valve_bit(3), 30, 1)); // Overtakes zone 2
+  TEST_ASSERT_TRUE(valves == (valve_bit(0) | valve_bit(1)));
+  TEST_ASSERT_EQUAL_UINT8(2, manualRuns.queued());
+
+  manualRuns.tick(60000);
+  TEST_ASSERT_TRUE(manualRuns.openValves() == (valve_bit(3) | valve_bit(2)));
+  TEST_ASSERT_EQUAL_UINT16(30, manualRuns.timeLeft(3));
+  TEST_ASSERT_EQUAL_UINT16(60, manualRuns.timeLeft(2));
+
+  manualRuns.tick(120000);
+  TEST_ASSERT_FALSE(manualRuns.isActive());
+  TEST_ASSERT_TRUE(valves == 0);
+}
+
+static void open_zones_are_extended_or_closed()
+{
+  TaskManager taskManager(20, 0);
+  ManualRuns manualRuns(taskManager);
+  manualRuns.setCallback(onValves);
+  manualRuns.tick(0);
+
+  manualRuns.request(valve_bit(4), 60);
+  manualRuns.tick(30000);
+  manualRuns.request(valve_bit(4), 120); // From now, not from the first request
+  TEST_ASSERT_EQUAL_UINT16(120, manualRuns.timeLeft(4));
+
+  manualRuns.request(valve_bit(4), 0);
+  TEST_ASSERT_FALSE(manualRuns.isActive());
+  TEST_ASSERT_EQUAL_UINT16(0, manualRuns.timeLeft(4));
+}
+
+static void program_is_paused_and_carries_on()
+{
+  TaskManager taskManager(20, 0);
+  ManualRuns manualRuns(taskManager);
+  taskManager.setCallbacks(onValves, onPump, [] { return true; });
+  manualRuns.setCallback(onValves);
+  taskManager.setValveSetting(0, valve_bit(0), 600);
+
+  taskManager.tick(0);
+  manualRuns.tick(0);
+  taskManager.start();
+  taskManager.tick(100000);
+  manualRuns.tick(100000);
+
+  manualRuns.request(valve_bit(5), 60);
+  TEST_ASSERT_TRUE(taskManager.isPaused());
+  TEST_ASSERT_TRUE(valves == valve_bit(5));
+  TEST_ASSERT_EQUAL_UINT16(500, taskManager.timeLeft());
+
+  taskManager.tick(160000);
+  manualRuns.tick(160000);
+  TEST_ASSERT_FALSE(taskManager.isPaused());
+  TEST_ASSERT_TRUE(valves == valve_bit(0));
+  TEST_ASSERT_EQUAL_UINT16(500, taskManager.timeLeft()); // The step time was frozen
+}
+
+void test_manual_runs()
+{
+  RUN_TEST(requests_beyond_the_limit_wait_by_priority);
+  RUN_TEST(open_zones_are_extended_or_closed);
+  RUN_TEST(program_is_paused_and_carries_on);
+}
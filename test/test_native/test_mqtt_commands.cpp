@@ -0,0 +1,209 @@
+#include <unity.h>
+#include <WiFi.h>
+#include "mqtt_commands.h"
+#include "mqtt_handler.h"
+#include "Preferences.h"
+#include "tests.h"
+
+extern PubSubClient _mqttClient;
+
+static char willTopic[] = "irrigation/test/LWT";
+static char responseTopic[] = "irrigation/test/state";
+
+static void online()
+{
+  static bool initialized = false;
+  if (!initialized)
+  {
+    WiFi.begin("test");
+    mqtt_init("test", "127.0.0.1", 1883, "", "", willTopic);
+    initialized = true;
+  }
+  mqtt_connect();
+  mqtt_flush();
+  _mqttClient.native_published.clear();
+}
+
+// Success and message of the response to the last command
+static bool response(const char *&message)
+{
+  static JsonDocument doc;
+  mqtt_flush();
+  TEST_ASSERT_FALSE(_mqttClient.native_published.empty());
+  deserializeJson(doc, _mqttClient.native_published.back().payload.c_str());
+  _mqttClient.native_published.clear();
+  message = doc["message"] | "";
+  return doc["success"] | false;
+}
+
+static void send(command_context_t &context, const char *payload)
+{
+  dispatchCommand((const byte *)payload, strlen(payload), context);
+}
+
+static void valve_control_rejects_a_bad_duration()
+{
+  online();
+  TaskManager taskManager(20, 0);
+  ManualRuns manualRuns(taskManager);
+  ConfigStorage configStorage;
+  command_context_t context = {taskManager, manualRuns, configStorage, responseTopic};
+  manualRuns.tick(0);
+  const char *message;
+
+  send(context, "{\"cmd\":\"valve_control\",\"params\":{\"valves\":1,\"duration\":10}}");
+  TEST_ASSERT_TRUE(response(message));
+  TEST_ASSERT_TRUE(manualRuns.openValves() == valve_bit(0));
+
+  // None of these may be read as 0, which closes the zone
+  const char *bad[] = {
+    "{\"cmd\":\"valve_control\",\"params\":{\"valves\":1,\"duration\":70000}}",
+    "{\"cmd\":\"valve_control\",\"params\":{\"valves\":1,\"duration\":-5}}",
+    "{\"cmd\":\"valve_control\",\"params\":{\"valves\":1,\"duration\":\"5\"}}",
+    "{\"cmd\":\"valve_control\",\"params\":{\"valves\":1,\"duration\":1001}}",
+    "{\"cmd\":\"valve_control\",\"params\":{\"valves\":1,\"duration\":5,\"priority\":-1}}",
+  };
+  for (const char *payload : bad)
+  {
+    send(context, payload);
+    TEST_ASSERT_FALSE(response(message));
+    TEST_ASSERT_EQUAL_STRING("Valve control failed", message);
+    TEST_ASSERT_TRUE(manualRuns.openValves() == valve_bit(0));
+  }
+
+  send(context, "{\"cmd\":\"valve_control\",\"params\":{\"valves\":1,\"duration\":0}}");
+  TEST_ASSERT_TRUE(response(message));
+  TEST_ASSERT_FALSE(manualRuns.isActive());
+}
+
+static void configure(command_context_t &context, const char *payload)
+{
+  dispatchConfig((const byte *)payload, strlen(payload), context);
+}
+
+// Stored and loaded: daily at 20:00, two steps
+static void stored(ConfigStorage &configStorage, TaskManager &taskManager)
+{
+  Preferences::native_erase_all();
+  configStorage.load();
+  configStorage.saveSchedule(20, 0);
+  configStorage.saveTask(0, valve_bit(0), 600);
+  configStorage.saveTask(1, valve_bit(1), 300);
+  configStorage.flush();
+  configStorage.loadToTaskManager(taskManager);
+  Preferences::native_reset_stats();
+}
+
+static void invalid_conf_changes_nothing()
+{
+  online();
+  TaskManager taskManager(20, 0);
+  ManualRuns manualRuns(taskManager);
+  ConfigStorage configStorage;
+  command_context_t context = {taskManager, manualRuns, configStorage, responseTopic};
+  stored(configStorage, taskManager);
+  const char *message;
+
+  // Valid start and program, then a bad step
+  configure(context, "{\"start\":\"06:30\",\"programs\":[{\"idx\":1,\"starts\":[\"07:00\"]}],"
+                     "\"steps\":[{\"valves\":4,\"duration\":60},{\"valves\":8,\"duration\":70000}]}");
+  TEST_ASSERT_FALSE(response(message));
+  TEST_ASSERT_EQUAL_STRING("Invalid step", message);
+
+  configure(context, "{\"steps\":[]}");
+  TEST_ASSERT_FALSE(response(message));
+  TEST_ASSERT_EQUAL_STRING("No steps", message);
+
+  TEST_ASSERT_EQUAL_UINT16(20 * 60, taskManager.scheduler().program(0)->starts[0]);
+  TEST_ASSERT_EQUAL_UINT8(0, taskManager.scheduler().program(1)->start_count);
+  TEST_ASSERT_EQUAL_UINT8(2, taskManager.valveSettingCount());
+  TEST_ASSERT_TRUE(taskManager.valveSetting(0)->valves == valve_bit(0));
+
+  uint8_t hour, minute;
+  program_t program;
+  configStorage.loadSchedule(hour, minute);
+  TEST_ASSERT_EQUAL_UINT8(20, hour);
+  TEST_ASSERT_FALSE(configStorage.loadProgram(1, program));
+  TEST_ASSERT_EQUAL_UINT8(2, configStorage.getTaskCount());
+  TEST_ASSERT_FALSE(configStorage.isDirty());
+  TEST_ASSERT_EQUAL_UINT32(0, Preferences::native_stats().writes);
+}
+
+static void conf_is_saved_with_one_write()
+{
+  online();
+  TaskManager taskManager(20, 0);
+  ManualRuns manualRuns(taskManager);
+  ConfigStorage configStorage;
+  command_context_t context = {taskManager, manualRuns, configStorage, responseTopic};
+  stored(configStorage, taskManager);
+  const char *message;
+
+  configure(context, "{\"start\":\"06:30\",\"programs\":[{\"idx\":1,\"starts\":[\"07:00\"]}],"
+                     "\"steps\":[{\"valves\":4,\"duration\":60}],\"step\":[{\"idx\":1,\"valves\":8,\"duration\":90}]}");
+  TEST_ASSERT_TRUE(response(message));
+  TEST_ASSERT_EQUAL_STRING("Configuration applied", message);
+  TEST_ASSERT_EQUAL_UINT32(1, Preferences::native_stats().writes);
+  TEST_ASSERT_FALSE(configStorage.isDirty());
+
+  TEST_ASSERT_EQUAL_UINT16(6 * 60 + 30, taskManager.scheduler().program(0)->starts[0]);
+  TEST_ASSERT_EQUAL_UINT16(7 * 60, taskManager.scheduler().program(1)->starts[0]);
+  TEST_ASSERT_EQUAL_UINT8(2, taskManager.valveSettingCount());
+  TEST_ASSERT_EQUAL_UINT16(90, taskManager.valveSetting(1)->duration);
+
+  ConfigStorage restarted;
+  TEST_ASSERT_TRUE(restarted.load());
+  TEST_ASSERT_EQUAL_UINT8(2, restarted.getTaskCount());
+}
+
+static void running_cycle_keeps_its_steps()
+{
+  online();
+  TaskManager taskManager(20, 0);
+  ManualRuns manualRuns(taskManager);
+  ConfigStorage configStorage;
+  command_context_t context = {taskManager, manualRuns, configStorage, responseTopic};
+  stored(configStorage, taskManager);
+  const char *message;
+
+  taskManager.tick(0);
+  taskManager.start();
+  configure(context, "{\"steps\":[{\"valves\":4,\"duration\":60}]}");
+  TEST_ASSERT_TRUE(response(message));
+  TEST_ASSERT_EQUAL_STRING("Applied, steps switch after the running cycle", message);
+  TEST_ASSERT_EQUAL_UINT8(2, taskManager.valveSettingCount());
+  TEST_ASSERT_TRUE(taskManager.actualValveSetting()->valves == valve_bit(0));
+
+  taskManager.tick(600000);
+  TEST_ASSERT_EQUAL_INT(1, taskManager.currentStep()); // Still the old table
+  TEST_ASSERT_TRUE(taskManager.actualValveSetting()->valves == valve_bit(1));
+
+  taskManager.stop();
+  TEST_ASSERT_EQUAL_UINT8(1, taskManager.valveSettingCount());
+  TEST_ASSERT_TRUE(taskManager.valveSetting(0)->valves == valve_bit(2));
+}
+
+static void config_without_steps_is_still_loaded()
+{
+  Preferences::native_erase_all();
+  {
+    ConfigStorage configStorage;
+    TEST_ASSERT_FALSE(configStorage.load()); // Nothing stored: the defaults apply
+    configStorage.saveSchedule(5, 0);
+    configStorage.saveTasks(nullptr, 0);
+    configStorage.flush();
+  }
+
+  ConfigStorage configStorage;
+  TEST_ASSERT_TRUE(configStorage.load());
+  TEST_ASSERT_EQUAL_UINT8(0, configStorage.getTaskCount());
+}
+
+void test_mqtt_commands()
+{
+  RUN_TEST(valve_control_rejects_a_bad_duration);
+  RUN_TEST(invalid_conf_changes_nothing);
+  RUN_TEST(conf_is_saved_with_one_write);
+  RUN_TEST(running_cycle_keeps_its_steps);
+  RUN_TEST(config_without_steps_is_still_loaded);
+}
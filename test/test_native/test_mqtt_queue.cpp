@@ -0,0 +1,152 @@
+#include <unity.h>
+#include <WiFi.h>
+#include "mqtt_handler.h"
+#include "tests.h"
+
+extern PubSubClient _mqttClient;
+
+static char willTopic[] = "irrigation/test/LWT";
+static char stateTopic[] = "irrigation/test/state";
+static char tasksTopic[] = "irrigation/test/tasks";
+static char eventsTopic[] = "irrigation/test/events";
+
+// Offline with an empty queue and nothing recorded
+static void offline()
+{
+  static bool initialized = false;
+  if (!initialized)
+  {
+    WiFi.begin("test");
+    mqtt_init("test", "127.0.0.1", 1883, "", "", willTopic);
+    initialized = true;
+  }
+
+  mqtt_connect();
+  mqtt_flush();
+  _mqttClient.native_drop_connection();
+  _mqttClient.native_on_publish = nullptr;
+  _mqttClient.native_published.clear();
+  TEST_ASSERT_EQUAL_UINT8(0, mqtt_queue_size());
+}
+
+static void sendAll()
+{
+  mqtt_connect();
+  _mqttClient.native_published.clear(); // The online message
+  mqtt_flush();
+}
+
+static void assertPublished(size_t idx, const char *topic, const char *payload)
+{
+  TEST_ASSERT_TRUE(idx < _mqttClient.native_published.size());
+  TEST_ASSERT_EQUAL_STRING(topic, _mqttClient.native_published[idx].topic.c_str());
+  TEST_ASSERT_EQUAL_STRING(payload, _mqttClient.native_published[idx].payload.c_str());
+}
+
+static void status_replaces_the_queued_one()
+{
+  offline();
+  mqtt_publish(stateTopic, "1");
+  mqtt_publish(tasksTopic, "a");
+  mqtt_publish(stateTopic, "2");
+  TEST_ASSERT_EQUAL_UINT8(2, mqtt_queue_size());
+
+  sendAll();
+  TEST_ASSERT_EQUAL(2, _mqttClient.native_published.size());
+  assertPublished(0, stateTopic, "2"); // In the place of the first
+  assertPublished(1, tasksTopic, "a");
+  TEST_ASSERT_TRUE(_mqttClient.native_published[0].retained);
+}
+
+static void events_keep_their_order()
+{
+  offline();
+  mqtt_publish(eventsTopic, "1", MQTT_EVENT);
+  mqtt_publish(stateTopic, "s");
+  mqtt_publish(eventsTopic, "2", MQTT_EVENT);
+  TEST_ASSERT_EQUAL_UINT8(3, mqtt_queue_size());
+
+  sendAll();
+  TEST_ASSERT_EQUAL(3, _mqttClient.native_published.size());
+  assertPublished(0, eventsTopic, "1");
+  assertPublished(1, stateTopic, "s");
+  assertPublished(2, eventsTopic, "2");
+  TEST_ASSERT_FALSE(_mqttClient.native_published[0].retained);
+}
+
+static void full_queue_drops_statuses_first()
+{
+  offline();
+  char payload[4];
+  mqtt_publish(stateTopic, "s");
+  for (uint8_t i = 0; i < MQTT_QUEUE_SLOTS - 1; i++)
+  {
+    snprintf(payload, sizeof(payload), "%u", i);
+    mqtt_publish(eventsTopic, payload, MQTT_EVENT);
+  }
+  TEST_ASSERT_EQUAL_UINT8(MQTT_QUEUE_SLOTS, mqtt_queue_size());
+
+  mqtt_publish(eventsTopic, "a", MQTT_EVENT); // Drops the status
+  mqtt_publish(eventsTopic, "b", MQTT_EVENT); // Then the oldest event
+  TEST_ASSERT_EQUAL_UINT8(MQTT_QUEUE_SLOTS, mqtt_queue_size());
+
+  sendAll();
+  TEST_ASSERT_EQUAL(MQTT_QUEUE_SLOTS, _mqttClient.native_published.size());
+  assertPublished(0, eventsTopic, "1");
+  assertPublished(MQTT_QUEUE_SLOTS - 2, eventsTopic, "a");
+  assertPublished(MQTT_QUEUE_SLOTS - 1, eventsTopic, "b");
+}
+
+static void status_queued_while_sending_is_kept()
+{
+  offline();
+  mqtt_publish(stateTopic, "1");
+  _mqttClient.native_on_publish = [](const char *topic)
+  {
+    if (strcmp(topic, stateTopic) == 0)
+    {
+      _mqttClient.native_on_publish = nullptr;
+      mqtt_publish(stateTopic, "2"); // Must not replace the one on its way out
+    }
+  };
+
+  sendAll();
+  TEST_ASSERT_EQUAL(2, _mqttClient.native_published.size());
+  assertPublished(0, stateTopic, "1");
+  assertPublished(1, stateTopic, "2");
+  TEST_ASSERT_EQUAL_UINT8(0, mqtt_queue_size());
+}
+
+static void slot_reused_while_sending_is_kept()
+{
+  offline();
+  mqtt_publish(stateTopic, "s");
+  _mqttClient.native_on_publish = [](const char *topic)
+  {
+    if (strcmp(topic, stateTopic) != 0)
+    {
+      return;
+    }
+    _mqttClient.native_on_publish = nullptr;
+    char payload[4];
+    for (uint8_t i = 0; i < MQTT_QUEUE_SLOTS; i++)
+    {
+      snprintf(payload, sizeof(payload), "%u", i);
+      mqtt_publish(eventsTopic, payload, MQTT_EVENT); // The last one drops the status and takes its slot
+    }
+  };
+
+  sendAll();
+  TEST_ASSERT_EQUAL(MQTT_QUEUE_SLOTS + 1, _mqttClient.native_published.size());
+  assertPublished(0, stateTopic, "s");
+  assertPublished(MQTT_QUEUE_SLOTS, eventsTopic, "11");
+}
+
+void test_mqtt_queue()
+{
+  RUN_TEST(status_replaces_the_queued_one);
+  RUN_TEST(events_keep_their_order);
+  RUN_TEST(full_queue_drops_statuses_first);
+  RUN_TEST(status_queued_while_sending_is_kept);
+  RUN_TEST(slot_reused_while_sending_is_kept);
+}
@@ -0,0 +1,53 @@
+#include <unity.h>
+#include <Arduino.h>
+#include <Preferences.h>
+#include <PCF8574.h>
+#include "NativeHal.h"
+#include "tests.h"
+
+static void virtual_clock_moves_only_when_advanced()
+{
+  native_set_millis(1000);
+  TEST_ASSERT_EQUAL_UINT32(1000, millis());
+  TEST_ASSERT_EQUAL_UINT32(1000, millis());
+
+  delay(250);
+  TEST_ASSERT_EQUAL_UINT32(1250, millis());
+  delayMicroseconds(500);
+  TEST_ASSERT_EQUAL_UINT32(1250500, micros());
+}
+
+static void preferences_persist_across_instances()
+{
+  Preferences::native_erase_all();
+  {
+    Preferences prefs;
+    prefs.begin("test");
+    prefs.putUInt("value", 42);
+    prefs.end();
+  }
+
+  Preferences prefs;
+  prefs.begin("test", true);
+  TEST_ASSERT_EQUAL_UINT32(42, prefs.getUInt("value"));
+  TEST_ASSERT_EQUAL_UINT32(7, prefs.getUInt("missing", 7));
+  prefs.end();
+}
+
+static void expander_reads_back_what_was_written()
+{
+  PCF8574 expander(0x38, &Wire);
+  TEST_ASSERT_TRUE(expander.begin());
+  expander.write8(0x5A);
+  TEST_ASSERT_EQUAL_UINT8(0x5A, expander.read8());
+
+  expander.native_stuck_low = 0x02; // A shorted output reads low
+  TEST_ASSERT_EQUAL_UINT8(0x58, expander.read8());
+}
+
+void test_native_hal()
+{
+  RUN_TEST(virtual_clock_moves_only_when_advanced);
+  RUN_TEST(preferences_persist_across_instances);
+  RUN_TEST(expander_reads_back_what_was_written);
+}
@@ -0,0 +1,135 @@
+#include <unity.h>
+#include "ProgramScheduler.h"
+#include "tests.h"
+
+static const uint32_t JAN_1_2026 = 20454UL * 86400; // A Thursday
+
+static program_t daily(uint16_t start)
+{
+  program_t program = {};
+  program.starts[0] = start;
+  program.start_count = 1;
+  program.weekdays = WEEKDAYS_ALL;
+  program.enabled = 1;
+  return program;
+}
+
+static uint32_t missedAt;
+static void onMissed(uint8_t program, uint32_t at)
+{
+  missedAt = at;
+}
+
+static void fires_once_when_the_start_is_crossed()
+{
+  ProgramScheduler scheduler;
+  scheduler.setProgram(0, daily(20 * 60));
+  uint32_t start = JAN_1_2026 + 20 * 3600;
+
+  TEST_ASSERT_FALSE(scheduler.due(start - 60, 0));
+  TEST_ASSERT_TRUE(scheduler.due(start, 60000));
+  TEST_ASSERT_FALSE(scheduler.due(start + 60, 120000));
+  TEST_ASSERT_EQUAL_UINT32(start + 86400, scheduler.nextRun());
+}
+
+static void next_run_follows_a_changed_program()
+{
+  ProgramScheduler scheduler;
+  scheduler.setProgram(0, daily(20 * 60));
+  scheduler.due(JAN_1_2026, 0);
+  TEST_ASSERT_EQUAL_UINT32(JAN_1_2026 + 20 * 3600, scheduler.nextRun());
+
+  // No due() in between: the index is rebuilt on demand
+  scheduler.setProgram(0, daily(6 * 60));
+  TEST_ASSERT_EQUAL_UINT32(JAN_1_2026 + 6 * 3600, scheduler.nextRun());
+
+  scheduler.setProgram(1, daily(5 * 60));
+  uint32_t runs[3];
+  TEST_ASSERT_EQUAL_UINT8(3, scheduler.nextRuns(runs, 3));
+  TEST_ASSERT_EQUAL_UINT32(JAN_1_2026 + 5 * 3600, runs[0]);
+  TEST_ASSERT_EQUAL_UINT32(JAN_1_2026 + 6 * 3600, runs[1]);
+  TEST_ASSERT_EQUAL_UINT32(JAN_1_2026 + 86400 + 5 * 3600, runs[2]);
+}
+
+static void clock_stepped_back_does_not_repeat_a_start()
+{
+  ProgramScheduler scheduler;
+  scheduler.setProgram(0, daily(20 * 60));
+  uint32_t start = JAN_1_2026 + 20 * 3600;
+
+  TEST_ASSERT_TRUE(scheduler.due(start, 0));
+  TEST_ASSERT_FALSE(scheduler.due(start + 60 - 3600, 60000)); // End of DST
+  TEST_ASSERT_FALSE(scheduler.due(start + 120 - 3600 + 3600, 3720000));
+}
+
+static void late_starts_catch_up_within_the_window()
+{
+  ProgramScheduler scheduler;
+  scheduler.setMissedCallback(onMissed);
+  scheduler.setProgram(0, daily(20 * 60));
+  uint32_t start = JAN_1_2026 + 20 * 3600;
+  missedAt = 0;
+
+  scheduler.resumeFrom(start - 1);
+  TEST_ASSERT_TRUE(scheduler.due(start + 600, 0));
+  TEST_ASSERT_EQUAL_UINT32(0, missedAt);
+
+  scheduler.resumeFrom(start + 86400 - 1);
+  TEST_ASSERT_FALSE(scheduler.due(start + 86400 + DEFAULT_CATCH_UP_S + 60, 0));
+  TEST_ASSERT_EQUAL_UINT32(start + 86400, missedAt);
+}
+
+static void day_filters_and_seasons_pick_the_days()
+{
+  program_t program = daily(20 * 60);
+  program.day_filter = DAYS_EVEN;
+  TEST_ASSERT_EQUAL_UINT32(JAN_1_2026 + 86400 + 20 * 3600, ProgramScheduler::nextFire(program, JAN_1_2026));
+
+  program = daily(20 * 60);
+  program.weekdays = 1 << 1; // Monday, Jan 5th
+  TEST_ASSERT_EQUAL_UINT32(JAN_1_2026 + 4 * 86400 + 20 * 3600, ProgramScheduler::nextFire(program, JAN_1_2026));
+
+  program = daily(20 * 60);
+  program.season_from = 1101;
+  program.season_to = 105; // Wraps over New Year
+  TEST_ASSERT_EQUAL_UINT32(JAN_1_2026 + 20 * 3600, ProgramScheduler::nextFire(program, JAN_1_2026));
+  TEST_ASSERT_EQUAL_UINT32(JAN_1_2026 + 304 * 86400 + 20 * 3600, ProgramScheduler::nextFire(program, JAN_1_2026 + 5 * 86400));
+}
+
+static void invalid_programs_are_rejected()
+{
+  ProgramScheduler scheduler;
+  program_t program = daily(20 * 60);
+  TEST_ASSERT_TRUE(ProgramScheduler::isValid(program));
+
+  program.weekdays = 0x80;
+  TEST_ASSERT_FALSE(ProgramScheduler::isValid(program));
+
+  program = daily(20 * 60);
+  program.day_filter = DAYS_EVEN + 1;
+  TEST_ASSERT_FALSE(ProgramScheduler::isValid(program));
+
+  program = daily(20 * 60);
+  program.season_from = 401;
+  TEST_ASSERT_FALSE(ProgramScheduler::isValid(program)); // No end
+  program.season_to = 1332;
+  TEST_ASSERT_FALSE(ProgramScheduler::isValid(program));
+  program.season_to = 930;
+  TEST_ASSERT_TRUE(ProgramScheduler::isValid(program));
+
+  program = daily(20 * 60);
+  program.starts[1] = 19 * 60;
+  program.start_count = 2;
+  TEST_ASSERT_FALSE(scheduler.setProgram(0, program)); // Not ascending
+  TEST_ASSERT_FALSE(scheduler.setProgram(MAX_PROGRAMS, daily(20 * 60)));
+}
+
+void test_program_scheduler()
+{
+  RUN_TEST(fires_once_when_the_start_is_crossed);
+  RUN_TEST(next_run_follows_a_changed_program);
+  RUN_TEST(clock_stepped_back_does_not_repeat_a_start);
+  RUN_TEST(late_starts_catch_up_within_the_window);
+  RUN_TEST(day_filters_and_seasons_pick_the_days);
+  RUN_TEST(invalid_programs_are_rejected);
+}
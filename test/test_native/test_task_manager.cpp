@@ -0,0 +1,134 @@
+#include <unity.h>
+#include "TaskManager.h"
+#include "tests.h"
+
+static const uint32_t JAN_1_2026 = 20454UL * 86400;
+
+static valve_mask_t opened;
+static void onValves(valve_setting_t *setting)
+{
+  opened = setting->valves;
+}
+
+static bool pumpOn;
+static void onPump(bool on)
+{
+  pumpOn = on;
+}
+
+static valve_mask_t confirmed;
+static valve_mask_t valvesOpen()
+{
+  return confirmed;
+}
+
+static void scheduled_start_runs_the_full_first_step()
+{
+  TaskManager taskManager(20, 0);
+  taskManager.setCallbacks(onValves, onPump, [] { return true; });
+  taskManager.setValveSetting(0, valve_bit(0), 1200);
+  taskManager.setValveSetting(1, valve_bit(1), 600);
+
+  // Idle for an hour since the last tick, as when the control task sleeps
+  uint32_t start = JAN_1_2026 + 20 * 3600;
+  taskManager.tick(1000);
+  taskManager.loop(start - 60, 1000);
+  taskManager.loop(start, 3601000);
+  taskManager.tick(3601000);
+  TEST_ASSERT_EQUAL_INT(0, taskManager.currentStep());
+  TEST_ASSERT_EQUAL_UINT16(1200, taskManager.timeLeft());
+
+  taskManager.tick(3601000 + 1199999);
+  TEST_ASSERT_EQUAL_INT(0, taskManager.currentStep());
+  taskManager.tick(3601000 + 1200000);
+  TEST_ASSERT_EQUAL_INT(1, taskManager.currentStep());
+  TEST_ASSERT_EQUAL_UINT16(600, taskManager.timeLeft());
+}
+
+static void steps_chain_from_their_deadline()
+{
+  TaskManager taskManager(20, 0);
+  taskManager.setCallbacks(onValves, onPump, [] { return true; });
+  taskManager.setValveSetting(0, valve_bit(0), 60);
+  taskManager.setValveSetting(1, valve_bit(1), 60);
+
+  taskManager.tick(0);
+  taskManager.start();
+  taskManager.tick(0);
+  taskManager.tick(60500); // Noticed half a second late
+  TEST_ASSERT_EQUAL_INT(1, taskManager.currentStep());
+  taskManager.tick(120000); // Yet the second step ends on time
+  TEST_ASSERT_FALSE(taskManager.isRunning());
+}
+
+static void pump_waits_for_the_first_zone()
+{
+  TaskManager taskManager(20, 0);
+  taskManager.setCallbacks(onValves, onPump, [] { return true; }, valvesOpen);
+  taskManager.setValveSetting(0, valve_bit(0), 60);
+  opened = 0;
+  confirmed = 0;
+  pumpOn = false;
+
+  taskManager.tick(0);
+  taskManager.start();
+  TEST_ASSERT_TRUE(opened == valve_bit(0));
+  TEST_ASSERT_FALSE(pumpOn);
+
+  // The write did not take: the pump stays off however long it fails
+  taskManager.tick(5000);
+  TEST_ASSERT_FALSE(pumpOn);
+
+  confirmed = valve_bit(0);
+  taskManager.tick(5100);
+  TEST_ASSERT_TRUE(pumpOn);
+  TEST_ASSERT_TRUE(taskManager.isPumpOn());
+}
+
+static void zones_overlap_on_a_step_change()
+{
+  TaskManager taskManager(20, 0);
+  taskManager.setCallbacks(onValves, onPump, [] { return true; });
+  taskManager.setValveSetting(0, valve_bit(0), 60);
+  taskManager.setValveSetting(1, valve_bit(1), 60);
+
+  taskManager.tick(0);
+  taskManager.start();
+  taskManager.tick(0);
+  taskManager.tick(60000);
+  TEST_ASSERT_TRUE(opened == (valve_bit(0) | valve_bit(1))); // Make before break
+  taskManager.tick(61999);
+  TEST_ASSERT_TRUE(opened == (valve_bit(0) | valve_bit(1)));
+  taskManager.tick(62000);
+  TEST_ASSERT_TRUE(opened == valve_bit(1));
+}
+
+static void valves_close_after_the_pump_ran_down()
+{
+  TaskManager taskManager(20, 0);
+  taskManager.setCallbacks(onValves, onPump, [] { return true; });
+  taskManager.setValveSetting(0, valve_bit(0), 60);
+
+  taskManager.tick(0);
+  taskManager.start();
+  taskManager.tick(0);
+  TEST_ASSERT_TRUE(pumpOn);
+
+  taskManager.tick(60000);
+  TEST_ASSERT_FALSE(taskManager.isRunning());
+  TEST_ASSERT_FALSE(pumpOn);
+  TEST_ASSERT_TRUE(opened == valve_bit(0));
+  taskManager.tick(62999);
+  TEST_ASSERT_TRUE(opened == valve_bit(0));
+  taskManager.tick(63000);
+  TEST_ASSERT_TRUE(opened == 0);
+}
+
+void test_task_manager()
+{
+  RUN_TEST(scheduled_start_runs_the_full_first_step);
+  RUN_TEST(steps_chain_from_their_deadline);
+  RUN_TEST(pump_waits_for_the_first_zone);
+  RUN_TEST(zones_overlap_on_a_step_change);
+  RUN_TEST(valves_close_after_the_pump_ran_down);
+}
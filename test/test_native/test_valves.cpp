@@ -0,0 +1,49 @@
+#include <unity.h>
+#include <Wire.h>
+#include "valves.h"
+#include "tests.h"
+
+static void unplugged_expander_fails_until_it_is_back()
+{
+  valves_init();
+  TEST_ASSERT_TRUE(valves_write(valve_bit(0)));
+  TEST_ASSERT_EQUAL_UINT16(0, valves_failing());
+
+  // Zone 6 is on the second box; the first one keeps its byte
+  Wire.native_unplug(PCF_3C_ADDRESS);
+  uint32_t errors = valves_stats().errors;
+  for (int i = 1; i <= 3; i++)
+  {
+    TEST_ASSERT_FALSE(valves_write(valve_bit(0) | valve_bit(6)));
+    TEST_ASSERT_EQUAL_UINT16(i, valves_failing());
+  }
+  TEST_ASSERT_EQUAL_UINT32(errors + 3, valves_stats().errors);
+
+  Wire.native_unplug(PCF_3C_ADDRESS, false);
+  TEST_ASSERT_TRUE(valves_write(valve_bit(0) | valve_bit(6)));
+  TEST_ASSERT_EQUAL_UINT16(0, valves_failing());
+  TEST_ASSERT_TRUE(valves_write(0));
+}
+
+static void unchanged_byte_is_not_written_again()
+{
+  valves_init();
+  TEST_ASSERT_TRUE(valves_write(valve_bit(1)));
+  uint32_t skipped = valves_stats().skipped;
+
+  // Known to be in the latch, so a missing box goes unnoticed until it changes
+  Wire.native_unplug(PCF_38_ADDRESS);
+  TEST_ASSERT_TRUE(valves_write(valve_bit(1)));
+  TEST_ASSERT_EQUAL_UINT32(skipped + 2, valves_stats().skipped);
+  TEST_ASSERT_FALSE(valves_write(0));
+  TEST_ASSERT_EQUAL_UINT16(1, valves_failing());
+
+  Wire.native_unplug(PCF_38_ADDRESS, false);
+  TEST_ASSERT_TRUE(valves_write(0));
+}
+
+void test_valves()
+{
+  RUN_TEST(unplugged_expander_fails_until_it_is_back);
+  RUN_TEST(unchanged_byte_is_not_written_again);
+}
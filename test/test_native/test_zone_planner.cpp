@@ -0,0 +1,93 @@
+#include <unity.h>
+#include "ZonePlanner.h"
+#include "tests.h"
+
+// Seconds each zone is open over the plan
+static void openTimes(const valve_setting_t *steps, uint8_t count, uint32_t *open)
+{
+  for (uint8_t z = 0; z < MAX_ZONES; z++)
+  {
+    open[z] = 0;
+  }
+  for (uint8_t s = 0; s < count; s++)
+  {
+    for (uint8_t z = 0; z < MAX_ZONES; z++)
+    {
+      if (steps[s].valves & valve_bit(z)) open[z] += steps[s].duration;
+    }
+  }
+}
+
+static void packs_zones_within_capacity()
+{
+  zone_demand_t zones[3] = {{6, 600}, {4, 300}, {5, 300}};
+  valve_setting_t steps[MAX_TASKS];
+  zone_plan_t plan;
+  TEST_ASSERT_TRUE(planZones(zones, 3, 10, steps, MAX_TASKS, plan));
+
+  TEST_ASSERT_EQUAL_UINT8(3, plan.steps);
+  TEST_ASSERT_EQUAL_UINT32(900, plan.window);
+  TEST_ASSERT_TRUE(steps[0].valves == (valve_bit(0) | valve_bit(1)));
+  TEST_ASSERT_EQUAL_UINT16(300, steps[0].duration);
+  TEST_ASSERT_TRUE(steps[1].valves == valve_bit(0));
+  TEST_ASSERT_EQUAL_UINT16(300, steps[1].duration);
+  TEST_ASSERT_TRUE(steps[2].valves == valve_bit(2));
+  TEST_ASSERT_EQUAL_UINT16(300, steps[2].duration);
+}
+
+static void every_zone_gets_exactly_its_time()
+{
+  zone_demand_t zones[MAX_ZONES];
+  for (uint8_t z = 0; z < MAX_ZONES; z++)
+  {
+    zones[z].flow = 1 + z % 4;
+    zones[z].duration = z % 5 == 0 ? 0 : 60 * (1 + z % 7);
+  }
+
+  valve_setting_t steps[MAX_TASKS];
+  zone_plan_t plan;
+  TEST_ASSERT_TRUE(planZones(zones, MAX_ZONES, 6, steps, MAX_TASKS, plan));
+
+  uint32_t open[MAX_ZONES];
+  openTimes(steps, plan.steps, open);
+  uint32_t total = 0;
+  for (uint8_t z = 0; z < MAX_ZONES; z++)
+  {
+    TEST_ASSERT_EQUAL_UINT32(zones[z].duration, open[z]);
+    total += zones[z].duration;
+  }
+  TEST_ASSERT_LESS_OR_EQUAL(total, plan.window);
+
+  for (uint8_t s = 0; s < plan.steps; s++)
+  {
+    uint32_t used = 0;
+    for (uint8_t z = 0; z < MAX_ZONES; z++)
+    {
+      if (steps[s].valves & valve_bit(z)) used += zones[z].flow;
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(6, used);
+  }
+}
+
+static void impossible_plans_are_rejected()
+{
+  valve_setting_t steps[MAX_TASKS];
+  zone_plan_t plan;
+
+  zone_demand_t thirsty[2] = {{4, 60}, {11, 60}};
+  TEST_ASSERT_FALSE(planZones(thirsty, 2, 10, steps, MAX_TASKS, plan));
+
+  zone_demand_t dry[2] = {{4, 0}, {4, 0}};
+  TEST_ASSERT_FALSE(planZones(dry, 2, 10, steps, MAX_TASKS, plan));
+
+  zone_demand_t serial[3] = {{10, 60}, {10, 120}, {10, 180}};
+  TEST_ASSERT_FALSE(planZones(serial, 3, 10, steps, 2, plan));
+  TEST_ASSERT_TRUE(planZones(serial, 3, 10, steps, 3, plan));
+}
+
+void test_zone_planner()
+{
+  RUN_TEST(packs_zones_within_capacity);
+  RUN_TEST(every_zone_gets_exactly_its_time);
+  RUN_TEST(impossible_plans_are_rejected);
+}
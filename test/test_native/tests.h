@@ -0,0 +1,18 @@
+#pragma once
+
+// One runner per component; each file holds the tests of one component.
+void test_native_hal();
+void test_program_scheduler();
+void test_deadline_queue();
+void test_task_manager();
+void test_zone_planner();
+void test_arena_allocator();
+void test_manual_runs();
+void test_config_storage();
+void test_checkpoint();
+void test_clock_discipline();
+void test_diagnostics();
+void test_mqtt_queue();
+void test_mqtt_commands();
+void test_valves();
+void test_i2c_bus();
@@ -0,0 +1,93 @@
+#include "sim_clock.h"
+#include <math.h>
+
+int64_t sim_days_from_civil(int32_t y, uint32_t m, uint32_t d)
+{
+  y -= m <= 2;
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const uint32_t yoe = (uint32_t)(y - era * 400);
+  const uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int64_t)doe - 719468;
+}
+
+void sim_civil_from_days(int64_t z, int32_t &y, uint32_t &m, uint32_t &d)
+{
+  z += 719468;
+  const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  const uint32_t doe = (uint32_t)(z - era * 146097);
+  const uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const uint32_t mp = (5 * doy + 2) / 153;
+  d = doy - (153 * mp + 2) / 5 + 1;
+  m = mp < 10 ? mp + 3 : mp - 9;
+  y = (int32_t)(yoe + era * 400 + (m <= 2));
+}
+
+SimLocalTime sim_split(int64_t seconds)
+{
+  SimLocalTime t;
+  int64_t days = seconds >= 0 ? seconds / 86400 : (seconds - 86399) / 86400;
+  int64_t rem = seconds - days * 86400;
+  sim_civil_from_days(days, t.year, t.month, t.day);
+  t.hour = (uint32_t)(rem / 3600);
+  t.minute = (uint32_t)(rem / 60 % 60);
+  t.second = (uint32_t)(rem % 60);
+  return t;
+}
+
+// Last Sunday of a month at 01:00 UTC (EU switch instant for both changes)
+static int64_t eu_switch_utc(int32_t year, uint32_t month)
+{
+  int64_t last = sim_days_from_civil(year, month, 31);
+  int64_t weekday = (last + 4) % 7; // 0 = Sunday
+  return (last - weekday) * 86400 + 3600;
+}
+
+int32_t sim_cet_offset(int64_t utc)
+{
+  int32_t year = sim_split(utc).year;
+  bool summer = utc >= eu_switch_utc(year, 3) && utc < eu_switch_utc(year, 10);
+  return summer ? 7200 : 3600;
+}
+
+int64_t sim_local_to_utc(int64_t local)
+{
+  // Ambiguous local times (autumn) map to their first occurrence,
+  // non-existent ones (spring gap) to the end of the gap, when a clock
+  // following local time jumps over them.
+  int64_t guess = local - 7200;
+  if (sim_cet_offset(guess) == 7200) return guess;
+  if (sim_cet_offset(local - 3600) == 3600) return local - 3600;
+  return eu_switch_utc(sim_split(local).year, 3);
+}
+
+void SimRtc::adjust(double trueTime, int64_t localValue)
+{
+  _baseTrue = trueTime;
+  _baseValue = (double)localValue;
+}
+
+void SimRtc::setAging(double trueTime, int8_t aging)
+{
+  _baseValue = read(trueTime);
+  _baseTrue = trueTime;
+  _rate = 1.0 + (_driftPpm - 0.1 * aging) / 1e6;
+}
+
+double SimRtc::read(double trueTime) const
+{
+  return _baseValue + (trueTime - _baseTrue) * _rate;
+}
+
+double SimRtc::nextMinuteAlarm(double trueTime) const
+{
+  double value = read(trueTime);
+  double next = floor(value / 60.0 + 1e-9) * 60.0 + 60.0;
+  double at = _baseTrue + (next - _baseValue) / _rate;
+  if (at <= trueTime + 1e-6)
+  {
+    at += 60.0 / _rate; // guard against rounding landing on the current alarm
+  }
+  return at;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+// Civil calendar helpers on plain seconds (no DateTime, no libc TZ), so the
+// simulator's inner loop stays cheap and deterministic.
+int64_t sim_days_from_civil(int32_t y, uint32_t m, uint32_t d);
+void sim_civil_from_days(int64_t days, int32_t &y, uint32_t &m, uint32_t &d);
+
+// Central European local time offset (CET-1CEST,M3.5.0/2,M10.5.0/3) in
+// seconds for a UTC instant, i.e. the rule the firmware hands configTzTime().
+int32_t sim_cet_offset(int64_t utc);
+int64_t sim_local_to_utc(int64_t local);
+
+struct SimLocalTime
+{
+  int32_t year;
+  uint32_t month, day, hour, minute, second;
+};
+
+SimLocalTime sim_split(int64_t seconds);
+
+// DS3231 as seen by the firmware: holds local wall time, runs at
+// (1 + (drift_ppm - 0.1 * aging) / 1e6) of true rate and is set by
+// adjust(). Times are "true" UTC seconds of the simulation as doubles.
+class SimRtc
+{
+public:
+  explicit SimRtc(double driftPpm = 0) : _driftPpm(driftPpm), _rate(1.0 + driftPpm / 1e6) {}
+
+  void adjust(double trueTime, int64_t localValue);
+  void setAging(double trueTime, int8_t aging); // Rate changes from trueTime on
+  double read(double trueTime) const; // RTC seconds (local wall time)
+
+  // True time at which the RTC next shows second 0, strictly after trueTime
+  double nextMinuteAlarm(double trueTime) const;
+
+private:
+  double _driftPpm;
+  double _rate;
+  double _baseTrue = 0;
+  double _baseValue = 0;
+};
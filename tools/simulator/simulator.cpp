@@ -0,0 +1,473 @@
+// Accelerated-time replay of TaskManager.
+//
+// Drives the real TaskManager with the DS3231 minute alarm of a simulated
+// RTC (local wall time, optional drift) that is kept on "NTP" time the way
+// ntp_alarm() does it: ClockDiscipline compares it with true CET/CEST time
+// at every alarm, retunes the aging offset and sets the RTC at :30 when it
+// is too far off. The RTC boots 2 s off, as an older firmware set it. Pump
+// and valve callbacks are stubbed and integrated over true time, and every
+// intended start (the configured local time on each day) is matched against
+// the cycles that actually started.
+//
+//   simulator [--from YYYY-MM-DD] [--days N] [--start HH:MM]...
+//             [--weekdays MASK] [--days-filter all|odd|even]
+//             [--step PATTERN:MINUTES|SECONDSs]... [--drift-ppm X] [--ntp on|off]
+//             [--jump HOURS:SECONDS]... [--stall HOURS:SECONDS]...
+//             [--capacity FLOW --zone VALVE:FLOW:MINUTES|SECONDSs...]
+//
+// With --zone the steps come from planZones() instead of --step. --jump sets
+// the RTC SECONDS off at HOURS into the run (a bad manual set, a glitch),
+// --stall leaves the minute alarms unhandled for SECONDS (blocked loop).
+
+#include <Arduino.h>
+#include <NativeHal.h>
+#include <chrono>
+#include <vector>
+
+#include "TaskManager.h"
+#include "pump.h"
+#include "utils.h"
+#include "ZonePlanner.h"
+#include "ClockDiscipline.h"
+#include "sim_clock.h"
+
+static const int ZONES = 12; // Reported at least, as on the stock two-box controller
+static const int64_t ON_TIME_TOLERANCE = 60;   // seconds
+static const int64_t MATCH_WINDOW = 6 * 3600;  // later than this counts as missed
+static const int64_t EARLY_WINDOW = 3600;      // RTC set ahead across a start
+
+struct SimStep
+{
+  valve_mask_t valves;
+  uint16_t duration; // seconds
+};
+
+struct SimEvent
+{
+  double hours; // Since the start of the run
+  int32_t seconds;
+};
+
+struct SimOptions
+{
+  int32_t year = 2026;
+  uint32_t month = 1, day = 1;
+  uint32_t days = 365;
+  program_t program = {};
+  std::vector<SimStep> steps;
+  double driftPpm = 0;
+  bool ntp = true; // off: the RTC runs free after boot
+  std::vector<SimEvent> jumps; // In order
+  std::vector<SimEvent> stalls;
+  zone_demand_t zones[MAX_ZONES] = {};
+  uint8_t zoneCount = 0;
+  uint16_t capacity = 0;
+  bool help = false;
+};
+
+struct SimStats
+{
+  double zoneSeconds[MAX_ZONES] = {};
+  double pumpSeconds = 0;
+  double deadheadSeconds = 0; // pump running with every valve closed
+  uint32_t alarms = 0;
+  uint32_t steps = 0;
+  int32_t worstOffsetMs = 0; // Largest offset left to slewing, after the first day
+  uint32_t cycles = 0;
+  uint32_t onTime = 0, late = 0, early = 0, missed = 0, extra = 0;
+  uint32_t reported = 0; // Missed starts the scheduler reported
+  int64_t worstLate = 0;
+};
+
+// State the stubbed callbacks write into
+static double g_now = 0;
+static bool g_pumpOn = false;
+static double g_pumpOnAt = 0;
+static valve_mask_t g_valves = 0;
+static std::vector<double> g_starts;
+static uint32_t g_reported = 0;
+
+static void simPump(bool on)
+{
+  if (on && !g_pumpOn)
+  {
+    g_pumpOnAt = g_now;
+    g_starts.push_back(g_now);
+  }
+  g_pumpOn = on;
+}
+
+static void simMissed(uint8_t program, uint32_t at)
+{
+  g_reported++;
+}
+
+static bool simPumpReady()
+{
+  return g_now - g_pumpOnAt >= PUMP_MIN_RUN_TIME * 60;
+}
+
+static void simValves(valve_setting_t *setting)
+{
+  g_valves = setting->valves;
+}
+
+static uint16_t parseDuration(const char *text)
+{
+  char *unit;
+  long duration = strtol(text, &unit, 10);
+  return (uint16_t)(*unit == 's' ? duration : duration * 60);
+}
+
+static bool parseArgs(int argc, char **argv, SimOptions &opt)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv[i];
+    if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0)
+    {
+      opt.help = true;
+      return true;
+    }
+
+    const char *val = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (val == nullptr)
+    {
+      fprintf(stderr, "missing value for %s\n", arg);
+      return false;
+    }
+    i++;
+
+    if (strcmp(arg, "--from") == 0)
+    {
+      if (sscanf(val, "%d-%u-%u", &opt.year, &opt.month, &opt.day) != 3) return false;
+    }
+    else if (strcmp(arg, "--days") == 0)
+    {
+      opt.days = (uint32_t)strtoul(val, nullptr, 10);
+    }
+    else if (strcmp(arg, "--start") == 0)
+    {
+      if (opt.program.start_count >= MAX_PROGRAM_STARTS) return false;
+      if (!parseTimeOfDay(val, opt.program.starts[opt.program.start_count])) return false;
+      opt.program.start_count++;
+    }
+    else if (strcmp(arg, "--weekdays") == 0)
+    {
+      opt.program.weekdays = (uint8_t)strtoul(val, nullptr, 0);
+    }
+    else if (strcmp(arg, "--days-filter") == 0)
+    {
+      opt.program.day_filter = strcmp(val, "odd") == 0 ? DAYS_ODD : strcmp(val, "even") == 0 ? DAYS_EVEN : DAYS_ALL;
+    }
+    else if (strcmp(arg, "--step") == 0)
+    {
+      const char *colon = strrchr(val, ':');
+      if (colon == nullptr) return false;
+      String pattern;
+      pattern.concat(val, colon - val);
+      opt.steps.push_back({decodeBinaryString(pattern.c_str()), parseDuration(colon + 1)});
+    }
+    else if (strcmp(arg, "--capacity") == 0)
+    {
+      opt.capacity = (uint16_t)atoi(val);
+    }
+    else if (strcmp(arg, "--zone") == 0)
+    {
+      unsigned valve, flow;
+      char duration[16];
+      if (sscanf(val, "%u:%u:%15s", &valve, &flow, duration) != 3 || valve >= MAX_ZONES) return false;
+      opt.zones[valve].flow = flow;
+      opt.zones[valve].duration = parseDuration(duration);
+      if (valve + 1 > opt.zoneCount) opt.zoneCount = valve + 1;
+    }
+    else if (strcmp(arg, "--drift-ppm") == 0)
+    {
+      opt.driftPpm = atof(val);
+    }
+    else if (strcmp(arg, "--jump") == 0 || strcmp(arg, "--stall") == 0)
+    {
+      SimEvent event;
+      if (sscanf(val, "%lf:%d", &event.hours, &event.seconds) != 2) return false;
+      std::vector<SimEvent> &events = arg[2] == 'j' ? opt.jumps : opt.stalls;
+      if (!events.empty() && events.back().hours > event.hours) return false;
+      events.push_back(event);
+    }
+    else if (strcmp(arg, "--ntp") == 0)
+    {
+      opt.ntp = strcmp(val, "off") != 0;
+    }
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", arg);
+      return false;
+    }
+  }
+
+  if (opt.program.start_count == 0)
+  {
+    opt.program.starts[0] = 20 * 60;
+    opt.program.start_count = 1;
+  }
+
+  if (opt.zoneCount > 0)
+  {
+    valve_setting_t steps[MAX_TASKS];
+    zone_plan_t plan;
+    if (!planZones(opt.zones, opt.zoneCount, opt.capacity, steps, MAX_TASKS, plan))
+    {
+      fprintf(stderr, "zones cannot be planned within capacity %u\n", opt.capacity);
+      return false;
+    }
+
+    uint32_t sequential = 0;
+    for (uint8_t z = 0; z < opt.zoneCount; z++)
+    {
+      sequential += opt.zones[z].duration;
+    }
+    printf("Zone plan: %u steps, %u min window (%u min one zone at a time)\n", plan.steps, plan.window / 60, sequential / 60);
+    for (uint8_t i = 0; i < plan.steps; i++)
+    {
+      printf("  step %2u: %s %4u s\n", i, toValveString(steps[i].valves, max<int>(ZONES, opt.zoneCount)).c_str(), steps[i].duration);
+      opt.steps.push_back({steps[i].valves, steps[i].duration});
+    }
+  }
+
+  if (opt.steps.empty())
+  {
+    // Firmware defaults from setTaskManager()
+    opt.steps.push_back({decodeBinaryString("oxo xxx xxx xxx"), 20 * 60});
+    opt.steps.push_back({decodeBinaryString("xox xxx xxx xox"), 17 * 60});
+    opt.steps.push_back({decodeBinaryString("xxx xxx oox xxx"), 15 * 60});
+    opt.steps.push_back({decodeBinaryString("xxx xxx xxx oxo"), 15 * 60});
+  }
+  return opt.steps.size() <= MAX_TASKS;
+}
+
+static void integrate(SimStats &stats, double dt)
+{
+  if (g_pumpOn)
+  {
+    stats.pumpSeconds += dt;
+    if (g_valves == 0) stats.deadheadSeconds += dt;
+  }
+  for (int z = 0; z < MAX_ZONES; z++)
+  {
+    if (g_valves & valve_bit(z)) stats.zoneSeconds[z] += dt;
+  }
+}
+
+static double trueLocal(double t)
+{
+  return t + sim_cet_offset((int64_t)floor(t));
+}
+
+// What ntp_alarm() does at an alarm; returns when to set the RTC, or 0
+static double ntpAlarm(ClockDiscipline &discipline, SimRtc &rtc, double t, double start, SimStats &stats)
+{
+  double offset = (floor(rtc.read(t) / 60.0 + 0.5) * 60.0 - trueLocal(t)) * 1000.0;
+  clock_correction_t correction = discipline.sample((int32_t)llround(offset), (uint32_t)(t - start));
+  if (correction.set_aging)
+  {
+    rtc.setAging(t, correction.aging);
+  }
+  if (correction.step)
+  {
+    double local = trueLocal(t);
+    double until = floor(local / 60.0) * 60.0 + 30.0 - local;
+    return t + (until > 0 ? until : until + 60.0);
+  }
+
+  int32_t magnitude = abs(discipline.lastOffsetMs());
+  if (t - start >= 86400 && magnitude > stats.worstOffsetMs) stats.worstOffsetMs = magnitude;
+  return 0;
+}
+
+static void matchStarts(const SimOptions &opt, int64_t from, int64_t to, SimStats &stats)
+{
+  std::vector<bool> used(g_starts.size(), false);
+
+  // Intended starts: the program's rules evaluated on true local time
+  int64_t local = from + sim_cet_offset(from) - 1;
+  for (;;)
+  {
+    local = ProgramScheduler::nextFire(opt.program, (uint32_t)local);
+    if (local == NO_RUN) break;
+    int64_t intended = sim_local_to_utc(local);
+    if (intended >= to) break;
+    if (intended < from) continue;
+
+    bool found = false;
+    for (size_t i = 0; i < g_starts.size() && !found; i++)
+    {
+      int64_t delta = (int64_t)g_starts[i] - intended;
+      if (used[i] || delta < -EARLY_WINDOW || delta > MATCH_WINDOW) continue;
+
+      used[i] = true;
+      found = true;
+      if (delta < -ON_TIME_TOLERANCE)
+      {
+        stats.early++;
+      }
+      else if (delta <= ON_TIME_TOLERANCE)
+      {
+        stats.onTime++;
+      }
+      else
+      {
+        stats.late++;
+        if (delta > stats.worstLate) stats.worstLate = delta;
+      }
+    }
+    if (!found) stats.missed++;
+  }
+
+  for (size_t i = 0; i < used.size(); i++)
+  {
+    if (!used[i]) stats.extra++;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  SimOptions opt;
+  opt.program.weekdays = WEEKDAYS_ALL;
+  opt.program.enabled = 1;
+  bool parsed = parseArgs(argc, argv, opt);
+  if (!parsed || opt.help)
+  {
+    fprintf(parsed ? stdout : stderr,
+            "usage: %s [--from YYYY-MM-DD] [--days N] [--start HH:MM]...\n"
+            "          [--weekdays MASK] [--days-filter all|odd|even]\n"
+            "          [--step PATTERN:MINUTES|SECONDSs]... [--drift-ppm X] [--ntp on|off]\n"
+            "          [--jump HOURS:SECONDS]... [--stall HOURS:SECONDS]...\n"
+            "          [--capacity FLOW --zone VALVE:FLOW:MINUTES|SECONDSs...]\n",
+            argv[0]);
+    return parsed ? 0 : 2;
+  }
+
+  TaskManager taskManager(0, 0);
+  if (!taskManager.scheduler().setProgram(0, opt.program))
+  {
+    return 2;
+  }
+  taskManager.setCallbacks(simValves, simPump, simPumpReady);
+  taskManager.scheduler().setMissedCallback(simMissed);
+  for (size_t i = 0; i < opt.steps.size(); i++)
+  {
+    taskManager.setValveSetting(i, opt.steps[i].valves, opt.steps[i].duration);
+  }
+
+  // Boot at local midnight of the first day
+  int64_t firstLocal = sim_days_from_civil(opt.year, opt.month, opt.day) * 86400;
+  double start = (double)sim_local_to_utc(firstLocal);
+  double end = start + opt.days * 86400.0;
+  double stepAt = end; // Pending DEFER_CLOCK_STEP
+  size_t nextJump = 0;
+
+  SimStats stats;
+  SimRtc rtc(opt.driftPpm);
+  rtc.adjust(start, firstLocal + 2);
+  ClockDiscipline discipline;
+  discipline.reset(0);
+  g_now = start;
+
+  auto wallStart = std::chrono::steady_clock::now();
+
+  for (;;)
+  {
+    double alarm = rtc.nextMinuteAlarm(g_now);
+    double jumpAt = nextJump < opt.jumps.size() ? start + opt.jumps[nextJump].hours * 3600.0 : end;
+    double next = min(alarm, min(stepAt, jumpAt));
+
+    // millis() deadlines of the step engine, mapped back onto true time.
+    // millis() wraps every 49.7 days here exactly as on the device.
+    uint32_t deadline;
+    double work = end;
+    if (taskManager.nextDeadline(deadline))
+    {
+      work = g_now + (int32_t)(deadline - native_millis()) / 1000.0;
+    }
+    bool tickOnly = work < next;
+    if (tickOnly) next = work;
+    if (next >= end) break;
+
+    integrate(stats, next - g_now);
+    g_now = next;
+    native_set_millis((uint32_t)(uint64_t)llround((g_now - start) * 1000.0));
+
+    if (tickOnly)
+    {
+      taskManager.tick(native_millis());
+      continue;
+    }
+
+    if (next == jumpAt)
+    {
+      rtc.adjust(g_now, (int64_t)llround(rtc.read(g_now)) + opt.jumps[nextJump].seconds);
+      nextJump++;
+      continue;
+    }
+
+    if (next == stepAt)
+    {
+      rtc.adjust(g_now, (int64_t)llround(trueLocal(g_now)));
+      stats.steps++;
+      stepAt = end;
+      continue;
+    }
+
+    bool stalled = false;
+    for (const SimEvent &stall : opt.stalls)
+    {
+      double from = start + stall.hours * 3600.0;
+      stalled |= g_now >= from && g_now < from + stall.seconds;
+    }
+    if (stalled)
+    {
+      continue; // The alarm stays pending; the next one is handled late
+    }
+
+    stats.alarms++;
+    if (opt.ntp && stepAt == end)
+    {
+      double at = ntpAlarm(discipline, rtc, g_now, start, stats);
+      if (at > 0) stepAt = at;
+    }
+    taskManager.loop((uint32_t)llround(rtc.read(g_now)), native_millis());
+    taskManager.tick(native_millis());
+  }
+  integrate(stats, end - g_now);
+
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+  stats.cycles = g_starts.size();
+  stats.reported = g_reported;
+  matchStarts(opt, (int64_t)start, (int64_t)end, stats);
+
+  printf("Simulated %u days from %04d-%02u-%02u, %u starts/day, %u steps, drift %.1f ppm, NTP %s\n",
+         opt.days, opt.year, opt.month, opt.day, opt.program.start_count, (unsigned)opt.steps.size(), opt.driftPpm,
+         opt.ntp ? "on" : "off");
+  printf("  alarms processed : %u\n", stats.alarms);
+  if (opt.ntp)
+  {
+    printf("  RTC discipline   : %u steps, worst offset %d ms after day 1, drift %.2f ppm, aging %d\n",
+           stats.steps, stats.worstOffsetMs, discipline.driftPpm(), discipline.aging());
+  }
+  printf("  cycles started   : %u\n", stats.cycles);
+  printf("  starts on time   : %u\n", stats.onTime);
+  printf("  starts late      : %u (worst %lld s)\n", stats.late, (long long)stats.worstLate);
+  printf("  starts early     : %u\n", stats.early);
+  printf("  starts missed    : %u (%u reported as missed)\n", stats.missed, stats.reported);
+  printf("  extra starts     : %u\n", stats.extra);
+  printf("  pump runtime     : %.1f h (%.1f h with all valves closed)\n", stats.pumpSeconds / 3600.0, stats.deadheadSeconds / 3600.0);
+  printf("  zone minutes     :");
+  for (int z = 0; z < max<int>(ZONES, opt.zoneCount); z++)
+  {
+    printf(" %d:%.0f", z, stats.zoneSeconds[z] / 60.0);
+  }
+  printf("\n");
+  printf("  wall time        : %.3f s (%.0f simulated days/s)\n", wall, wall > 0 ? opt.days / wall : 0.0);
+
+  return stats.missed == 0 && stats.extra == 0 ? 0 : 1;
+}